@@ -58,7 +58,7 @@ const u32 crc32_table[256] __attribute__((section(".dtcm"))) = {
 // ------------------------------------------------------------------------------------
 ITCM_CODE u32 getFileCrc(const char* filename)
 {
-    extern u32 file_size;
+    extern MACHINE_LOCAL u32 file_size;
     u32 crc = 0xFFFFFFFF;
     int bytesRead;
 
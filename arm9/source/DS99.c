@@ -52,19 +52,19 @@
 // sundry debug purposes. Pressing X when loading a game shows the debug
 // registers. It's amazing how incredibly useful this proves to be.
 // --------------------------------------------------------------------------
-u32 debug[0x10]     __attribute__((section(".dtcm")));
+MACHINE_DTCM  u32 debug[0x10];
 
 // ---------------------------------------------------------------------------------------
 // The master sound chip for the TI99. The SN sound chip is the same as the TI9919 chip.
 // ---------------------------------------------------------------------------------------
-SN76496 snti99      __attribute__((section(".dtcm")));
+MACHINE_DTCM  SN76496 snti99;
 
 // ---------------------------------------------------------------------------
 // Some timing and frame rate comutations to keep the emulation on pace...
 // ---------------------------------------------------------------------------
 u16 emuFps          __attribute__((section(".dtcm"))) = 0;
 u16 emuActFrames    __attribute__((section(".dtcm"))) = 0;
-u16 timingFrames    __attribute__((section(".dtcm"))) = 0;
+MACHINE_DTCM  u16 timingFrames = 0;
 u8  bShowDebug      __attribute__((section(".dtcm"))) = 0;
 u8  debug_screen = 0;
 
@@ -83,10 +83,10 @@ u8 meta_next_key    __attribute__((section(".dtcm"))) = 0;        // Used to han
 u8 handling_meta    __attribute__((section(".dtcm"))) = 0;        // Used to handle special meta keys like FNCT and CTRL and SHIFT
 u16 vusCptVBL       __attribute__((section(".dtcm"))) = 0;        // We use this as a basic timer ticked every 1/60th of a second
 
-char tmpBuf[256];               // For simple printf-type output and other sundry uses.
-u8 fileBuf[8192];               // For DSK sector cache, general file I/O and file CRC generation use.
+MACHINE_LOCAL char tmpBuf[256];               // For simple printf-type output and other sundry uses.
+MACHINE_LOCAL u8 fileBuf[8192];               // For DSK sector cache, general file I/O and file CRC generation use.
 
-u8 *SharedMemBuffer;            // This is used mostly by the DS-Lite/Phat so it can share a block of memory for CART and SAMS
+MACHINE_LOCAL u8 *SharedMemBuffer;            // This is used mostly by the DS-Lite/Phat so it can share a block of memory for CART and SAMS
 
 u8 bStartSoundEngine = false;   // Set to true to unmute sound after 1 frame of rendering...
 int bg0, bg1, bg0b, bg1b;       // Some vars for NDS background screen handling
@@ -1477,7 +1477,7 @@ void __attribute__ ((noinline)) ds99_show_debugger(void)
         idx++;
         for (u16 i=0x8000+(0x80*mem_debug); i<0x8080+(0x80*(mem_debug)); i+=8)
         {
-            sprintf(tmpBuf, "%04X: %02X %02X %02X %02X %02X %02X %02X %02X", i, MemCPU[i+0], MemCPU[i+1], MemCPU[i+2], MemCPU[i+3], MemCPU[i+4], MemCPU[i+5], MemCPU[i+6], MemCPU[i+7]);
+            sprintf(tmpBuf, "%04X: %02X %02X %02X %02X %02X %02X %02X %02X", i, PAGE_BYTE(i+0), PAGE_BYTE(i+1), PAGE_BYTE(i+2), PAGE_BYTE(i+3), PAGE_BYTE(i+4), PAGE_BYTE(i+5), PAGE_BYTE(i+6), PAGE_BYTE(i+7));
             DS_Print(0,idx++,6,tmpBuf);
         }
     }
@@ -1488,7 +1488,7 @@ void __attribute__ ((noinline)) ds99_show_debugger(void)
         idx++;
         for (u16 i=0xA000+(0x80*mem_debug); i<0xA080+(0x80*(mem_debug)); i+=8)
         {
-            sprintf(tmpBuf, "%04X: %02X %02X %02X %02X %02X %02X %02X %02X", i, MemCPU[i+0], MemCPU[i+1], MemCPU[i+2], MemCPU[i+3], MemCPU[i+4], MemCPU[i+5], MemCPU[i+6], MemCPU[i+7]);
+            sprintf(tmpBuf, "%04X: %02X %02X %02X %02X %02X %02X %02X %02X", i, PAGE_BYTE(i+0), PAGE_BYTE(i+1), PAGE_BYTE(i+2), PAGE_BYTE(i+3), PAGE_BYTE(i+4), PAGE_BYTE(i+5), PAGE_BYTE(i+6), PAGE_BYTE(i+7));
             DS_Print(0,idx++,6,tmpBuf);
         }
     }
@@ -2032,6 +2032,7 @@ void TI99DSInitCPU(void)
   //  Init Main Memory and VDP Video Memory
   //  -----------------------------------------
   memset(pVDPVidMem, 0x00, 0x4000);
+  Invalidate9918();
 
   // -----------------------------------------------
   // Init bottom screen do display correct overlay
@@ -2080,6 +2081,11 @@ void LoadBIOSFiles(void)
     // ------------------------------------------------
     StealVideoRAM();
 
+    // ------------------------------------------------------------------------
+    // The big CPU opcode and status tables live in that VRAM - build them once
+    // ------------------------------------------------------------------------
+    TMS9900_buildopcodes();
+
     // ------------------------------------------------------------------------
     // Find the main console ROM which is 8K in size... load this into cache.
     // ------------------------------------------------------------------------
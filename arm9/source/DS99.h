@@ -15,16 +15,44 @@
 #include <nds.h>
 #include <string.h>
 
-extern u32 MAX_CART_SIZE;   // Dynamic buffer size - if DSi we go to 8MB and for DS only 512K
-extern u8  *MemCART;        // The actual cart buffer gets allocated here.
-extern char tmpBuf[256];    // For simple printf-type output and other sundry uses.
-extern u8 fileBuf[0x2000];  // For DSK sector cache, general file I/O and file CRC generation use. Must be at least 8K
-extern u8 *SharedMemBuffer; // A bit of shared memory for the system to use allocated from the heap
+// ------------------------------------------------------------------------------------------
+// Machine state - everything that makes up one running TI-99/4a (CPU, 9901, VDP, memory, SAMS,
+// disk, speech, the cart loader...) is tagged with one of these. On the DS there is only ever
+// one machine so these are plain globals with the hot ones placed in fast DTCM. The Linux host
+// build can run many machines side by side in one process - one per thread - so there every
+// bit of machine state is thread-local and each thread gets a complete console of its own.
+// Both the definition and any extern declaration must carry the tag (the compiler insists).
+// Read-only tables (built at compile time or once at startup) are shared and left untagged.
+// ------------------------------------------------------------------------------------------
+#ifdef DS99_HOST
+#define MACHINE_LOCAL       __thread
+#define MACHINE_DTCM        __thread
+#else
+#define MACHINE_LOCAL
+#define MACHINE_DTCM        __attribute__((section(".dtcm")))
+#endif
+
+extern MACHINE_LOCAL u32 MAX_CART_SIZE;   // Dynamic buffer size - if DSi we go to 8MB and for DS only 512K
+extern MACHINE_LOCAL u8  *MemCART;        // The actual cart buffer gets allocated here.
+extern MACHINE_LOCAL char tmpBuf[256];    // For simple printf-type output and other sundry uses.
+extern MACHINE_LOCAL u8 fileBuf[0x2000];  // For DSK sector cache, general file I/O and file CRC generation use. Must be at least 8K
+extern MACHINE_LOCAL u8 *SharedMemBuffer; // A bit of shared memory for the system to use allocated from the heap
 
-extern u32 file_size;
+extern MACHINE_LOCAL u32 file_size;
 
 #define WAITVBL {swiWaitForVBlank(); swiWaitForVBlank(); swiWaitForVBlank(); swiWaitForVBlank(); swiWaitForVBlank();}
 
+// ------------------------------------------------------------------------------------------
+// Compile-time table generators - TABLE_256(GEN, 0) expands to GEN(0), GEN(1) ... GEN(255)
+// so a lookup table that is a simple function of its index can be baked into the binary as
+// initialized data rather than built with a loop every time a cart is loaded or reset.
+// ------------------------------------------------------------------------------------------
+#define TABLE_4(gen, i)     gen((i)), gen((i)+1), gen((i)+2), gen((i)+3)
+#define TABLE_16(gen, i)    TABLE_4(gen, (i)),   TABLE_4(gen, (i)+4),    TABLE_4(gen, (i)+8),    TABLE_4(gen, (i)+12)
+#define TABLE_64(gen, i)    TABLE_16(gen, (i)),  TABLE_16(gen, (i)+16),  TABLE_16(gen, (i)+32),  TABLE_16(gen, (i)+48)
+#define TABLE_256(gen, i)   TABLE_64(gen, (i)),  TABLE_64(gen, (i)+64),  TABLE_64(gen, (i)+128), TABLE_64(gen, (i)+192)
+#define TABLE_1024(gen, i)  TABLE_256(gen, (i)), TABLE_256(gen, (i)+256), TABLE_256(gen, (i)+512), TABLE_256(gen, (i)+768)
+
 #define MAIN_GROM ((u16*)0x0689A000)   // 24K of fast VDP memory for the system console GROM cache
 #define MAIN_BIOS ((u16*)0x068A0000)   // 8K  of fast VDP memory for the main TI-99 BIOS cache
 #define DISK_DSR  ((u16*)0x068A2000)   // 8K  of fast VDP memory for the Disk Controller DSR cache
@@ -95,7 +123,7 @@ typedef struct
 
 extern u16 emuFps;
 extern u16 emuActFrames;
-extern u16 timingFrames;
+extern MACHINE_LOCAL u16 timingFrames;
 extern u8  alpha_lock;
 
 extern u16 nds_key;
@@ -110,7 +138,7 @@ extern u8  bShowDebug;
 
 extern int bg0, bg1, bg0b,bg1b;
 
-extern u16 *pVidFlipBuf;                         // Video flipping buffer
+extern MACHINE_LOCAL u16 *pVidFlipBuf;           // Video flipping buffer
 
 extern void showMainMenu(void);
 extern void InitBottomScreen(void);
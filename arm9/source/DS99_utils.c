@@ -40,14 +40,14 @@ FIC_TI99 gpDsk[MAX_DISKS];
 char szName[256];
 char szDiskName[256];
 char szFile[256];
-u32 file_size = 0;
-char currentDirROMs[MAX_PATH];
-char currentDirDSKs[MAX_PATH];
+MACHINE_LOCAL u32 file_size = 0;
+MACHINE_LOCAL char currentDirROMs[MAX_PATH];
+MACHINE_LOCAL char currentDirDSKs[MAX_PATH];
 char strBuf[40];
 
-struct GlobalConfig_t globalConfig;
+MACHINE_LOCAL struct GlobalConfig_t globalConfig;
 struct Config_t AllConfigs[MAX_CONFIGS];
-struct Config_t myConfig __attribute((aligned(4))) __attribute__((section(".dtcm")));
+MACHINE_DTCM  struct Config_t myConfig __attribute((aligned(4)));
 extern u32 file_crc;
 
 extern char myDskFile[];
@@ -1170,8 +1170,8 @@ void SetDefaultGameConfig(void)
     myConfig.machineType = globalConfig.machineType;
     myConfig.cartType    = 0;   // Normal
     myConfig.dpadDiagonal= 0;   // Normal
-    myConfig.spriteCheck = 0;   // Normal
     myConfig.sounddriver = 0;   // Default to having speech module attached
+    myConfig.reservedI   = 0;
     myConfig.reservedJ   = 0;
     myConfig.reservedK   = 0;
     myConfig.reservedL   = 0;
@@ -1213,46 +1213,7 @@ void SetDefaultGameConfig(void)
     if (file_crc == 0xcf6c8d64) myConfig.dpadDiagonal = 1;  // Topper wants to use diagonal directions
     if (file_crc == 0x3c124691) myConfig.dpadDiagonal = 1;  // Topper wants to use diagonal directions
 
-    if (file_crc == 0x2715313f) myConfig.spriteCheck = 2;   // The megademo ROM needs it this fast at least
-    if (file_crc == 0xe92f15ff) myConfig.spriteCheck = 2;   // The megademo DSK needs it this fast at least
-
-    if (file_crc == 0x0e34d709) myConfig.sounddriver = 2;   // Dragon's Lair Demo needs the new Direct Wave handling for speech
-
-    if (file_crc == 0x478d9835) myConfig.RAMMirrors = 1;    // TI-99/4a Congo Bongo requires RAM mirrors to run properly
-    if (file_crc == 0x5f85e8ed) myConfig.RAMMirrors = 1;    // TI-99/4a Congo Bongo requires RAM mirrors to run properly (32K FinalGrom ver)
-    if (file_crc == 0x0b9ad832) myConfig.RAMMirrors = 1;    // TI-99/4a Buck Rogers requires RAM mirrors to run properly
-
-    if (file_crc == 0x3f4c4fe5) myConfig.machineType = MACH_TYPE_SAMS; // Dungeons of Asgard 0.4.0 uses SAMS
-    if (file_crc == 0x32b842e2) myConfig.machineType = MACH_TYPE_SAMS; // Dungeons of Asgard 0.5.0 uses SAMS
-    
-    if (file_crc == 0x6b911b91) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Meteor Belt requires MBX 1K of RAM
-    if (file_crc == 0xe4ce86f5) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Meteor Belt requires MBX 1K of RAM
-    if (file_crc == 0xd872e83e) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Bigfoot requires MBX 1K of RAM
-    if (file_crc == 0xc883dde6) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Bigfoot requires MBX 1K of RAM
-    if (file_crc == 0x2807a67f) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // SuperFly requires MBX 1K of RAM
-    if (file_crc == 0x06da3412) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // SuperFly requires MBX 1K of RAM
-    if (file_crc == 0x60e66ab1) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Space Bandits requires MBX 1K of RAM
-    if (file_crc == 0xc7f74062) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Space Bandits requires MBX 1K of RAM
-    if (file_crc == 0xbc245f56) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Honey Hunt requires MBX 1K of RAM
-    if (file_crc == 0x2e071ff6) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Honey Hunt requires MBX 1K of RAM
-    if (file_crc == 0x4bb77ca1) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Soundtrack Trolley requires MBX 1K of RAM
-    if (file_crc == 0xd35f2c0d) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Soundtrack Trolley requires MBX 1K of RAM
-    if (file_crc == 0x962aca6f) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Sewermania requires MBX 1K of RAM
-    if (file_crc == 0xb33dabfe) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Sewermania requires MBX 1K of RAM
-
-    if (file_crc == 0x2abf46b5) myConfig.cartType = CART_TYPE_SUPERCART;     // Editor Assembler is even more useful with the Supercart memory (6K GROM)
-    if (file_crc == 0x4d338098) myConfig.cartType = CART_TYPE_SUPERCART;     // Editor Assembler is even more useful with the Supercart memory (8K GROM with padded 2K zeros)
-    if (file_crc == 0x132819fa) myConfig.cartType = CART_TYPE_SUPERCART;     // VA SuperSpace uses Supercart memory
-    if (file_crc == 0xd8f49994) myConfig.cartType = CART_TYPE_SUPERCART;     // Super Space Cart where the 8K 'C' file is all zeroes
-    if (file_crc == 0x011ffca6) myConfig.cartType = CART_TYPE_SUPERCART;     // Super Space Cart where the 32K 'C' file is all zeroes
-
-    if (file_crc == 0xc705118e) myConfig.cartType = CART_TYPE_MINIMEM;       // The Mini-Memory module uses this special carttype
-    if (file_crc == 0xe0bc224d) myConfig.cartType = CART_TYPE_MINIMEM;       // The Mini-Memory module uses this special carttype
-    if (file_crc == 0x134144dc) myConfig.cartType = CART_TYPE_MINIMEM;       // The Mini-Memory module uses this special carttype
-
-    // If the filename of the chosen cart contains _cru just before the extension, we assume this is one of the Databiotics Paged CRU types
-    if (strstr(gpFic[ucGameChoice].szName, "_cru.") != NULL) myConfig.cartType = CART_TYPE_PAGEDCRU;
-    if (strstr(gpFic[ucGameChoice].szName, "_CRU.") != NULL) myConfig.cartType = CART_TYPE_PAGEDCRU;
+    ApplyGameQuirks(gpFic[ucGameChoice].szName);  // The per-game settings the emulation itself depends on
 }
 
 // -------------------------------------------------------------------------
@@ -1349,7 +1310,6 @@ const struct options_t Option_Table[2][20] =
         {"CAPS LOCK",      {"OFF", "ON"},                                                                                                    &myConfig.capsLock,     2},
         {"RAM MIRRORS",    {"OFF", "ON"},                                                                                                    &myConfig.RAMMirrors,   2},
         {"RAM WIPE",       {"CLEAR", "RANDOM",},                                                                                             &myConfig.memWipe,      2},
-        {"SPRITE CHECK",   {"NORMAL (32/64)", "4 SCANLINES", "8 SCANLINES", "16 SCANLINES", "32 SCANLINES", "64 SCANLINES", "END OF FRAME"}, &myConfig.spriteCheck,  7},
         {"SOUND DRIVER",   {"NORMAL", "NO SPEECH", "WAVE DIRECT"},                                                                           &myConfig.sounddriver,  3},
         {"NDS DPAD",       {"NORMAL", "DIAGONALS",},                                                                                         &myConfig.dpadDiagonal, 2},
         {NULL,             {"",      ""},                                                                                                    NULL,                   1},
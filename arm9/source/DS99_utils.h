@@ -12,6 +12,8 @@
 #ifndef _DS99_UTILS_H_
 #define _DS99_UTILS_H_
 
+#include "DS99.h"
+
 #define MAX_ROMS                512
 #define MAX_DISKS               256
 #define MAX_ROM_LENGTH          127
@@ -84,7 +86,7 @@ struct __attribute__((__packed__)) Config_t
     u8  machineType;
     u8  cartType;
     u8  dpadDiagonal;
-    u8  spriteCheck;
+    u8  reservedI;
     u8  sounddriver;
     u8  reservedJ;
     u8  reservedK;
@@ -98,11 +100,11 @@ struct __attribute__((__packed__)) Config_t
     u8  reservedZ;
 };
 
-extern struct Config_t myConfig;
-extern struct GlobalConfig_t globalConfig;
+extern MACHINE_LOCAL struct Config_t myConfig;
+extern MACHINE_LOCAL struct GlobalConfig_t globalConfig;
 
-extern char currentDirROMs[];
-extern char currentDirDSKs[];
+extern MACHINE_LOCAL char currentDirROMs[];
+extern MACHINE_LOCAL char currentDirDSKs[];
 
 extern void FindAndLoadConfig(void);
 
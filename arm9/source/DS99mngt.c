@@ -31,7 +31,7 @@
 #include "SAMS.h"
 #include "speech.h"
 
-u32 file_crc __attribute__((section(".dtcm")))  = 0x00000000;  // Our global file CRC32 to uniquiely identify this game. For split files (C/D/G) it will be the CRC of the main file (C or G if no C)
+MACHINE_DTCM  u32 file_crc = 0x00000000;  // Our global file CRC32 to uniquiely identify this game. For split files (C/D/G) it will be the CRC of the main file (C or G if no C)
 
 // ---------------------------------------------------------------------------
 // Setup the main DS video modes. As usual, the top screen is primary and
@@ -116,7 +116,7 @@ u8 TI99Init(char *szGame, u8 bInitDisks)
     // ------------------------------------------------------------------
     // Grab the main 16-bit console ROM and place into our MemCPU[]
     // ------------------------------------------------------------------
-    memcpy(&MemCPU[0], MAIN_BIOS, 0x2000);
+    TMS9900_CopyWords(&MemCPU[0], MAIN_BIOS, 0x2000);   // Into native word order as we copy
 
     // ------------------------------------------------------------------
     // Grab the system console GROM and place into our MemGROM[]
@@ -333,10 +333,24 @@ u8 TI99Init(char *szGame, u8 bInitDisks)
         }
     }
 
+    // -----------------------------------------------------------------------------------
+    // All of the cart loaders above work in the TI's byte order (exactly as the files are
+    // laid out) so now we flip the cart ROM and the first bank at >6000 into our native
+    // word order. For the p-code card only the 64K of ROM is swapped - its GROM that sits
+    // just above is byte-wide and stays as-is. We don't bother with the full cart buffer
+    // when the bank mask tells us how much was actually loaded.
+    // -----------------------------------------------------------------------------------
+    u32 cartBytes = pCodeEmulation ? 0x10000 : (((u32)tms9900.bankMask + 1) * 0x2000);
+    if (cartBytes < 0x10000) cartBytes = 0x10000;
+    if (cartBytes > MAX_CART_SIZE) cartBytes = MAX_CART_SIZE;
+    TMS9900_SwapWords(MemCART, cartBytes);
+    TMS9900_SwapWords(MemCPU+0x6000, 0x2000);
+
     // -----------------------------------------------------------------------------
     // Ensure we're in the first bank... (which might be the only bank for 8K ROMs)
     // -----------------------------------------------------------------------------
     tms9900.cartBankPtr = MemCPU+0x6000;
+    TMS9900_MapMemory(0x0000, 0xFFFF);  // The cart may have changed the memory map (Super Cart, MBX, etc.) so rebuild the page table
 
     // -----------------------------------------------------------------------
     // If bInitDisks parameter is TRUE, we look and load up any .dsk files 
@@ -359,7 +373,7 @@ u8 TI99Init(char *szGame, u8 bInitDisks)
             FILE *infile = fopen(tmpBuf, "rb");
             if (infile) // Does the .dsk file exist?
             {
-                extern char currentDirDSKs[];
+                extern MACHINE_LOCAL char currentDirDSKs[];
                 fclose(infile);
                 getcwd(currentDirDSKs, MAX_PATH);
                 disk_mount(drivesel, currentDirDSKs, tmpBuf);
@@ -382,7 +396,7 @@ u8 TI99Init(char *szGame, u8 bInitDisks)
             FILE *infile = fopen(tmpBuf, "rb");
             if (infile) // Does the .dsk file exist?
             {
-                extern char currentDirDSKs[];
+                extern MACHINE_LOCAL char currentDirDSKs[];
                 fclose(infile);
                 getcwd(currentDirDSKs, MAX_PATH);
                 disk_mount(drivesel, currentDirDSKs, tmpBuf);
@@ -441,7 +455,7 @@ void TI99SetPal(void)
 // --------------------------------------------------------------------------
 ITCM_CODE void TI99UpdateScreen(void)
 {
-    extern u16 timingFrames;
+    extern MACHINE_LOCAL u16 timingFrames;
     // ------------------------------------------------------------
     // If we are in 'blendMode' we will OR the last two frames.
     // This helps on some games where things are just 1 pixel
@@ -471,12 +485,15 @@ ITCM_CODE void TI99UpdateScreen(void)
           }
       }
     }
-    else
+    else if (VDPFrameDirty)
     {
         // -----------------------------------------------------------------
         // Not blend mode... just blast it out via DMA as fast as we can...
+        // If not a single line was drawn this frame the screen is already
+        // showing exactly what is in XBuf and there is nothing to copy.
         // -----------------------------------------------------------------
         dmaCopyWordsAsynch(2, (u32*)XBuf_A, (u32*)pVidFlipBuf, 256*192);
+        VDPFrameDirty = 0;
     }
 }
 
@@ -493,31 +510,122 @@ void getfile_crc(const char *path)
 }
 
 
+// --------------------------------------------------------------------------
+// The handful of games that won't run right without a particular machine or
+// cart setup (or sound driver). These are the settings the emulation itself
+// depends on - shared by SetDefaultGameConfig() and the host build so that
+// every build runs a given cart the same way. Keyed on file_crc so that must
+// be computed first.
+// --------------------------------------------------------------------------
+void ApplyGameQuirks(const char *filename)
+{
+    if (file_crc == 0x0e34d709) myConfig.sounddriver = 2;   // Dragon's Lair Demo needs the new Direct Wave handling for speech
+
+    if (file_crc == 0x478d9835) myConfig.RAMMirrors = 1;    // TI-99/4a Congo Bongo requires RAM mirrors to run properly
+    if (file_crc == 0x5f85e8ed) myConfig.RAMMirrors = 1;    // TI-99/4a Congo Bongo requires RAM mirrors to run properly (32K FinalGrom ver)
+    if (file_crc == 0x0b9ad832) myConfig.RAMMirrors = 1;    // TI-99/4a Buck Rogers requires RAM mirrors to run properly
+
+    if (file_crc == 0x3f4c4fe5) myConfig.machineType = MACH_TYPE_SAMS; // Dungeons of Asgard 0.4.0 uses SAMS
+    if (file_crc == 0x32b842e2) myConfig.machineType = MACH_TYPE_SAMS; // Dungeons of Asgard 0.5.0 uses SAMS
+
+    if (file_crc == 0x6b911b91) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Meteor Belt requires MBX 1K of RAM
+    if (file_crc == 0xe4ce86f5) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Meteor Belt requires MBX 1K of RAM
+    if (file_crc == 0xd872e83e) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Bigfoot requires MBX 1K of RAM
+    if (file_crc == 0xc883dde6) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Bigfoot requires MBX 1K of RAM
+    if (file_crc == 0x2807a67f) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // SuperFly requires MBX 1K of RAM
+    if (file_crc == 0x06da3412) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // SuperFly requires MBX 1K of RAM
+    if (file_crc == 0x60e66ab1) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Space Bandits requires MBX 1K of RAM
+    if (file_crc == 0xc7f74062) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Space Bandits requires MBX 1K of RAM
+    if (file_crc == 0xbc245f56) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Honey Hunt requires MBX 1K of RAM
+    if (file_crc == 0x2e071ff6) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Honey Hunt requires MBX 1K of RAM
+    if (file_crc == 0x4bb77ca1) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Soundtrack Trolley requires MBX 1K of RAM
+    if (file_crc == 0xd35f2c0d) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Soundtrack Trolley requires MBX 1K of RAM
+    if (file_crc == 0x962aca6f) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Sewermania requires MBX 1K of RAM
+    if (file_crc == 0xb33dabfe) myConfig.cartType = CART_TYPE_MBX_WITH_RAM;  // Sewermania requires MBX 1K of RAM
+
+    if (file_crc == 0x2abf46b5) myConfig.cartType = CART_TYPE_SUPERCART;     // Editor Assembler is even more useful with the Supercart memory (6K GROM)
+    if (file_crc == 0x4d338098) myConfig.cartType = CART_TYPE_SUPERCART;     // Editor Assembler is even more useful with the Supercart memory (8K GROM with padded 2K zeros)
+    if (file_crc == 0x132819fa) myConfig.cartType = CART_TYPE_SUPERCART;     // VA SuperSpace uses Supercart memory
+    if (file_crc == 0xd8f49994) myConfig.cartType = CART_TYPE_SUPERCART;     // Super Space Cart where the 8K 'C' file is all zeroes
+    if (file_crc == 0x011ffca6) myConfig.cartType = CART_TYPE_SUPERCART;     // Super Space Cart where the 32K 'C' file is all zeroes
+
+    if (file_crc == 0xc705118e) myConfig.cartType = CART_TYPE_MINIMEM;       // The Mini-Memory module uses this special carttype
+    if (file_crc == 0xe0bc224d) myConfig.cartType = CART_TYPE_MINIMEM;       // The Mini-Memory module uses this special carttype
+    if (file_crc == 0x134144dc) myConfig.cartType = CART_TYPE_MINIMEM;       // The Mini-Memory module uses this special carttype
+
+    // If the filename of the chosen cart contains _cru just before the extension, we assume this is one of the Databiotics Paged CRU types
+    if (strstr(filename, "_cru.") != NULL) myConfig.cartType = CART_TYPE_PAGEDCRU;
+    if (strstr(filename, "_CRU.") != NULL) myConfig.cartType = CART_TYPE_PAGEDCRU;
+}
+
 // --------------------------------------------------------------------------------
 // The main CPU loop... here we run one scanline of CPU instructions and then go
 // check in with the VDP video chip to see if we are done rendering a frame...
+//
+// The end of the scanline is just another scheduled event (see the event table
+// in tms9900.h) alongside the TMS9901 timer. Scanlines outside the active area
+// don't do anything in Loop9918() so we fold them into one long run of the CPU
+// and catch the VDP up afterwards - the CPU doesn't care where it stopped.
 // --------------------------------------------------------------------------------
 ITCM_CODE u32 LoopTMS9900()
 {
+    u16 lines = 1;
+
+    // ------------------------------------------------------------------------
+    // Count how many of the upcoming scanlines have nothing for the VDP to
+    // do... unless Wave Direct audio is sampling on every single scanline.
+    // ------------------------------------------------------------------------
+    if (myConfig.sounddriver != 2)
+    {
+        u16 line = CurLine;
+        for (;;)
+        {
+            if (++line >= tms_num_lines) line = 0;
+            if ((line >= tms_start_line) && (line <= tms_end_line)) break;
+            lines++;
+        }
+    }
+
+    u32 lineEnd = tms9900.cycles + (228 * lines) - tms9900.cycleDelta;   // There are 228 CPU clocks per line on the TI
+    TMS9900_ScheduleEvent(EVENT_VDP_LINE, lineEnd);
+
     // -----------------------------------------------------------------
-    // Run one scanline worth of CPU instructions.
+    // Run the CPU up to the end of the scanline(s)...
     //
     // Accurate emulation is enabled if we see an IDLE instruction or
-    // TIMER enabled or SAMS use as all these need special attention.
-    // Most games don't need this handling and we save the precious DS
-    // CPU cycles as this is 10-15% slower.
+    // SAMS use as these need special attention. Most games don't need
+    // this handling and we save the precious DS CPU cycles as this is
+    // 10-15% slower. The 9901 timer expiring along the way drops us
+    // back here to deal with it before we carry on.
     // -----------------------------------------------------------------
-    if (tms9900.accurateEmuFlags) TMS9900_RunAccurate();
-    else TMS9900_Run();
+    do
+    {
+        if (tms9900.accurateEmuFlags) TMS9900_RunAccurate();
+        else TMS9900_Run();
+
+        if (TMS9900_EventDue(EVENT_TIMER)) TMS9901_TimerEvent();
+    }
+    while (!TMS9900_EventDue(EVENT_VDP_LINE));
 
-    // Refresh VDP for this scanline
-    if(Loop9918())
+    TMS9900_CancelEvent(EVENT_VDP_LINE);
+    tms9900.cycleDelta = tms9900.cycles - lineEnd;
+
+    // Refresh VDP for the scanline(s)
+    while (lines--)
     {
-        TMS9901_RaiseVDPInterrupt();
+        if(Loop9918())
+        {
+            TMS9901_RaiseVDPInterrupt();
+        }
     }
 
     // Drop out unless end of screen is reached
-    return ((CurLine == tms_end_line) ? 0:1);
+    if (CurLine == tms_end_line)
+    {
+        TMS9900_CheckAccurateUsage();   // Once a frame - see if we can go back to the fast core
+        return 0;
+    }
+    return 1;
 }
 
 // End of file
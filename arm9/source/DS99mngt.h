@@ -17,8 +17,8 @@
 #include "cpu/tms9918a/tms9918a.h"
 #include "cpu/sn76496/SN76496.h"
 
-extern u32 file_crc;
-extern SN76496 snti99;
+extern MACHINE_LOCAL u32 file_crc;
+extern MACHINE_LOCAL SN76496 snti99;
 
 // --------------------------------------------------
 // Some CPU and VDP and SGM stuff that we need
@@ -29,6 +29,7 @@ extern void TI99SetPal(void);
 extern void TI99UpdateScreen(void);
 extern void TI99Run(void);
 extern void getfile_crc(const char *path);
+extern void ApplyGameQuirks(const char *filename);
 extern void TI99LoadState();
 extern void TI99SaveState();
 extern u8 loadrom(const char *path,u8 * ptr, int nmemb);
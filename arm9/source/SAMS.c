@@ -26,9 +26,9 @@
 #include "cpu/tms9900/tms9900.h"
 #include "cpu/sn76496/SN76496.h"
 
-u8 *MemSAMS             __attribute__((section(".dtcm"))) = 0;  // Allocated to support 512K for DS-Lite and 1MB for DSi and above
-SAMS theSAMS            __attribute__((section(".dtcm")));      // The entire state of the SAMS memory map handler
-u8 sams_highwater_bank  __attribute__((section(".dtcm"))) = 0;  // To track how far into SAMS memory we used
+MACHINE_DTCM  u8 *MemSAMS = 0;              // Allocated to support 512K for DS-Lite and 1MB for DSi and above
+MACHINE_DTCM  SAMS theSAMS;                 // The entire state of the SAMS memory map handler
+MACHINE_DTCM  u8 sams_highwater_bank = 0;   // To track how far into SAMS memory we used
 
 // ---------------------------------------------------------------------------------------
 // SAMS is handled via the CRU and has registers mapped into the DSR space but it does
@@ -93,13 +93,14 @@ void SAMS_Initialize(void)
     // --------------------------------------------------------------------------
     memset(MemSAMS, 0x00, ((theSAMS.numBanks) * 0x1000));
 
-    // -----------------------------------------------------------------
-    // If we are configured for SAMS operation... set the accuracy flag
-    // to map in slower (but more accurate) mapping.
-    // -----------------------------------------------------------------
+    // -------------------------------------------------------------------
+    // If we are configured for SAMS operation... start out with the
+    // registers hidden and the mapper in pass-thru. The bank switches
+    // just re-point the CPU page table so there is no need for the
+    // slower accurate core - SAMS runs on TMS9900_Run() like anything.
+    // -------------------------------------------------------------------
     if (myConfig.machineType == MACH_TYPE_SAMS)
     {
-        TMS9900_SetAccurateEmulationFlag(ACCURATE_EMU_SAMS);
         SAMS_cru_write(0,0);    // Swap out the visibility of the SAMS memory mapped registers (so they are not visible)
         SAMS_cru_write(1,0);    // Mapper Disabled... (pass-thru mode which is basically like having a 32K expansion)
 
@@ -131,12 +132,28 @@ inline void SAMS_SwapBank(u8 memory_region, u8 bank)
     {
         if (IsSwappableSAMS[(memory_region&0xF)])    // Make sure this is an area we allow swapping...
         {
-            theSAMS.memoryPtr[memory_region] = MemSAMS + ((u32)bank * 0x1000);
+            u8 *ptr = MemSAMS + ((u32)bank * 0x1000);
+            if (theSAMS.memoryPtr[memory_region] != ptr) TMS9900_SAMSBankChanged();  // Any code cached from the old bank is no longer there
+            theSAMS.memoryPtr[memory_region] = ptr;
             if (bank > sams_highwater_bank) sams_highwater_bank = bank;
+            TMS9900_MapMemory((u16)memory_region << 12, ((u16)memory_region << 12) | 0x0FFF);  // Point the CPU pages at the new bank
         }
     }
 }
 
+// -------------------------------------------------------------------------------------------
+// Is the bank in this region also mapped into some other region? Nothing stops a program from
+// doing that and then a write through one address shows up at the other address as well.
+// -------------------------------------------------------------------------------------------
+u8 SAMS_IsAliased(u8 memory_region)
+{
+    for (u8 region=0; region<16; region++)
+    {
+        if ((region != memory_region) && IsSwappableSAMS[region] && (theSAMS.memoryPtr[region] == theSAMS.memoryPtr[memory_region])) return 1;
+    }
+    return 0;
+}
+
 // -------------------------------------------------------------------------------------------
 // The SAMS banks are 4K and we only allow mapping of the banks at >2000-3FFF and >A000-FFFF
 // -------------------------------------------------------------------------------------------
@@ -249,6 +266,7 @@ void SAMS_EnableDisable(u8 dataBit)
             MemType[address>>4] = MF_PERIF;    // Map back to original handling (peripheral ROM)
         }
     }
+    TMS9900_MapMemory(0x4000, 0x40FF);
 }
 
 // --------------------------------------------------------------------------------------------------
@@ -258,13 +276,14 @@ void SAMS_EnableDisable(u8 dataBit)
 u32 SAMS_Read32(u32 address)
 {
     u32* ptr = (u32*)MemSAMS;
-    return ptr[address>>2];
+    u32 data = ptr[address>>2];
+    return ((data & 0x00FF00FF) << 8) | ((data >> 8) & 0x00FF00FF);    // Back to the TI byte order for the save file
 }
 
 void SAMS_Write32(u32 address, u32 data)
 {
     u32* ptr = (u32*)MemSAMS;
-    ptr[address>>2] = data;
+    ptr[address>>2] = ((data & 0x00FF00FF) << 8) | ((data >> 8) & 0x00FF00FF); // Into our native word order
 }
 
 
@@ -14,6 +14,7 @@
 
 #include <nds.h>
 #include <string.h>
+#include "DS99.h"
 
 // ----------------------------------------------------------------------------
 // The entire state of the SAMS memory expansion card for easy access
@@ -26,10 +27,10 @@ typedef struct _SAMS
     u8     *memoryPtr[16];      // Where do the 16 regions of 4K point to
 } SAMS;
 
-extern SAMS theSAMS;
+extern MACHINE_LOCAL SAMS theSAMS;
 
-extern u8 *MemSAMS;
-extern u8 sams_highwater_bank;
+extern MACHINE_LOCAL u8 *MemSAMS;
+extern MACHINE_LOCAL u8 sams_highwater_bank;
 
 extern void SAMS_Initialize(void);
 extern void SAMS_WriteBank(u16 address, u8 data);
@@ -37,6 +38,7 @@ extern u8   SAMS_ReadBank(u16 address);
 extern u8   SAMS_cru_read(u16 cruAddress);
 extern void SAMS_cru_write(u16 cruAddress, u8 dataBit);
 extern void SAMS_EnableDisable(u8 dataBit);
+extern u8   SAMS_IsAliased(u8 memory_region);
 extern u32  SAMS_Read32(u32 address);
 extern void SAMS_Write32(u32 address, u32 data);
     
@@ -58,49 +58,178 @@
 // also a separate 16K of VDP memory and 4096 bits of CRU memory...
 // heck, this system has more memories than a Harry Potter Pensieve.
 // ------------------------------------------------------------------
-u8      MemCPU[0x10000];            // 64K of CPU Space  (the lower 8K will contain the system console ROM)
-u8      MemGROM[0x10000];           // 64K of GROM Space (the lower 24K will contain system GROMs)
+MACHINE_LOCAL u8      MemCPU[0x10000];            // 64K of CPU Space  (the lower 8K will contain the system console ROM)
+MACHINE_LOCAL u8      MemGROM[0x10000];           // 64K of GROM Space (the lower 24K will contain system GROMs)
 
 // ----------------------------------------------------------------------------------------------
 // Memory type for each address. We divide by 16 which allows for higher density memory lookups.
 // This is fine for all but MBX which has special handling. Since this is accessed very often,
 // we place it in fast memory though it does chew up a solid 4K of that memory...
 // ----------------------------------------------------------------------------------------------
-u8      MemType[0x10000>>4] __attribute__((section(".dtcm")));
+MACHINE_DTCM  u8      MemType[0x10000>>4];
 
-u8     *MemCART  __attribute__((section(".dtcm")));     // Cart C/D/8/9 memory up to 8MB/512K (DSi vs DS) banked at >6000
-u32     MAX_CART_SIZE = (512*1024);                     // Allow carts up to 512K in size (DSi will bump this to 8MB)
+// ----------------------------------------------------------------------------------------------
+// The page table the memory handlers actually run from - see TMS9900_MapMemory(). MemType[]
+// is still the master map of what lives where... these are just rebuilt from it whenever it
+// (or a cart bank or SAMS bank) changes.
+// ----------------------------------------------------------------------------------------------
+MACHINE_LOCAL u8     *PageRead[PAGE_COUNT];
+MACHINE_LOCAL u8     *PageWrite[PAGE_COUNT];
+MACHINE_LOCAL u8      PageFlags[PAGE_COUNT];
+MACHINE_LOCAL u8      PageTrap[PAGE_COUNT];       // Set for any page holding a PC trap - see TMS9900_AddTrap()
+MACHINE_LOCAL u16   (*PageRead16[PAGE_COUNT])(u16 address);
+MACHINE_LOCAL u8    (*PageRead8[PAGE_COUNT])(u16 address);
+MACHINE_LOCAL void  (*PageWrite16[PAGE_COUNT])(u16 address, u16 data);
+MACHINE_LOCAL void  (*PageWrite8[PAGE_COUNT])(u16 address, u8 data);
 
-TMS9900 tms9900  __attribute__((section(".dtcm")));  // Put the entire TMS9900 set of registers and helper vars into fast .DTCM RAM on the DS
+MACHINE_DTCM  u8     *MemCART;                                        // Cart C/D/8/9 memory up to 8MB/512K (DSi vs DS) banked at >6000
+MACHINE_LOCAL u32     MAX_CART_SIZE = (512*1024);                     // Allow carts up to 512K in size (DSi will bump this to 8MB)
+
+MACHINE_DTCM  TMS9900 tms9900;  // Put the entire TMS9900 set of registers and helper vars into fast .DTCM RAM on the DS
 
 #define OpcodeLookup            ((u16*)0x06820000)   // We use 128K of semi-fast VDP memory to help with the OpcodeLookup[] lookup table (normally VRAM_B)
 #define CompareZeroLookup16     ((u16*)0x06860000)   // We use 128K of semi-fast VDP memory to help with the CompareZeroLookup16[] lookup table (normally VRAM_D)
 
 #define AddCycleCount(x) (tms9900.cycles += (x))     // Our main way of bumping up the cycle counts during execution - each opcode handles their own timing increments
 
+// ------------------------------------------------------------------------------------
+// The host build (see host/ folder) counts instructions so the benchmark runner can
+// report a throughput number. On the DS this compiles away to nothing.
+// ------------------------------------------------------------------------------------
+#ifdef DS99_HOST
+MACHINE_LOCAL u32 tms9900_instructions = 0;
+#define CountInstruction() (tms9900_instructions++)
+#else
+#define CountInstruction()
+#endif
+
+// ------------------------------------------------------------------------------------
+// Host build with TMS9900_PAIR_HISTOGRAM (make PAIR_HISTOGRAM=1) counts how often each
+// pair of pre-decoded instructions runs back to back within a block. This is what the
+// fused pairs were picked from (see BlockFuse()) - ds99bench prints the top pairs. The
+// pairs are not fused in this build so that every one of them gets counted.
+// ------------------------------------------------------------------------------------
+#ifdef TMS9900_PAIR_HISTOGRAM
+u32 TMS9900_PairHistogram[256][256];
+#define CountPair() if (instr != block->instr) TMS9900_PairHistogram[instr[-1].op8][instr->op8]++
+#else
+#define CountPair()
+#endif
+
+// ---------------------------------------------------------------------------------------------------
+// The opcode handlers in tms9900.inc start with OPCODE() and end with NEXT_OPCODE. Normally that
+// is just a big switch. Define TMS9900_THREADED_DISPATCH (GCC only - it needs 'labels as values')
+// and instead every handler fetches the next instruction itself and jumps straight to the next
+// handler through the OpcodeDispatch[] table. That saves the switch bounds check and the branch
+// back to the top of the loop (and on CPUs with a branch predictor, each handler gets its own
+// indirect branch) but it replicates the fetch into every handler which costs a fair chunk of
+// ITCM - so for now it's an option to benchmark with rather than the default.
+// ---------------------------------------------------------------------------------------------------
+#if defined(TMS9900_THREADED_DISPATCH) && defined(__GNUC__)
+  #define THREADED_DISPATCH
+  #define OPCODE_LABEL(op)      L_##op
+  #define OPCODE(op)            OPCODE_LABEL(op)
+  #define OPCODE_DEFAULT        L_op_default
+#else
+  #define OPCODE(op)            case op
+  #define OPCODE_DEFAULT        default
+  #define NEXT_OPCODE           break
+#endif
+
 u16 MemoryRead16(u16 address);
 
 // Some carts use CRU banking... such as the Super Cart (or Super Space II) and some Databiotics carts
-u8  super_bank __attribute__((section(".dtcm"))) = 0;
-u8  cart_cru_shadow[16] = {0};
-
-u32 idle_counter = 0;   // Only used for debug purposes... so it doesn't need to be in fast memory
+MACHINE_DTCM  u8  super_bank = 0;
+MACHINE_LOCAL u8  cart_cru_shadow[16] = {0};
+
+MACHINE_LOCAL u32 idle_counter = 0;   // Only used for debug purposes... so it doesn't need to be in fast memory
+
+// ---------------------------------------------------------------------------------------------------
+// Usage tracking for the accurate core. The IDLE opcode sets idleSeen and once a frame we count up
+// how long it's been since anything needed the IDLE handling - see TMS9900_CheckAccurateUsage()
+// ---------------------------------------------------------------------------------------------------
+MACHINE_LOCAL u8  idleSeen = 0;
+MACHINE_LOCAL u16 accurateIdleFrames = 0;
+
+// ---------------------------------------------------------------------------------------------------
+// The event table - see TMS9900_ScheduleEvent(). eventNext is looked at after every instruction so
+// it goes into the fast DTCM memory along with the interrupt check flag.
+// ---------------------------------------------------------------------------------------------------
+MACHINE_DTCM  u32 eventNext = 0;
+MACHINE_DTCM  u8  intCheck = 0;
+MACHINE_LOCAL u32 eventCycle[EVENT_MAX];
+MACHINE_LOCAL u8  eventActive = 0;
+
+// The lazy status - see STATUS_SYNC() in tms9900.h. Touched by nearly every instruction so DTCM it is.
+MACHINE_DTCM  u16 statusResult = 0;
+MACHINE_DTCM  u8  statusLazy = 0;
 
 // A few externs from other modules...
-extern SN76496 snti99;
+extern MACHINE_LOCAL SN76496 snti99;
+
+// ---------------------------------------------------------------------------------
+// Supporting banking up to 8MB (1024 x 8KB = 8192KB) even though our cart buffer
+// might be smaller. Indexed by the number of banks minus one - the mask covers the
+// next power of two up. Generated at compile time (see TABLE_1024() in DS99.h).
+// ---------------------------------------------------------------------------------
+#define BANK_MASK(i)    (((i) < 1)   ? 0x0000 : ((i) < 2)   ? 0x0001 : ((i) < 4)   ? 0x0003 : ((i) < 8)  ? 0x0007 : \
+                         ((i) < 16)  ? 0x000F : ((i) < 32)  ? 0x001F : ((i) < 64)  ? 0x003F : ((i) < 128)? 0x007F : \
+                         ((i) < 256) ? 0x00FF : ((i) < 512) ? 0x01FF : 0x03FF)
+const u16 BankMasks[1024] = {TABLE_1024(BANK_MASK, 0)};
 
-// Supporting banking up to 8MB (1024 x 8KB = 8192KB) even though our cart buffer might be smaller
-u16 BankMasks[1024];
+// The odd parity of a byte - same answer as the Classic99 'black magic' bit counting loop
+#define PARITY8(i)      (((i) ^ ((i)>>1) ^ ((i)>>2) ^ ((i)>>3) ^ ((i)>>4) ^ ((i)>>5) ^ ((i)>>6) ^ ((i)>>7)) & 1)
 
-// Pre-fill the parity table for fast look-up based on Classic99 'black magic'
-u16 ParityTable[256]     __attribute__((section(".dtcm")));
+// The parity table for fast look-up - baked in at compile time
+#define PARITY_ENTRY(i) (PARITY8(i) ? ST_OP : 0)
+u16 ParityTable[256]     __attribute__((section(".dtcm"))) = {TABLE_256(PARITY_ENTRY, 0)};
 
 // ---------------------------------------------------------------------------------
 // And the Classic99 handling of compare-to-zero status bits for 8-bit instructions.
 // Note this will only handle LAE and P - other bits to be set by instruction.
 // This is small enough that we can place it into the fast .DTCM data memory.
 // ---------------------------------------------------------------------------------
-u16 CompareZeroLookup8[256] __attribute__((section(".dtcm")));
+#define COMPARE_ZERO8(i) (((i) ? ST_LGT : ST_EQ) | ((((i) > 0) && ((i) < 0x80)) ? ST_AGT : 0) | PARITY_ENTRY(i))
+u16 CompareZeroLookup8[256] __attribute__((section(".dtcm"))) = {TABLE_256(COMPARE_ZERO8, 0)};
+
+// ---------------------------------------------------------------------------------------------
+// The block cache lives in normal main RAM (not VRAM like the big opcode tables) so that the
+// ARM9 data cache can hold onto the hot blocks - we read these many times per instruction.
+// BlockCodeMark[] flags every 16-byte chunk of RAM that currently has a cached block in it
+// so that a write to that chunk can toss the RAM blocks. BlockSMCCount[] counts how often
+// that happens so we can stop caching code that is constantly re-writing itself.
+// ---------------------------------------------------------------------------------------------
+MACHINE_LOCAL TMS9900_Block   BlockCache[BLOCK_CACHE_SIZE] ALIGN(32);
+MACHINE_LOCAL TMS9900_Block   BlockScratch ALIGN(32);     // For the odd instruction we can't (or won't) cache - decoded and run once
+MACHINE_LOCAL u8              BlockCodeMark[0x10000>>4];
+MACHINE_LOCAL u8              BlockSMCCount[0x10000>>4];
+MACHINE_DTCM  u16             blockEpoch = 1;
+MACHINE_DTCM  u8              blockExit = 0;
+MACHINE_LOCAL u8              blockFusion = 1;            // Fuse common instruction pairs as blocks are built (the host JIT turns this off)
+static MACHINE_LOCAL u8       samsBlocksCached = 0;       // Set once we cache code from a SAMS bank - a bank switch must then toss the RAM blocks
+
+// ---------------------------------------------------------------------------------------------
+// The PC traps installed by TMS9900_AddTrap() - these survive a reset (the peripheral owns them)
+// ---------------------------------------------------------------------------------------------
+typedef struct
+{
+    u16   address;
+    void (*handler)(void);
+} TMS9900_Trap;
+
+static MACHINE_LOCAL TMS9900_Trap pcTraps[MAX_PC_TRAPS];
+static MACHINE_LOCAL u8           numPCTraps = 0;
+
+// ---------------------------------------------------------------------------------------------
+// The snapshot of the CPU taken at the top of a possible busy-wait loop - see TMS9900_SpinSkip()
+// ---------------------------------------------------------------------------------------------
+static MACHINE_LOCAL u16 spinPC = 1;          // Odd so it never matches until TMS9900_SpinEnter() has taken a snapshot
+static MACHINE_LOCAL u16 spinTail = 1;        // Where the SPIN_TAIL block closing the loop must start
+static MACHINE_LOCAL u8  spinInstr;           // Instructions in one iteration of the loop
+static MACHINE_LOCAL u16 spinWP, spinST, spinInt;
+static MACHINE_LOCAL u8  spinVDPStatus, spinVDPLatch;
+static MACHINE_LOCAL u32 spinCycles;
+static MACHINE_LOCAL u16 spinRegs[16];
 
 
 ////////////////////////////////////////////////////////////////////////////
@@ -319,10 +448,21 @@ void opcode0(u16 in)
 ////////////////////////////////////////////////////////////////////////
 // Fill the CPU Opcode Address table
 // WARNING: called more than once, so be careful about anything you can't do twice!
+// These two 128K tables live in VRAM which can't hold initialized data so
+// unlike the smaller tables above they are built here - just the once at
+// startup (right after the VRAM banks are mapped for CPU use) and again if
+// a screenshot borrows VRAM_D. Resetting or loading a cart leaves them be.
 ////////////////////////////////////////////////////////////////////////
+// ----------------------------------------------------------------------------------------------
+// For the Format I (two operand) opcodes, pick the handler from the Ts bits (5-4) and Td bits
+// (11-10) of the opcode. Register and indirect pairs get their own handler right after the
+// generic one... everything else uses the generic handler. See FORMAT1_MODE_PAIRS().
+// ----------------------------------------------------------------------------------------------
+#define FORMAT1_HANDLER(op, in)   (((in) & 0x0820) ? (op) : ((op) + 1 + ((((in)>>9) & 0x02) | (((in)>>4) & 0x01))))
+
 void TMS9900_buildopcodes(void)
 {
-    u16 in,x,z;
+    u16 in,x;
     unsigned int i;
 
     // -----------------------------------------------------
@@ -341,32 +481,22 @@ void TMS9900_buildopcodes(void)
         case 1: opcode1(in);             break;
         case 2: opcode2(in);             break;
         case 3: opcode3(in);             break;
-        case 4: OpcodeLookup[in]=op_szc; break;
-        case 5: OpcodeLookup[in]=op_szcb;break;
-        case 6: OpcodeLookup[in]=op_s;   break;
-        case 7: OpcodeLookup[in]=op_sb;  break;
-        case 8: OpcodeLookup[in]=op_c;   break;
-        case 9: OpcodeLookup[in]=op_cb;  break;
-        case 10:OpcodeLookup[in]=op_a;   break;
-        case 11:OpcodeLookup[in]=op_ab;  break;
-        case 12:OpcodeLookup[in]=op_mov; break;
-        case 13:OpcodeLookup[in]=op_movb;break;
-        case 14:OpcodeLookup[in]=op_soc; break;
-        case 15:OpcodeLookup[in]=op_socb;break;
+        case 4: OpcodeLookup[in]=FORMAT1_HANDLER(op_szc,   in); break;
+        case 5: OpcodeLookup[in]=FORMAT1_HANDLER(op_szcb,  in); break;
+        case 6: OpcodeLookup[in]=FORMAT1_HANDLER(op_s,     in); break;
+        case 7: OpcodeLookup[in]=FORMAT1_HANDLER(op_sb,    in); break;
+        case 8: OpcodeLookup[in]=FORMAT1_HANDLER(op_c,     in); break;
+        case 9: OpcodeLookup[in]=FORMAT1_HANDLER(op_cb,    in); break;
+        case 10:OpcodeLookup[in]=FORMAT1_HANDLER(op_a,     in); break;
+        case 11:OpcodeLookup[in]=FORMAT1_HANDLER(op_ab,    in); break;
+        case 12:OpcodeLookup[in]=FORMAT1_HANDLER(op_mov,   in); break;
+        case 13:OpcodeLookup[in]=FORMAT1_HANDLER(op_movb,  in); break;
+        case 14:OpcodeLookup[in]=FORMAT1_HANDLER(op_soc,   in); break;
+        case 15:OpcodeLookup[in]=FORMAT1_HANDLER(op_socb,  in); break;
         default: OpcodeLookup[in]=op_bad;break;
         }
     }
 
-    // ------------------------------------------
-    // Create the Parity Table for fast look-up
-    // ------------------------------------------
-    for (i=0; i<256; i++)
-    {
-        u8 x = i;
-        for (z=0; x; x&=(x-1)) z++;               // black magic?
-        ParityTable[i] = (z&1) ? ST_OP : 0;
-    }
-
     // build the Word status lookup table. This handles Logical, Arithmetic and Equal and
     // the other bits will be handled manually on a per-instruction basis...
     for (i=0; i<0x10000; i++)
@@ -379,23 +509,6 @@ void TMS9900_buildopcodes(void)
         // EQ
         if (i==0) CompareZeroLookup16[i]|=ST_EQ;
     }
-
-    // And now the Byte status lookup table. This handles Logical, Arithmetic and Equal plus Parity
-    // and the other bits will be handled manually on a per-instruction basis...
-    for (i=0; i<256; i++)
-    {
-        u8 x=(u8)(i&0xff);
-        CompareZeroLookup8[i]=0;
-        // LGT
-        if (i>0) CompareZeroLookup8[i]|=ST_LGT;
-        // AGT
-        if ((i>0)&&(i<0x80)) CompareZeroLookup8[i]|=ST_AGT;
-        // EQ
-        if (i==0) CompareZeroLookup8[i]|=ST_EQ;
-        // OP
-        for (z=0; x; x&=(x-1)) z++;                // black magic?
-        if (z&1) CompareZeroLookup8[i]|=ST_OP;     // set bit if an odd number
-    }
 }
 
 
@@ -409,30 +522,6 @@ void TMS9900_Reset(void)
     // -------------------------------------------------------------------------------------------------
     memset(&tms9900, 0x00, sizeof(tms9900));
 
-    // ----------------------------------------------------------------------------------------------
-    // This builds up the fast opcode lookup table based on the excellent Classic99 helper functions
-    // ----------------------------------------------------------------------------------------------
-    TMS9900_buildopcodes();
-
-    // ----------------------------------------------------------------------
-    // Fill in the BankMasks[] for any number of possible banks up to the
-    // full limit of 1024 banks (8MB of Cart Space!!)
-    // ----------------------------------------------------------------------
-    for (u16 numBanks=1; numBanks<=1024; numBanks++)
-    {
-        if      (numBanks <= 1)    BankMasks[numBanks-1] = 0x0000;  // No banking
-        else if (numBanks <= 2)    BankMasks[numBanks-1] = 0x0001;
-        else if (numBanks <= 4)    BankMasks[numBanks-1] = 0x0003;
-        else if (numBanks <= 8)    BankMasks[numBanks-1] = 0x0007;
-        else if (numBanks <= 16)   BankMasks[numBanks-1] = 0x000F;
-        else if (numBanks <= 32)   BankMasks[numBanks-1] = 0x001F;
-        else if (numBanks <= 64)   BankMasks[numBanks-1] = 0x003F;
-        else if (numBanks <= 128)  BankMasks[numBanks-1] = 0x007F;
-        else if (numBanks <= 256)  BankMasks[numBanks-1] = 0x00FF;
-        else if (numBanks <= 512)  BankMasks[numBanks-1] = 0x01FF;
-        else                       BankMasks[numBanks-1] = 0x03FF;
-    }
-
     // ---------------------------------------------------------------------------
     // Default all memory to MF_UNUSED until we prove otherwise below.
     // ---------------------------------------------------------------------------
@@ -535,10 +624,10 @@ void TMS9900_Reset(void)
         {
             // Same random value shows up in all mirrors....
             u8 val = rand() & 0xFF;
-            MemCPU[addr | 0x000] = (val);
-            MemCPU[addr | 0x100] = (val);
-            MemCPU[addr | 0x200] = (val);
-            MemCPU[addr | 0x300] = (val);
+            MemCPU[BYTE_LANE(addr | 0x000)] = (val);
+            MemCPU[BYTE_LANE(addr | 0x100)] = (val);
+            MemCPU[BYTE_LANE(addr | 0x200)] = (val);
+            MemCPU[BYTE_LANE(addr | 0x300)] = (val);
         }
     }
     else
@@ -552,11 +641,11 @@ void TMS9900_Reset(void)
     // ------------------------------------------------------------------------------------------
     for (u16 addr = 0x2000; addr < 0x4000; addr++)
     {
-        MemCPU[addr] = (addr & 1) ? 0x00 : 0xFF;
+        MemCPU[BYTE_LANE(addr)] = (addr & 1) ? 0x00 : 0xFF;
     }
     for (u32 addr = 0xA000; addr < 0x10000; addr++)
     {
-        MemCPU[addr] = (addr & 1) ? 0x00 : 0xFF;
+        MemCPU[BYTE_LANE(addr)] = (addr & 1) ? 0x00 : 0xFF;
     }
 
     // Reset the super cart bank to bank 0
@@ -564,6 +653,21 @@ void TMS9900_Reset(void)
     memset(cart_cru_shadow, 0x00, sizeof(cart_cru_shadow));
 
     idle_counter = 0;
+    idleSeen = 0;
+    accurateIdleFrames = 0;
+
+    // Nothing scheduled and no interrupt to look at
+    eventActive = 0;
+    eventNext = 0;
+    intCheck = 0;
+
+    // Start with an empty block cache - and forget about any self-modifying code we saw in the last game
+    memset(BlockSMCCount, 0x00, sizeof(BlockSMCCount));
+    TMS9900_FlushBlockCache();
+
+    // Build the page table from the memory map above - the cart will re-map its own pages once loaded
+    tms9900.cartBankPtr = MemCPU+0x6000;
+    TMS9900_MapMemory(0x0000, 0xFFFF);
 
     // Reset the TMS9901 peripheral IO chip
     TMS9901_Reset();
@@ -578,6 +682,7 @@ void TMS9900_Kickoff(void)
     tms9900.WP = MemoryRead16(0) & 0xFFFE;  // Initial WP is from the first word address in memory
     tms9900.PC = MemoryRead16(2) & 0xFFFE;  // Initial PC is from the second word address in memory
     tms9900.ST = 0x3cf0;                    // bulWIP uses this - probably doesn't matter... but smart guys know stuff...
+    statusLazy = 0;
 }
 
 // -----------------------------------------------------------------------------------------------
@@ -586,6 +691,44 @@ void TMS9900_Kickoff(void)
 void TMS9900_RaiseInterrupt(u16 iMask)
 {
     tms9900.cpuInt |= iMask; // The only interrupt we support is the VDP
+    intCheck = 1;            // Have the CPU look at the interrupt before the next instruction
+    blockExit = 1;           // Drop out of any cached block so the interrupt can be looked at
+}
+
+// ---------------------------------------------------------------------------------------------------
+// Schedule an event for the given CPU cycle (replacing any earlier schedule for the same event) and
+// work out which event is next. We compare against the current cycle count rather than the raw
+// cycle values so that the ordering still comes out right when the 32-bit cycle counter wraps.
+// ---------------------------------------------------------------------------------------------------
+static void TMS9900_FindNextEvent(void)
+{
+    u32 soonest = 0xFFFFFFFF;
+    u32 previous = eventNext;
+
+    eventNext = tms9900.cycles + 0x7FFFFFFF;    // Nothing scheduled? Then the CPU is free to run on...
+    for (u8 event=0; event<EVENT_MAX; event++)
+    {
+        if (eventActive & (1 << event))
+        {
+            u32 distance = eventCycle[event] - tms9900.cycles;
+            if ((s32)distance < 0) distance = 0;    // Already due
+            if (distance < soonest) {soonest = distance; eventNext = eventCycle[event];}
+        }
+    }
+    if ((s32)(eventNext - previous) < 0) blockExit = 1;  // Sooner than the CPU is running towards - make it look again
+}
+
+void TMS9900_ScheduleEvent(u8 event, u32 cycle)
+{
+    eventCycle[event] = cycle;
+    eventActive |= (1 << event);
+    TMS9900_FindNextEvent();
+}
+
+void TMS9900_CancelEvent(u8 event)
+{
+    eventActive &= ~(1 << event);
+    TMS9900_FindNextEvent();
 }
 
 // -----------------------------------------------------------------------------------------------
@@ -612,20 +755,43 @@ void TMS9900_ClearAccurateEmulationFlag(u16 flag)
     tms9900.accurateEmuFlags &= ~flag;
 }
 
+// -------------------------------------------------------------------------------------------------------
+// Called once per frame. Plenty of carts run an IDLE once during boot and then never again... so if IDLE
+// has not been run for a couple of seconds we drop that flag and go back to the fast TMS9900_Run() core.
+// The flag is put right back the moment the next IDLE is executed.
+// -------------------------------------------------------------------------------------------------------
+void TMS9900_CheckAccurateUsage(void)
+{
+    if (tms9900.accurateEmuFlags & ACCURATE_EMU_IDLE)
+    {
+        if (idleSeen || tms9900.idleReq) accurateIdleFrames = 0;
+        else if (++accurateIdleFrames >= ACCURATE_UNUSED_FRAMES)
+        {
+            TMS9900_ClearAccurateEmulationFlag(ACCURATE_EMU_IDLE);
+            accurateIdleFrames = 0;
+        }
+    }
+    idleSeen = 0;
+}
+
 //-----------------------------------------------------------------------------------------
 // The GROM increment takes into account that it's only really incrementing and wrapping
 // at the 8K boundary. The auto-increment should not bump the upper 3 bits which would,
 // effectively, select the next GROM in memory. This comes at a slight speed pentalty
 // but it's a minor enough hit and we want this to be bullet-accurate.
 //-----------------------------------------------------------------------------------------
-static inline __attribute__((always_inline)) u8 ReadGROM(void)
+static inline __attribute__((always_inline)) u8 ReadGROMData(void)
 {
-    AddCycleCount(GROM_READ_CYCLES);
     u8 ret=MemGROM[tms9900.gromAddress];
     // Auto-increment - be careful not to bump the high bits as that's our GROM select
     tms9900.gromAddress = (tms9900.gromAddress & 0xE000) | ((tms9900.gromAddress+1) & 0x1FFF);
     return ret;
+}
 
+static inline __attribute__((always_inline)) u8 ReadGROM(void)
+{
+    AddCycleCount(GROM_READ_CYCLES);
+    return ReadGROMData();
 }
 
 // ---------------------------------------------------------------------------------
@@ -690,6 +856,21 @@ void WriteGROM(u8 data)
     // Does nothing... should we chew up cycles?
 }
 
+// ----------------------------------------------------------------------------------------------
+// The cart pages at >6000-7FFF that read straight from the banked cart ROM - one bit per page.
+// A bank switch just points these pages at the new bank (the pages are biased by >6000).
+// ----------------------------------------------------------------------------------------------
+MACHINE_LOCAL u32 cartPageBits = 0;
+
+inline __attribute__((always_inline)) void MapCartBank(void)
+{
+    u8 *ptr = tms9900.cartBankPtr - 0x6000;
+    for (u32 bits = cartPageBits; bits; bits &= (bits-1))
+    {
+        PageRead[0x60 + __builtin_ctz(bits)] = ptr;
+    }
+}
+
 // -------------------------------------------------------------------------------------------------------------------------------------------
 // TI carts bank with writes to the ROM area at >6000 and up (e.g. write to >6000 is bank 0, write to >6002 is bank 1, write to >6004 is
 // bank 3,etc). At one time I was using memcpy() to put the bank into the right spot into the MemCPU[] which is GREAT when you want to read
@@ -710,6 +891,8 @@ inline __attribute__((always_inline)) void WriteBank(u16 address)
         bank &= tms9900.bankMask;                               // Support up to the maximum bank size using mask (based on file size as read in)
         tms9900.bankOffset = (0x2000 * bank);                   // Memory Reads will now use this offset into the Cart space...
         tms9900.cartBankPtr = MemCART+tms9900.bankOffset;       // And point to the right place in memory for cart fetches
+        MapCartBank();                                          // And the cart pages now read from the new bank
+        blockExit = 1;                                          // The next instruction must come from the new bank
     }
 }
 
@@ -722,6 +905,8 @@ inline __attribute__((always_inline)) void WriteBankMBX(u8 bank)
     bank &= 0x3;                                            // There are up to 4 cart banks
     tms9900.bankOffset = (bank*0x1000) - 0x1000;            // The -0x1000 offsets by 4K so that the memory fetch works correctly at >7000
     tms9900.cartBankPtr = MemCART+tms9900.bankOffset;       // And point to the right place in memory for cart fetches
+    MapCartBank();                                          // And the cart pages now read from the new bank
+    blockExit = 1;                                          // The next instruction must come from the new bank
 }
 
 // ------------------------------------------------------------------------------
@@ -750,6 +935,8 @@ void cart_cru_write(u16 cruAddress, u8 dataBit)
             bank &= tms9900.bankMask;                           // Mask the 8K bank within the size of the ROM
             tms9900.bankOffset = (bank*0x2000);                 // Keep this up to date for SAVE/LOAD state
             tms9900.cartBankPtr = MemCART+tms9900.bankOffset;   // And point to the right place in memory for cart fetches
+            MapCartBank();                                      // And the cart pages now read from the new bank
+            blockExit = 1;                                      // The next instruction must come from the new bank
         }
         cart_cru_shadow[cruAddress] = dataBit;
     }
@@ -763,6 +950,7 @@ void cart_cru_write(u16 cruAddress, u8 dataBit)
             memcpy(MemCART+(MAX_CART_SIZE-(super_bank*0x2000)), MemCPU+0x6000, 0x2000); // Copy out the working 8K of RAM into our Super Cart Space
             memcpy(MemCPU+0x6000, MemCART+(MAX_CART_SIZE-(bank*0x2000)), 0x2000);       // Copy in the new bank of 8K RAM into our working space at >6000
             super_bank = bank;
+            TMS9900_FlushBlockCache();                                                  // The RAM at >6000 just changed underneath us
         }
         cart_cru_shadow[cruAddress] = dataBit;
     }
@@ -773,439 +961,635 @@ u8 cart_cru_read(u16 cruAddress)
     return cart_cru_shadow[cruAddress & 0xF];   // Return shadow value of CRU bit
 }
 
-// ------------------------------------------------------------------------------------------------------------------------
-// When we know we're reading RAM from the use of the Workspace Pointer (WP) and register access, we can just do this
-// quickly. In theory the WP can point to 8-bit expanded RAM with a penalty but it's uncommon enough that we will not
-// incur the pentaly. This means the emulation will not be cycle accurate but it's good enough to play classic TI games...
-// ------------------------------------------------------------------------------------------------------------------------
-inline __attribute__((always_inline)) u16 ReadWP_RAM16(u16 address)
+// ---------------------------------------------------------------------------------------------
+// Our 16-bit bus memory is held in native word order (see BYTE_LANE() in tms9900.h) while ROM
+// files and save states are in the TI's big-endian byte order. These convert between the two -
+// swapping is its own inverse so the same routine works in both directions. Only used at load
+// or save time (and when a DSR is paged in) so there is no need to be terribly clever here.
+// ---------------------------------------------------------------------------------------------
+void TMS9900_SwapWords(u8 *buf, u32 len)
 {
-    return __builtin_bswap16(*(u16*) (&MemCPU[address])); // Don't need the 0xFFFE mask here as this is always WP aligned 16-bit access
+    u16 *ptr = (u16*)buf;
+    for (u32 i=0; i<len/2; i++)
+    {
+        ptr[i] = __builtin_bswap16(ptr[i]);
+    }
 }
 
-// --------------------------------------------------------------------------------------------------------------------
-// This is the accurate version of the above which handles SAMS banking - this chews up more emulation CPU time.
-// Since this is going to be slower anyway, we take the time to add in the proper cycle penalty for non-16-bit access.
-// --------------------------------------------------------------------------------------------------------------------
-inline __attribute__((always_inline)) u16 ReadWP_RAM16a(u16 address)
+// The source here is usually one of the ROM caches in VRAM so we stick to 16-bit accesses
+void TMS9900_CopyWords(void *dest, const void *src, u32 len)
 {
-    if (MemType[address>>4])
+    u16 *dst16 = (u16*)dest;
+    const u16 *src16 = (const u16*)src;
+    for (u32 i=0; i<len/2; i++)
     {
-        AddCycleCount(4);
-        if (MemType[address>>4] == MF_SAMS8)
-        {
-            return __builtin_bswap16(*((u16*)(theSAMS.memoryPtr[address>>12] + (address&0x0FFE))));
-        }
+        dst16[i] = __builtin_bswap16(src16[i]);
     }
-    return __builtin_bswap16(*(u16*) (&MemCPU[address])); // Don't need the 0xFFFE mask here as this is always WP aligned 16-bit access
 }
 
-// ----------------------------------------------------------------------------------------
-// See comment above for ReadWP_RAM16() - not cycle accurate but good enough for WP use...
-// ----------------------------------------------------------------------------------------
-ITCM_CODE void WriteWP_RAM16(u16 address, u16 data)
+// ------------------------------------------------------------------------------------------------
+// The device handlers for the page table. By the time we get here the caller has already added
+// the wait state penalty for the page. Each 1K device area (sound, VDP, speech and GROM) is made
+// up of whole pages so those get handlers of their own... anything that shares a page with some
+// other type of memory (the DSR space at >4000 with the Disk/SAMS/p-code registers, the MBX bank
+// register, etc.) goes through the 'Mixed' handlers which look at MemType[] just as the memory
+// handlers always did before there was a page table.
+// ------------------------------------------------------------------------------------------------
+ITCM_CODE u16 ReadVDP16(u16 address)
 {
-    if (!MemType[address>>4] && myConfig.RAMMirrors) // If RAM mirrors enabled, handle them by writing to all 4 locations - makes the readback faster
-    {
-        address &= 0x00FE;
-        *((u16*)(MemCPU+(0x8000 | address))) = (data << 8) | (data >> 8);
-        *((u16*)(MemCPU+(0x8100 | address))) = (data << 8) | (data >> 8);
-        *((u16*)(MemCPU+(0x8200 | address))) = (data << 8) | (data >> 8);
-        *((u16*)(MemCPU+(0x8300 | address))) = (data << 8) | (data >> 8);
-    }
-    else
-    {
-        *((u16*)(MemCPU+address)) = (data << 8) | (data >> 8);  // Don't need the 0xFFFE mask here as this is always WP aligned 16-bit access
-    }
+    if (address & 2) return (u16)RdCtrl9918()<<8; else return (u16)RdData9918()<<8;
+}
+
+ITCM_CODE u8 ReadVDP8(u16 address)
+{
+    if (address & 2) return (u8)RdCtrl9918(); else return (u8)RdData9918();
+}
+
+ITCM_CODE u16 ReadGROM16(u16 address)
+{
+    u16 retVal;
+    if (address & 2) { retVal = ReadGROMAddress(); retVal |= (u16)ReadGROMAddress() << 8; }
+    else { retVal = ReadGROM(); retVal |= (u16)ReadGROM() << 8; }
+    return retVal;
 }
 
-// --------------------------------------------------------------------------------------------------------------------
-// This is the accurate version of the above which handles SAMS banking - this chews up more emulation CPU time.
-// Since this is going to be slower anyway, we take the time to add in the proper cycle penalty for non-16-bit access.
-// --------------------------------------------------------------------------------------------------------------------
-ITCM_CODE void WriteWP_RAM16a(u16 address, u16 data)
+ITCM_CODE u8 ReadGROM8(u16 address)
 {
-    u8 memType = MemType[address>>4];
+    if (address & 2) return ReadGROMAddress(); else return ReadGROM();
+}
+
+u16 ReadSpeech16(u16 address)
+{
+    u16 retVal = SpeechDataRead();
+    return (retVal << 8) | retVal;
+}
 
-    if (memType) AddCycleCount(4);  // Anything not intrinsic 16-bit memory incurs the penalty
+u8 ReadSpeech8(u16 address)
+{
+    return SpeechDataRead();
+}
+
+u16 ReadMixed16(u16 address)
+{
+    u16 retVal;
 
-    if (memType == MF_SAMS8)
+    switch (MemType[address>>4])
     {
-        *((u16*)(theSAMS.memoryPtr[address>>12] + (address&0xFFE))) = (data << 8) | (data >> 8);
+        case MF_CART:
+            return *(u16*) (&tms9900.cartBankPtr[address&0x1fff]);
+        case MF_SAMS8:
+            return *((u16*)(theSAMS.memoryPtr[address>>12] + (address&0x0FFF)));
+        case MF_VDP_R:
+            return ReadVDP16(address);
+        case MF_GROMR:
+            return ReadGROM16(address);
+        case MF_SPEECH:
+            return ReadSpeech16(address);
+        case MF_DISK:
+            retVal = ReadTICCRegister(address); // Disk controller registers are mapped into this region...
+            return (retVal << 8) | retVal;
+        case MF_SAMS:
+            retVal = SAMS_ReadBank(address);
+            return (retVal << 8) | retVal;      // A 16-bit read of the SAMS register will return the bank number in both the high and low byte (AMSTEST4 requires this)
     }
-    else
+    return *(u16*) (&MemCPU[address]);
+}
+
+u8 ReadMixed8(u16 address)
+{
+    switch (MemType[address>>4])
     {
-        if (!memType && myConfig.RAMMirrors) // If RAM mirrors enabled, handle them by writing to all 4 locations - makes the readback faster
-        {
-            address &= 0x00FE;
-            *((u16*)(MemCPU+(0x8000 | address))) = (data << 8) | (data >> 8);
-            *((u16*)(MemCPU+(0x8100 | address))) = (data << 8) | (data >> 8);
-            *((u16*)(MemCPU+(0x8200 | address))) = (data << 8) | (data >> 8);
-            *((u16*)(MemCPU+(0x8300 | address))) = (data << 8) | (data >> 8);
-        }
-        else
-        {
-            *((u16*)(MemCPU+address)) = (data << 8) | (data >> 8);  // Don't need the 0xFFFE mask here as this is always WP aligned 16-bit access
-        }
+        case MF_SAMS8:
+            return *((u8*)(theSAMS.memoryPtr[address>>12] + BYTE_LANE(address&0x0FFF)));
+        case MF_VDP_R:
+            return ReadVDP8(address);
+        case MF_GROMR:
+            return ReadGROM8(address);
+        case MF_CART:
+            return tms9900.cartBankPtr[BYTE_LANE(address&0x1FFF)];
+        case MF_SPEECH:
+            return SpeechDataRead();
+        case MF_DISK:
+            return ReadTICCRegister(address); // Disk controller registers are mapped into this region...
+        case MF_SAMS:
+            return SAMS_ReadBank(address);
+        case MF_PCODE:
+            return pcode_dsr_read(address);
     }
+    return MemCPU[BYTE_LANE(address)];
 }
 
-// -----------------------------------------------------------------------------------------------
-// A PC fetch is always from main memory and won't trigger anything like VDP or GROM access...
-// so we can be a little smarter/faster in getting the memory here. This routine does not handle
-// the SAMS memory map for a big speed boost for games that don't use the expanded memory.
-// -----------------------------------------------------------------------------------------------
-inline __attribute__((always_inline)) u16 ReadPC16(void)
+// -------------------------------------------------------------------------------------------------------------------------
+// For the peripherals that are 8-bits but written using a 16-bit operation, the odd byte is always written first followed
+// by the even byte (in the TI9900 case - the high byte). That's why you will see below many of the 8-bit peripherals just
+// writing the high byte shifted down 8 bits which is the end-result of a 16-bit write to an 8-bit periphal. We could
+// actually write twice (odd byte then even byte) to more closely mimic real hardware but it's not useful and chews up
+// valuable emulation time for the peripherals that don't do anything special on the odd-byte writes.
+// -------------------------------------------------------------------------------------------------------------------------
+void WriteIgnore16(u16 address, u16 data)
 {
-    u16 address = tms9900.PC; tms9900.PC+=2;
+    // ROM or a read-only device... nothing to write
+}
+
+void WriteIgnore8(u16 address, u8 data)
+{
+    // ROM or a read-only device... nothing to write
+}
+
+ITCM_CODE void WriteSound16(u16 address, u16 data)
+{
+    sn76496W(data>>8, &snti99);
+}
+
+ITCM_CODE void WriteSound8(u16 address, u8 data)
+{
+    sn76496W(data, &snti99);
+}
+
+ITCM_CODE void WriteVDP16(u16 address, u16 data)
+{
+    if (address & 2) WrCtrl9918(data>>8); else WrData9918(data>>8);
+}
+
+ITCM_CODE void WriteVDP8(u16 address, u8 data)
+{
+    if (address & 2) WrCtrl9918(data); else WrData9918(data);
+}
+
+ITCM_CODE void WriteGROM16(u16 address, u16 data)
+{
+    if (address & 2) { WriteGROMAddress(data&0xff); WriteGROMAddress(data>>8); }
+    else { WriteGROM(data&0xff); WriteGROM(data>>8); }
+}
+
+ITCM_CODE void WriteGROM8(u16 address, u8 data)
+{
+    if (address & 2) WriteGROMAddress(data); else WriteGROM(data);
+}
+
+ITCM_CODE void WriteCart16(u16 address, u16 data)
+{
+    WriteBank(address);
+}
 
-    // This will trap out anything that isn't below 0x2000 which is console ROM and heavily utilized...
-    if (address & 0xE000)
+ITCM_CODE void WriteCart8(u16 address, u8 data)
+{
+    WriteBank(address);
+}
+
+void WriteSpeech16(u16 address, u16 data)
+{
+    SpeechDataWrite(data>>8);
+}
+
+void WriteSpeech8(u16 address, u8 data)
+{
+    SpeechDataWrite(data);
+}
+
+void WriteMixed16(u16 address, u16 data)
+{
+    switch (MemType[address>>4])
     {
-        u8 memType = MemType[address>>4];
-        if (memType)
-        {
-            AddCycleCount(4); // Penalty for anything not internal ROM or Workspace RAM
-            if (memType == MF_CART)
+        case MF_SOUND:
+            WriteSound16(address, data);
+            break;
+        case MF_VDP_W:
+            WriteVDP16(address, data);
+            break;
+        case MF_GROMW:
+            WriteGROM16(address, data);
+            break;
+        case MF_CART:
+            WriteBank(address);
+            break;
+        case MF_SPEECH:
+            SpeechDataWrite(data>>8);
+            break;
+        case MF_SAMS:
+            SAMS_WriteBank(address, data>>8);
+            break;
+        case MF_MBX:
+            if (address >= 0x6ffe) WriteBankMBX(data>>8);
+            // We purposely don't use an 'else' here as the banking 'register' at >6ffe is also in the RAM area if this cart is mapped as MBX with RAM
+            if (myConfig.cartType == CART_TYPE_MBX_WITH_RAM) // If it's got RAM mapped here... we treat it like RAM8
             {
-                return __builtin_bswap16(*(u16*) (&tms9900.cartBankPtr[address&0x1ffe]));
+                if (BlockCodeMark[address>>4]) TMS9900_BlockCodeWrite(address);
+                *((u16*)(MemCPU+address)) = data;
             }
-        }
+            break;
+        case MF_SAMS8:
+            *((u16*)(theSAMS.memoryPtr[address>>12] + (address & 0xFFF))) = data;
+            break;
+        case MF_RAM8:
+            if (BlockCodeMark[address>>4]) TMS9900_BlockCodeWrite(address);   // Writing over code we have cached?
+            *((u16*)(MemCPU+address)) = data;
+            break;
+        default:    // Nothing to write... ignore
+            break;
     }
-    return __builtin_bswap16(*((u16*)(&MemCPU[address&0xFFFE])));
 }
 
-// -------------------------------------------------------------------------------------------------------------------------------------
-// This is the accurate version of the above which handles SAMS (yes, code can run from SAMS!) - this chews up more emulation CPU time.
-// -------------------------------------------------------------------------------------------------------------------------------------
-ITCM_CODE u16 ReadPC16a(void)
+void WriteMixed8(u16 address, u8 data)
 {
-    u16 address = tms9900.PC; tms9900.PC+=2;
-
-    // This will trap out anything that isn't below 0x2000 which is console ROM and heavily utilized...
-    if (address & 0xE000)
+    switch (MemType[address>>4])
     {
-        u8 memType = MemType[address>>4];
-        if (memType)
-        {
-            AddCycleCount(4); // Penalty for anything not internal ROM or Workspace RAM
-            if (memType == MF_CART)
-            {
-                return __builtin_bswap16(*(u16*) (&tms9900.cartBankPtr[address&0x1ffe]));
-            }
-            else if (memType == MF_SAMS8)
+        case MF_SOUND:
+            WriteSound8(address, data);
+            break;
+        case MF_VDP_W:
+            WriteVDP8(address, data);
+            break;
+        case MF_GROMW:
+            WriteGROM8(address, data);
+            break;
+        case MF_CART:
+            WriteBank(address);
+            break;
+        case MF_SPEECH:
+            SpeechDataWrite(data);
+            break;
+        case MF_SAMS:
+            SAMS_WriteBank(address, data);
+            break;
+        case MF_PCODE:
+            pcode_dsr_write(address, data);
+            break;
+        case MF_MBX:
+            if (address >= 0x6ffe) WriteBankMBX(data);
+            if (myConfig.cartType == CART_TYPE_MBX_WITH_RAM)
             {
-                return __builtin_bswap16(*((u16*)(theSAMS.memoryPtr[address>>12] + (address&0x0ffe))));
+                if (BlockCodeMark[address>>4]) TMS9900_BlockCodeWrite(address);
+                MemCPU[BYTE_LANE(address)] = data;
             }
-        }
+            break;
+        case MF_DISK:
+            WriteTICCRegister(address, data);  // Disk Controller
+            break;
+        case MF_SAMS8:
+            *(theSAMS.memoryPtr[address>>12] + BYTE_LANE(address & 0xFFF)) = data;
+            break;
+        case MF_RAM8:
+            if (BlockCodeMark[address>>4]) TMS9900_BlockCodeWrite(address);   // Writing over code we have cached?
+            MemCPU[BYTE_LANE(address)] = data;    // Expanded 32K RAM
+            break;
+        default:    // Nothing to write... ignore
+            break;
     }
-    return __builtin_bswap16(*((u16*)(&MemCPU[address&0xFFFE])));
 }
 
-
-
-// ------------------------------------------------------------------------------------
-// For some instructions (mov, movb mainly), there is a sort of intermediate read that
-// places data on the bus while we wait for the write instruction to finish. We don't
-// perform the actual read - nothing  in the TI world should trigger or count on this
-// phantom read... we only take into account any possible cycle penalty.
-// ------------------------------------------------------------------------------------
-inline __attribute__((always_inline)) void PhantomMemoryRead(u16 address)
+// ------------------------------------------------------------------------------------------------------
+// Work out one page of the page table from MemType[] (and the current cart and SAMS banks). The page
+// pointers are biased by the page's TI address so the handlers never have to mask the address. With
+// the RAM mirrors enabled, all four scratchpad pages point at the one 256 bytes of RAM at >8300 so a
+// write through any mirror is seen through all of them without us having to write four times.
+// ------------------------------------------------------------------------------------------------------
+static void MapPage(u8 page)
 {
-    if (MemType[address>>4]) AddCycleCount(4); // Any bit set is a penalty... this means it's not console ROM or the scratchpad RAM
-}
+    u16 chunk   = (u16)page << 4;
+    u8  memType = MemType[chunk];
+    u8 *ptr     = MemCPU;   // Biased by the page address... which for MemCPU[] works out to just MemCPU
+    u8  device  = 0;
+    u8  write   = 0;
+
+    // A page holding more than one type of memory is left to the Mixed handlers
+    for (u8 i=1; i<16; i++)
+    {
+        if (MemType[chunk+i] != memType) device = 1;
+    }
 
-// --------------------------------------------------------------------------------------------
-// Technically everything in the system other than console ROM or scratchpad RAM is a 16-bit
-// read with an 8-bit multiplexer... but we can be a little smarter and not waste the same
-// time that an actual TI-99/4a does. The routines below are general purpose and work for
-// both the accurate and fast versions of our CPU driver. We try to call into one of the above
-// memory handlers whenever possible as these are a bit complex and can slow down emulation.
-//
-// It's important to remember that a 16-bit word in the TMS9900 architecture is split into
-// the even byte (high byte) and odd byte (low byte). This is opposite of conventional
-// ARM architecture so you see us swapping these bytes fairly often by left/right shifts by 8
-// or by using the ARM-specific __builtin_bswap16() to accomplish this faster.
-//
-// So a 16-bit Memory Word on an Even Address boundary looks like this:
-//
-// MSB ---------------- LSB  |  MSB ---------------------- LSB
-//  0  1  2  3  4  5  6  7   |   8  9  10  11  12  13  14  15
-//      == EVEN BYTE ==      |          == ODD BYTE ==
-//
-// Further, for anything on the 8-bit bus (on the other side of the multiplexer), the system
-// will always write the odd byte first, followed by the even byte. Most times this doesn't
-// really matter and we'll do it however it's fastest for the emulation.
-// --------------------------------------------------------------------------------------------
-ITCM_CODE u16 MemoryRead16(u16 address)
-{
-    u16 retVal;
-    address &= 0xFFFE;
-    u8 memType = MemType[address>>4];
+    PageFlags[page]   = (memType == MF_MEM16) ? 0 : PAGE_WAIT;
+    PageRead16[page]  = ReadMixed16;
+    PageRead8[page]   = ReadMixed8;
+    PageWrite16[page] = WriteMixed16;
+    PageWrite8[page]  = WriteMixed8;
+    if ((page >= 0x60) && (page < 0x80)) cartPageBits &= ~(1 << (page - 0x60));
 
-    if (memType)
+    if (!device)
     {
-        AddCycleCount(4); // Penalty for anything not internal ROM or Workspace RAM
-
         switch (memType)
         {
-            case MF_CART:
-                return __builtin_bswap16(*(u16*) (&tms9900.cartBankPtr[address&0x1fff]));
+            case MF_MEM16:      // Console ROM or the scratchpad RAM
+                if (page & 0x80)
+                {
+                    if (myConfig.RAMMirrors) ptr = MemCPU + 0x8300 - ((u32)page << 8);
+                    write = 1;
+                }
+                else
+                {
+                    PageWrite16[page] = WriteIgnore16;
+                    PageWrite8[page]  = WriteIgnore8;
+                }
+                break;
+            case MF_RAM8:       // 32K expansion RAM (or cart RAM like the Mini Memory or Super Cart)
+                write = 1;
                 break;
-            case MF_SAMS8:
-                return __builtin_bswap16(*((u16*)(theSAMS.memoryPtr[address>>12] + (address&0x0FFF))));
+            case MF_SAMS8:      // 32K expansion RAM banked in from the larger SAMS memory
+                ptr = theSAMS.memoryPtr[page>>4] + ((page & 0x0F) << 8) - ((u32)page << 8);
+                write = 1;
+                break;
+            case MF_CART:       // Banked cart ROM - writes switch the bank
+                ptr = tms9900.cartBankPtr - 0x6000;
+                PageWrite16[page] = WriteCart16;
+                PageWrite8[page]  = WriteCart8;
+                cartPageBits |= (1 << (page - 0x60));
+                break;
+            case MF_CART_NB:    // Non-banked cart ROM, peripheral ROM and unused space just ignore writes
+            case MF_PERIF:
+            case MF_UNUSED:
+                PageWrite16[page] = WriteIgnore16;
+                PageWrite8[page]  = WriteIgnore8;
+                break;
+            case MF_SOUND:
+                PageWrite16[page] = WriteSound16;
+                PageWrite8[page]  = WriteSound8;
                 break;
             case MF_VDP_R:
-                if (address & 2) retVal = (u16)RdCtrl9918()<<8; else retVal = (u16)RdData9918()<<8;
-                return retVal;
+                device = 1;
+                PageRead16[page]  = ReadVDP16;
+                PageRead8[page]   = ReadVDP8;
+                PageWrite16[page] = WriteIgnore16;
+                PageWrite8[page]  = WriteIgnore8;
                 break;
-            case MF_GROMR:
-                if (address & 2) { retVal = ReadGROMAddress(); retVal |= (u16)ReadGROMAddress() << 8; }
-                else { retVal = ReadGROM(); retVal |= (u16)ReadGROM() << 8; }
-                return retVal;
+            case MF_VDP_W:
+                PageWrite16[page] = WriteVDP16;
+                PageWrite8[page]  = WriteVDP8;
                 break;
             case MF_SPEECH:
-                retVal = SpeechDataRead();
-                return (retVal << 8) | retVal;
+                device = 1;
+                PageRead16[page]  = ReadSpeech16;
+                PageRead8[page]   = ReadSpeech8;
+                PageWrite16[page] = WriteSpeech16;
+                PageWrite8[page]  = WriteSpeech8;
                 break;
-            case MF_DISK:
-                retVal = ReadTICCRegister(address); // Disk controller registers are mapped into this region...
-                return (retVal << 8) | retVal;
+            case MF_GROMR:
+                device = 1;
+                PageRead16[page]  = ReadGROM16;
+                PageRead8[page]   = ReadGROM8;
+                PageWrite16[page] = WriteIgnore16;
+                PageWrite8[page]  = WriteIgnore8;
                 break;
-            case MF_SAMS:
-                retVal = SAMS_ReadBank(address);
-                return (retVal << 8) | retVal;      // A 16-bit read of the SAMS register will return the bank number in both the high and low byte (AMSTEST4 requires this)
+            case MF_GROMW:
+                PageWrite16[page] = WriteGROM16;
+                PageWrite8[page]  = WriteGROM8;
                 break;
-            default:
-                return __builtin_bswap16(*(u16*) (&MemCPU[address]));
+            default:            // MBX, Disk, SAMS and p-code registers - let the Mixed handlers sort it out
+                device = 1;
                 break;
         }
     }
 
-    // This is either console ROM or workspace RAM
-    return __builtin_bswap16(*(u16*) (&MemCPU[address]));
+    if (device) PageFlags[page] |= PAGE_DEVICE;
+    PageRead[page]  = ptr;
+    PageWrite[page] = write ? ptr : NULL;
 }
 
-// --------------------------------------------------------------------------------------------------
-// The TI is a 16-bit system crammed into an 8-bit artchitecture (or, perhaps more acccurately, lots
-// of 8-bit peripherals were jammed into a 16-bit architecture). But there are byte commands that
-// will result in an 8-bit read of memory. We handle that here.
-// --------------------------------------------------------------------------------------------------
-ITCM_CODE u8 MemoryRead8(u16 address)
+// ------------------------------------------------------------------------------------------
+// Install a PC trap - the handler is called just before the CPU runs the instruction at the
+// given address (the handler is free to move the PC). Installing the same address again just
+// swaps the handler. Blocks end just before a trap address so it's always the start of one.
+// ------------------------------------------------------------------------------------------
+void TMS9900_AddTrap(u16 address, void (*handler)(void))
 {
-    u8 memType = MemType[address>>4];
+    u8 i;
+    for (i=0; i<numPCTraps; i++)
+    {
+        if (pcTraps[i].address == address) break;
+    }
+    if (i == MAX_PC_TRAPS) return;     // Full up - make MAX_PC_TRAPS bigger
+    if (i == numPCTraps) numPCTraps++;
+
+    pcTraps[i].address = address;
+    pcTraps[i].handler = handler;
+    PageTrap[address >> PAGE_SHIFT] = 1;
+    TMS9900_FlushBlockCache();          // Any block running through the trap address has to be rebuilt
+}
 
-    if (memType)
+u8 TMS9900_IsTrap(u16 address)
+{
+    if (!PageTrap[address >> PAGE_SHIFT]) return 0;
+    for (u8 i=0; i<numPCTraps; i++)
     {
-        AddCycleCount(4); // Penalty for anything not internal ROM or Workspace RAM
+        if (pcTraps[i].address == address) return 1;
+    }
+    return 0;
+}
 
-        switch (memType)
-        {
-            case MF_SAMS8:
-                return *((u8*)(theSAMS.memoryPtr[address>>12] + (address&0x0FFF)));
-                break;
-            case MF_VDP_R:
-                if (address & 2) return (u8)RdCtrl9918(); else return (u8)RdData9918();
-                break;
-            case MF_GROMR:
-                if (address & 2) return ReadGROMAddress(); else return ReadGROM();
-                break;
-            case MF_CART:
-                return tms9900.cartBankPtr[(address&0x1FFF)];
-                break;
-            case MF_SPEECH:
-                return SpeechDataRead();
-                break;
-            case MF_DISK:
-                return ReadTICCRegister(address); // Disk controller registers are mapped into this region...
-                break;
-            case MF_SAMS:
-                return SAMS_ReadBank(address);
-                break;
-            case MF_PCODE:
-                return pcode_dsr_read(address);
-                break;
-            default:
-                return MemCPU[address];
-                break;
-        }
+// The PC is in a page with a trap - run the handler if we're right on the trap
+void TMS9900_RunTraps(void)
+{
+    for (u8 i=0; i<numPCTraps; i++)
+    {
+        if (pcTraps[i].address == tms9900.PC) {pcTraps[i].handler(); return;}
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+// Rebuild the page table for a range of addresses. Anything that changes MemType[] or moves
+// the SAMS banks around must call this for the addresses it touched (cart banks are handled
+// by MapCartBank() as those change far too often to rebuild the pages each time).
+// ------------------------------------------------------------------------------------------
+void TMS9900_MapMemory(u16 start, u16 end)
+{
+    for (u32 page = (start >> PAGE_SHIFT); page <= (u32)(end >> PAGE_SHIFT); page++)
+    {
+        MapPage((u8)page);
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+// With the RAM mirrors aliased, only MemCPU[>8300] is kept up to date. Anything that wants
+// to look at the whole of MemCPU[>8000-83FF] directly (save states) calls this first.
+// ------------------------------------------------------------------------------------------
+void TMS9900_SyncScratchpad(void)
+{
+    for (u32 page = 0x80; page < 0x83; page++)
+    {
+        if (PageRead[page] != MemCPU) memcpy(&MemCPU[page << 8], PageRead[page] + (page << 8), 0x100);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+// When we know we're reading RAM from the use of the Workspace Pointer (WP) and register access, we can just do this
+// quickly. In theory the WP can point to 8-bit expanded RAM with a penalty but it's uncommon enough that we will not
+// incur the pentaly. This means the emulation will not be cycle accurate but it's good enough to play classic TI games...
+// ------------------------------------------------------------------------------------------------------------------------
+inline __attribute__((always_inline)) u16 ReadWP_RAM16(u16 address)
+{
+    return *(u16*) (PageRead[address>>8] + address); // Don't need the 0xFFFE mask here as this is always WP aligned 16-bit access
+}
+
+// ----------------------------------------------------------------------------------------
+// See comment above for ReadWP_RAM16() - not cycle accurate but good enough for WP use...
+// ----------------------------------------------------------------------------------------
+ITCM_CODE void WriteWP_RAM16(u16 address, u16 data)
+{
+    u8 page = address >> 8;
+
+    if (PageWrite[page])
+    {
+        if (BlockCodeMark[address>>4]) TMS9900_BlockCodeWrite(address);  // Registers overlapping cached code? Rare but possible...
+        *((u16*)(PageWrite[page] + address)) = data;  // Don't need the 0xFFFE mask here as this is always WP aligned 16-bit access
+    }
+    else
+    {
+        PageWrite16[page](address, data);   // Workspace over ROM or a device? Very odd... but let the handler deal with it
+    }
+}
+
+// -----------------------------------------------------------------------------------------------
+// A PC fetch is always from memory and won't trigger anything like VDP or GROM access... so all
+// we need is the page pointer and the wait state penalty. This handles cart banks and SAMS banks
+// the same as anything else now that they are all in the page table.
+// -----------------------------------------------------------------------------------------------
+inline __attribute__((always_inline)) u16 ReadPC16(void)
+{
+    u16 address = tms9900.PC; tms9900.PC+=2;
+
+    if (PageFlags[address>>8] & PAGE_WAIT) AddCycleCount(PAGE_WAIT); // Penalty for anything not internal ROM or Workspace RAM
+    return *(u16*) (PageRead[address>>8] + (address&0xFFFE));
+}
+
+// ------------------------------------------------------------------------------------
+// For some instructions (mov, movb mainly), there is a sort of intermediate read that
+// places data on the bus while we wait for the write instruction to finish. We don't
+// perform the actual read - nothing  in the TI world should trigger or count on this
+// phantom read... we only take into account any possible cycle penalty.
+// ------------------------------------------------------------------------------------
+inline __attribute__((always_inline)) void PhantomMemoryRead(u16 address)
+{
+    if (PageFlags[address>>8] & PAGE_WAIT) AddCycleCount(PAGE_WAIT); // This means it's not console ROM or the scratchpad RAM
+}
+
+// --------------------------------------------------------------------------------------------
+// Technically everything in the system other than console ROM or scratchpad RAM is a 16-bit
+// read with an 8-bit multiplexer... but we can be a little smarter and not waste the same
+// time that an actual TI-99/4a does. The routines below are general purpose and work for
+// both the accurate and fast versions of our CPU driver. We try to call into one of the above
+// memory handlers whenever possible as these are a bit complex and can slow down emulation.
+//
+// It's important to remember that a 16-bit word in the TMS9900 architecture is split into
+// the even byte (high byte) and odd byte (low byte). This is opposite of conventional
+// ARM architecture so we store all 16-bit bus memory in the native (little-endian) word order
+// which lets the far more common word accesses be plain loads/stores. The price is that the
+// byte accesses must use BYTE_LANE() to flip the low address bit and find the right byte.
+//
+// So a 16-bit Memory Word on an Even Address boundary looks like this:
+//
+// MSB ---------------- LSB  |  MSB ---------------------- LSB
+//  0  1  2  3  4  5  6  7   |   8  9  10  11  12  13  14  15
+//      == EVEN BYTE ==      |          == ODD BYTE ==
+//
+// Further, for anything on the 8-bit bus (on the other side of the multiplexer), the system
+// will always write the odd byte first, followed by the even byte. Most times this doesn't
+// really matter and we'll do it however it's fastest for the emulation.
+// --------------------------------------------------------------------------------------------
+ITCM_CODE u16 MemoryRead16(u16 address)
+{
+    address &= 0xFFFE;
+    u8 page = address >> 8;
+    u8 flags = PageFlags[page];
+
+    if (flags)
+    {
+        AddCycleCount(flags & PAGE_WAIT);   // Penalty for anything not internal ROM or Workspace RAM
+        if (flags & PAGE_DEVICE) return PageRead16[page](address);
+    }
+
+    return *(u16*) (PageRead[page] + address);
+}
+
+// --------------------------------------------------------------------------------------------------
+// The TI is a 16-bit system crammed into an 8-bit artchitecture (or, perhaps more acccurately, lots
+// of 8-bit peripherals were jammed into a 16-bit architecture). But there are byte commands that
+// will result in an 8-bit read of memory. We handle that here.
+// --------------------------------------------------------------------------------------------------
+ITCM_CODE u8 MemoryRead8(u16 address)
+{
+    u8 page = address >> 8;
+    u8 flags = PageFlags[page];
+
+    if (flags)
+    {
+        AddCycleCount(flags & PAGE_WAIT);   // Penalty for anything not internal ROM or Workspace RAM
+        if (flags & PAGE_DEVICE) return PageRead8[page](address);
     }
 
-    return MemCPU[address]; // This is either console ROM or workspace RAM
+    return PageRead[page][BYTE_LANE(address)];
 }
 
 
 // -------------------------------------------------------------------------------------------------------------------------
 // A few games like Borzork use 16-bit writes for things like Sound or VDP so those do need to be handled here along
-// with the more typical 16-bit writes like the internal console RAM... For the peripherals that are 8-bits but written
-// using a 16-bit operation, the odd is always written first followed by the even byte (in the TI9900 case - the high byte).
-// That's why you will see below many of the 8-bit peripherals just writing the high byte shifted down 8 bits which is
-// the end-result of a 16-bit write to an 8-bit periphal. We could actually write twice (odd byte then even byte) to
-// more closely mimic real hardware but it's not useful and chews up valuable emulation time for the peripherals that
-// don't do anything special on the odd-byte writes (however, 8-bit RAM must handle this as we do want to write both bytes).
+// with the more typical 16-bit writes like the internal console RAM... Plain RAM (scratchpad, expanded RAM, SAMS and any
+// cart RAM) is written straight through the page table. Everything else is up to the write handler for the page.
 // -------------------------------------------------------------------------------------------------------------------------
 ITCM_CODE void MemoryWrite16(u16 address, u16 data)
 {
     address &= 0xFFFE;
+    u8 page = address >> 8;
 
-    u8 memType = MemType[address>>4];
+    if (PageFlags[page] & PAGE_WAIT) AddCycleCount(PAGE_WAIT); // Penalty for anything not internal ROM or Workspace RAM
 
-    if (memType)
+    if (PageWrite[page])
     {
-        AddCycleCount(4); // Penalty for anything not internal ROM or Workspace RAM
-
-        switch (memType)
-        {
-            case MF_SOUND:
-                sn76496W(data>>8, &snti99);
-                break;
-            case MF_VDP_W:
-                if (address & 2) WrCtrl9918(data>>8); else WrData9918(data>>8);
-                break;
-            case MF_GROMW:
-                if (address & 2) { WriteGROMAddress(data&0xff); WriteGROMAddress(data>>8); }
-                else { WriteGROM(data&0xff); WriteGROM(data>>8); }
-                break;
-            case MF_CART:
-                WriteBank(address);
-                break;
-            case MF_SPEECH:
-                SpeechDataWrite(data>>8);
-                break;
-            case MF_SAMS:
-                SAMS_WriteBank(address, data>>8);
-                break;
-            case MF_MBX:
-                if (address >= 0x6ffe) WriteBankMBX(data>>8);
-                // We purposely don't use an 'else' here as the banking 'register' at >6ffe is also in the RAM area if this cart is mapped as MBX with RAM
-                if (myConfig.cartType == CART_TYPE_MBX_WITH_RAM) // If it's got RAM mapped here... we treat it like RAM8
-                {
-                    *((u16*)(MemCPU+address)) = (data << 8) | (data >> 8);
-                }
-                break;
-            case MF_SAMS8:
-                *((u16*)(theSAMS.memoryPtr[address>>12] + (address & 0xFFF))) = (data << 8) | (data >> 8);
-                break;
-            case MF_RAM8:
-                *((u16*)(MemCPU+address)) = (data << 8) | (data >> 8);
-                break;
-            default:    // Nothing to write... ignore
-                break;
-        }
+        if (BlockCodeMark[address>>4]) TMS9900_BlockCodeWrite(address);   // Writing over code we have cached?
+        *((u16*)(PageWrite[page] + address)) = data;
     }
-    else    // This has to be workspace RAM which deals with mirrors...
+    else
     {
-        if (address & 0x8000)   // Make sure this is RAM and not an inadvertant write to Console ROM (also 16-bit)
-        {
-            if (myConfig.RAMMirrors)    // We write to all mirrors so that read-back is quick and easy
-            {
-                *((u16*)(MemCPU+(0x8000 | (address&0xff)))) = (data << 8) | (data >> 8);
-                *((u16*)(MemCPU+(0x8100 | (address&0xff)))) = (data << 8) | (data >> 8);
-                *((u16*)(MemCPU+(0x8200 | (address&0xff)))) = (data << 8) | (data >> 8);
-                *((u16*)(MemCPU+(0x8300 | (address&0xff)))) = (data << 8) | (data >> 8);
-            }
-            else
-            {
-                *((u16*)(MemCPU+address)) = (data << 8) | (data >> 8);
-            }
-        }
+        PageWrite16[page](address, data);
     }
 }
 
 ITCM_CODE void MemoryWrite8(u16 address, u8 data)
 {
-    u8 memType = MemType[address>>4];
+    u8 page = address >> 8;
 
-    if (memType)
-    {
-        AddCycleCount(4); // Penalty for anything not internal ROM or Workspace RAM
+    if (PageFlags[page] & PAGE_WAIT) AddCycleCount(PAGE_WAIT); // Penalty for anything not internal ROM or Workspace RAM
 
-        switch (memType)
-        {
-            case MF_SOUND:
-                 sn76496W(data, &snti99);
-                break;
-            case MF_VDP_W:
-                if (address & 2) WrCtrl9918(data); else WrData9918(data);
-                break;
-            case MF_GROMW:
-                if (address & 2) WriteGROMAddress(data); else WriteGROM(data);
-                break;
-            case MF_CART:
-                WriteBank(address);
-                break;
-            case MF_SPEECH:
-                SpeechDataWrite(data);
-                break;
-            case MF_SAMS:
-                SAMS_WriteBank(address, data);
-                break;
-            case MF_PCODE:
-                pcode_dsr_write(address, data);
-                break;            
-            case MF_MBX:
-                if (address >= 0x6ffe) WriteBankMBX(data);
-                if (myConfig.cartType == CART_TYPE_MBX_WITH_RAM) MemCPU[address] = data;
-                break;
-            case MF_DISK:
-                WriteTICCRegister(address, data);  // Disk Controller
-                break;
-            case MF_SAMS8:
-                *(theSAMS.memoryPtr[address>>12] + (address & 0xFFF)) = data;
-                break;
-            case MF_RAM8:
-                MemCPU[address] = data;    // Expanded 32K RAM
-                break;
-            default:    // Nothing to write... ignore
-                break;
-        }
+    if (PageWrite[page])
+    {
+        if (BlockCodeMark[address>>4]) TMS9900_BlockCodeWrite(address);   // Writing over code we have cached?
+        PageWrite[page][BYTE_LANE(address)] = data;
     }
-    else    // This has to be workspace RAM which deals with mirrors...
+    else
     {
-        if (address & 0x8000)   // Make sure this is RAM and not an inadvertant write to Console ROM
-        {
-            if (myConfig.RAMMirrors)    // We write to all mirrors so that read-back is quick and easy
-            {
-                MemCPU[0x8000 | (address&0xff)] = data;
-                MemCPU[0x8100 | (address&0xff)] = data;
-                MemCPU[0x8200 | (address&0xff)] = data;
-                MemCPU[0x8300 | (address&0xff)] = data;
-            }
-            else
-            {
-                MemCPU[address] = data;
-            }
-        }
+        PageWrite8[page](address, data);
     }
 }
 
-
 // ------------------------------------------------------------------------------------------------
 // Source Address extracted from the Opcode. For this addressing mode the opcode is in the format:
 // 15 14 13  12   11 10  9 8 7 6  5 4  3 2 1 0
 // [OPCODE ] [B]  [TD ]  [DEST ] [TS ] [SOURCE]
 // The [B] bit tells us if this is a byte addressing (0 implies word addressing)
 //
+// The addressing mode is handed in separately from the opcode. The Format I handlers are expanded
+// for the common register/indirect mode pairs (see tms9900_format1.inc) and pass a constant mode
+// so the compiler trims this down to straight-line code for just that one mode. Everyone else
+// goes through Ts() which pulls the mode out of the opcode at run-time.
+//
 // This is a heavily utilized function call and we force it as inline even though it really
 // balloons our use of ITCM code space in the CPU core.
 // ------------------------------------------------------------------------------------------------
-static inline __attribute__((always_inline)) void Ts(u16 bytes)
+static inline __attribute__((always_inline)) void TsMode(u16 bytes, u8 mode)
 {
     u16 rData = REG_GET_FROM_OPCODE();
 
-    switch (tms9900.currentOp & 0x0030) // We could shift this down, but we're looking for maximum optimization
+    switch (mode)
     {
-        case 0x0000: // Rx  2c
+        case MODE_REG: // Rx  2c
             tms9900.srcAddress = WP_REG(rData);
             break;
 
-        case 0x0010: // *Rx  6c
+        case MODE_IND: // *Rx  6c
             tms9900.srcAddress = ReadWP_RAM16(WP_REG(rData));
             AddCycleCount(4);
             break;
 
-        case 0x0020: // @yyyy(Rx) or @yyyy if Rx=0  10c
-            tms9900.srcAddress = ReadPC16a();   // We use the 'a' version here not so much for accuracy but to prevent the inline which blows our ITCM fast memory
+        case MODE_SYM: // @yyyy(Rx) or @yyyy if Rx=0  10c
+            tms9900.srcAddress = ReadPC16();
             if (rData) tms9900.srcAddress += ReadWP_RAM16(WP_REG(rData));
             AddCycleCount(8);
             break;
@@ -1220,39 +1604,9 @@ static inline __attribute__((always_inline)) void Ts(u16 bytes)
     if (bytes&2) tms9900.srcAddress &= 0xFFFE;   // bytes is either 1 (in which case we will utilize the LSB) or 2 (in which case we mask off to 16-bits)
 }
 
-// -----------------------------------------------------------------------------------------
-// This version makes memory calls that take into account the SAMS banking. It's going to
-// be a little slower and so we only swap in this version for the 'Accurate' CPU core.
-// -----------------------------------------------------------------------------------------
-static inline __attribute__((always_inline)) void Ts_Accurate(u16 bytes)
+static inline __attribute__((always_inline)) void Ts(u16 bytes)
 {
-    u16 rData = REG_GET_FROM_OPCODE();
-
-    switch (tms9900.currentOp & 0x0030)
-    {
-        case 0x0000: // Rx  2c
-            tms9900.srcAddress = WP_REG(rData);
-            break;
-
-        case 0x0010: // *Rx  6c
-            tms9900.srcAddress = ReadWP_RAM16a(WP_REG(rData));
-            AddCycleCount(4);
-            break;
-
-        case 0x0020: // @yyyy(Rx) or @yyyy if Rx=0  10c
-            tms9900.srcAddress = ReadPC16a();
-            if (rData) tms9900.srcAddress += ReadWP_RAM16a(WP_REG(rData));
-            AddCycleCount(8);
-            break;
-
-        default: // *Rx+   10c
-            tms9900.srcAddress = ReadWP_RAM16a(WP_REG(rData));
-            WriteWP_RAM16a(WP_REG(rData), (tms9900.srcAddress + bytes));
-            AddCycleCount(((bytes&1) ? 6:8)); // Add 6 cycles for byte address... 8 for word address
-            break;
-    }
-
-    if (bytes&2) tms9900.srcAddress &= 0xFFFE;   // bytes is either 1 (in which case we will utilize the LSB) or 2 (in which case we mask off to 16-bits)
+    TsMode(bytes, (tms9900.currentOp >> 4) & 3);
 }
 
 // ------------------------------------------------------------------------------------------------------
@@ -1261,23 +1615,23 @@ static inline __attribute__((always_inline)) void Ts_Accurate(u16 bytes)
 // [OPCODE ] [B]  [TD ]  [DEST ] [TS ] [SOURCE]
 // The [B] bit tells us if this is a byte addressing (0 implies word addressing)
 // ------------------------------------------------------------------------------------------------------
-static inline __attribute__((always_inline)) void Td(u16 bytes)
+static inline __attribute__((always_inline)) void TdMode(u16 bytes, u8 mode)
 {
     u16 rData = (tms9900.currentOp>>6) & 0x0F;
 
-    switch (tms9900.currentOp & 0x0C00) // We could shift this down, but we're looking for maximum optimization
+    switch (mode)
     {
-        case 0x0000: // Rx  2c
+        case MODE_REG: // Rx  2c
             tms9900.dstAddress = WP_REG(rData);
             break;
 
-        case 0x0400: // *Rx  6c
+        case MODE_IND: // *Rx  6c
             tms9900.dstAddress = ReadWP_RAM16(WP_REG(rData));
             AddCycleCount(4);
             break;
 
-        case 0x0800: // @yyyy(Rx) or @yyyy if Rx=0  10c
-            tms9900.dstAddress = ReadPC16a();   // We use the 'a' version here not so much for accuracy but to prevent the inline which blows our ITCM fast memory
+        case MODE_SYM: // @yyyy(Rx) or @yyyy if Rx=0  10c
+            tms9900.dstAddress = ReadPC16();
             if (rData) tms9900.dstAddress += ReadWP_RAM16(WP_REG(rData));
             AddCycleCount(8);
             break;
@@ -1292,71 +1646,112 @@ static inline __attribute__((always_inline)) void Td(u16 bytes)
     if (bytes&2) tms9900.dstAddress &= 0xFFFE;   // bytes is either 1 (in which case we will utilize the LSB) or 2 (in which case we mask off to 16-bits)
 }
 
-// -----------------------------------------------------------------------------------------
-// This version makes memory calls that take into account the SAMS banking. It's going to
-// be a little slower and so we only swap in this version for the 'Accurate' CPU core.
-// -----------------------------------------------------------------------------------------
-static inline __attribute__((always_inline)) void Td_Accurate(u16 bytes)
+static inline __attribute__((always_inline)) void Td(u16 bytes)
 {
-    u16 rData = (tms9900.currentOp>>6) & 0x0F;
+    TdMode(bytes, (tms9900.currentOp >> 10) & 3);
+}
+
+// -------------------------------------------------------------------------------
+// Destination uses workspace addressing only - for instructions like MPY or DIV
+// -------------------------------------------------------------------------------
+inline void TdWA(void)
+{
+    u16 rData = (tms9900.currentOp>>6) & 0x0F;     // The register to use for destination addressing
+    tms9900.dstAddress = WP_REG(rData);            // Destination address is directly from the register
+    tms9900.dstAddress &= 0xFFFE;                  // We are always in WORD mode for Workspace Addressing
+}
+
+// ----------------------------------------------------------------------------------------------
+// When running from the block cache, the immediate words have already been fetched and stored
+// alongside the pre-decoded instruction. We still bump the PC so that everything that looks at
+// it (BL, X, interrupts and the like) sees exactly what it would have without the cache. The
+// memory fetch penalty was already accounted for in the pre-decoded fetchCycles.
+// ----------------------------------------------------------------------------------------------
+static inline __attribute__((always_inline)) u16 ReadPC16_Block(const u16 **ppImm)
+{
+    tms9900.PC += 2;
+    return *(*ppImm)++;
+}
 
-    switch (tms9900.currentOp & 0x0C00)
+// ---------------------------------------------------------------------------
+// Source addressing for the block cache - same as TsMode() but the symbolic
+// address comes out of the pre-decoded immediate words.
+// ---------------------------------------------------------------------------
+static inline __attribute__((always_inline)) void TsMode_Block(u16 bytes, u8 mode, const u16 **ppImm)
+{
+    u16 rData = REG_GET_FROM_OPCODE();
+
+    switch (mode)
     {
-        case 0x0000: // Rx  2c
-            tms9900.dstAddress = WP_REG(rData);
+        case MODE_REG: // Rx  2c
+            tms9900.srcAddress = WP_REG(rData);
             break;
 
-        case 0x0400: // *Rx  6c
-            tms9900.dstAddress = ReadWP_RAM16a(WP_REG(rData));
+        case MODE_IND: // *Rx  6c
+            tms9900.srcAddress = ReadWP_RAM16(WP_REG(rData));
             AddCycleCount(4);
             break;
 
-        case 0x0800: // @yyyy(Rx) or @yyyy if Rx=0  10c
-            tms9900.dstAddress = ReadPC16a();
-            if (rData) tms9900.dstAddress += ReadWP_RAM16a(WP_REG(rData));
+        case MODE_SYM: // @yyyy(Rx) or @yyyy if Rx=0  10c
+            tms9900.srcAddress = ReadPC16_Block(ppImm);
+            if (rData) tms9900.srcAddress += ReadWP_RAM16(WP_REG(rData));
             AddCycleCount(8);
             break;
 
         default: // *Rx+   10c
-            tms9900.dstAddress = ReadWP_RAM16a(WP_REG(rData));
-            WriteWP_RAM16a(WP_REG(rData), (tms9900.dstAddress + bytes));
+            tms9900.srcAddress = ReadWP_RAM16(WP_REG(rData));
+            WriteWP_RAM16(WP_REG(rData), (tms9900.srcAddress + bytes));
             AddCycleCount(((bytes&1) ? 6:8)); // Add 6 cycles for byte address... 8 for word address
             break;
     }
 
-    if (bytes&2) tms9900.dstAddress &= 0xFFFE;   // bytes is either 1 (in which case we will utilize the LSB) or 2 (in which case we mask off to 16-bits)
+    if (bytes&2) tms9900.srcAddress &= 0xFFFE;   // bytes is either 1 (in which case we will utilize the LSB) or 2 (in which case we mask off to 16-bits)
 }
 
-// -------------------------------------------------------------------------------
-// Destination uses workspace addressing only - for instructions like MPY or DIV
-// -------------------------------------------------------------------------------
-inline void TdWA(void)
+static inline __attribute__((always_inline)) void Ts_Block(u16 bytes, const u16 **ppImm)
 {
-    u16 rData = (tms9900.currentOp>>6) & 0x0F;     // The register to use for destination addressing
-    tms9900.dstAddress = WP_REG(rData);            // Destination address is directly from the register
-    tms9900.dstAddress &= 0xFFFE;                  // We are always in WORD mode for Workspace Addressing
+    TsMode_Block(bytes, (tms9900.currentOp >> 4) & 3, ppImm);
 }
 
-// ----------------------------------------------------------
-// Many opcodes want both a source and destination address
-// and for this decoding mode, we will look at the current
-// opcode to determine if this is byte or word addressing...
-// ----------------------------------------------------------
-static inline __attribute__((always_inline)) void TsTd(void)
+// ---------------------------------------------------------------------------
+// Destination addressing for the block cache - same as TdMode() but the
+// symbolic address comes out of the pre-decoded immediate words.
+// ---------------------------------------------------------------------------
+static inline __attribute__((always_inline)) void TdMode_Block(u16 bytes, u8 mode, const u16 **ppImm)
 {
-    u16 bytes = (tms9900.currentOp & 0x1000) ? SOURCE_BYTE:SOURCE_WORD;     // This handles both Word and Byte addresses
-    Ts(bytes); Td(bytes);
+    u16 rData = (tms9900.currentOp>>6) & 0x0F;
+
+    switch (mode)
+    {
+        case MODE_REG: // Rx  2c
+            tms9900.dstAddress = WP_REG(rData);
+            break;
+
+        case MODE_IND: // *Rx  6c
+            tms9900.dstAddress = ReadWP_RAM16(WP_REG(rData));
+            AddCycleCount(4);
+            break;
+
+        case MODE_SYM: // @yyyy(Rx) or @yyyy if Rx=0  10c
+            tms9900.dstAddress = ReadPC16_Block(ppImm);
+            if (rData) tms9900.dstAddress += ReadWP_RAM16(WP_REG(rData));
+            AddCycleCount(8);
+            break;
+
+        default: // *Rx+   10c
+            tms9900.dstAddress = ReadWP_RAM16(WP_REG(rData));
+            WriteWP_RAM16(WP_REG(rData), (tms9900.dstAddress + bytes));
+            AddCycleCount(((bytes&1) ? 6:8)); // Add 6 cycles for byte address... 8 for word address
+            break;
+    }
+
+    if (bytes&2) tms9900.dstAddress &= 0xFFFE;   // bytes is either 1 (in which case we will utilize the LSB) or 2 (in which case we mask off to 16-bits)
 }
 
-// ---------------------------------------------------------------
-// This is the version for the 'Accurate' CPU core. A bit slower.
-// ---------------------------------------------------------------
-static inline __attribute__((always_inline)) void TsTd_Accurate(void)
+static inline __attribute__((always_inline)) void Td_Block(u16 bytes, const u16 **ppImm)
 {
-    u16 bytes = (tms9900.currentOp & 0x1000) ? SOURCE_BYTE:SOURCE_WORD;     // This handles both Word and Byte addresses
-    Ts_Accurate(bytes); Td_Accurate(bytes);
+    TdMode_Block(bytes, (tms9900.currentOp >> 10) & 3, ppImm);
 }
-
 // --------------------------------------------------------------------------------------
 // The context switch saves the WP, PC and Status and sets up for the new workspace.
 // --------------------------------------------------------------------------------------
@@ -1368,6 +1763,7 @@ void TMS9900_ContextSwitch(u16 address)
     tms9900.WP &= 0xFFFE;                       // Ensure WP is word-aligned
     MemoryWrite16(WP_REG(13), old_wp);          // Set the old Workspace Pointer
     MemoryWrite16(WP_REG(14), tms9900.PC);      // Set the old PC
+    STATUS_SYNC();
     MemoryWrite16(WP_REG(15), tms9900.ST);      // Set the old Status
     tms9900.PC = MemoryRead16(address+2);       // Set the new PC based on original workspace
     tms9900.PC &= 0xFFFE;                       // Ensure PC is word-aligned
@@ -1382,6 +1778,8 @@ void TMS9900_ContextSwitch(u16 address)
 // ---------------------------------------------------------------------------------------
 void TMS9900_HandlePendingInterrupts(void)
 {
+    intCheck = 0;   // Nothing more to look at until another interrupt is raised or the mask opens up again
+
     // --------------------------------------------------------------------------------
     // Literally any level except 0 will allow VDP interrupt.
     // Someday we might be more sophisticated than this... but that day is not today.
@@ -1392,130 +1790,1032 @@ void TMS9900_HandlePendingInterrupts(void)
         tms9900.ST &= ~ST_INTMASK;          // De-escalate the interrupt. Since we only support one level we can clear it all...
         tms9900.ST |= 1;                    // Keep the level 2 interrupt alive
         tms9900.idleReq=0;                  // And if we were waiting on IDLE, this will start the CPU back up
+        spinPC = 1;                         // And if we were in the middle of a busy-wait loop, we're not any more
+
+        // The level 2 mask is still open - if the source wasn't cleared we'll be right back here next instruction
+        if (tms9900.cpuInt & (INT_VDP | INT_TIMER)) intCheck = 1;
     }
 }
 
+// -----------------------------------------------------------------------------------------------
+// With RAM mirrors enabled, a write to >8060 also lands at >8360 so for the purposes of tracking
+// self-modifying code we always count scratchpad writes against the >83xx mirror.
+// -----------------------------------------------------------------------------------------------
+static inline __attribute__((always_inline)) u16 ScratchpadMirror(u16 address)
+{
+    if (myConfig.RAMMirrors && ((address & 0xFC00) == 0x8000)) address |= 0x0300;
+    return address;
+}
 
-// -------------------------------------------------------------
-// Mainly for the X = Execute instruction (not frequently used)
-// This chews up almost 20K of program space which isn't ideal
-// but the other methods of handling the X instruction right
-// now look less ideal... and it's only a bit of wasted memory!
-// -------------------------------------------------------------
-void ExecuteOneInstruction(u16 opcode)
+static inline __attribute__((always_inline)) u16 BlockChunk(u16 address)
 {
-    u8 data8;
-    u16 data16;
-    u8 op8 = (u8)OpcodeLookup[opcode];
-    switch (op8)
+    return ScratchpadMirror(address) >> 4;
+}
+
+// -----------------------------------------------------------------------------------------------
+// Throw away every block in the cache. Called on reset and whenever something other than the
+// CPU changes memory that might hold code (DSR paging, Super Cart bank swap, state load...)
+// -----------------------------------------------------------------------------------------------
+void TMS9900_FlushBlockCache(void)
+{
+    for (u16 i=0; i<BLOCK_CACHE_SIZE; i++)
     {
-    #include "tms9900.inc"
+        BlockCache[i].source = NULL;
     }
+    memset(BlockCodeMark, 0x00, sizeof(BlockCodeMark));
+    blockEpoch = 1;
+    blockExit = 1;
+    samsBlocksCached = 0;
+#ifdef DS99_HOST
+    TMS9900_BlockFlushes++;
+#endif
 }
 
-// --------------------------------------------------------------------------------------------------------------------------------
-// A bit more CPU intensive - this runs somewhere between 10 and 15% slower on the DS but allows us to handle more
-// complex emulation such as TMS9901 Timer, SAMS memory and/or the IDLE instruction. This only gets enabled when needed...
-// most carts will use TMS9900_Run() instead for much improved emulation speed (mostly needed for the older DS-Lite/Phat hardware)
-// --------------------------------------------------------------------------------------------------------------------------------
-void TMS9900_RunAccurate(void)
+// ---------------------------------------------------------------------------------------------------
+// The CPU wrote to a 16-byte chunk of RAM that holds cached code. Rather than hunting down which
+// blocks are affected, we bump the epoch which invalidates every RAM block in one go (ROM blocks
+// are unaffected). Self-modifying code is uncommon and this keeps the write check down to a single
+// byte look-up. If the same chunk keeps getting hit, we stop caching it altogether.
+// ---------------------------------------------------------------------------------------------------
+void TMS9900_BlockCodeWrite(u16 address)
 {
-    u32 myCounter = tms9900.cycles+228-tms9900.cycleDelta;
+    u16 chunk = BlockChunk(address);
+    if (BlockSMCCount[chunk] < BLOCK_SMC_LIMIT) BlockSMCCount[chunk]++;
+
+    memset(BlockCodeMark, 0x00, sizeof(BlockCodeMark));
+    if (++blockEpoch == 0) TMS9900_FlushBlockCache();   // On the very rare wrap we start over with a clean cache
+    blockExit = 1;                                      // The block we are running might be the one that just changed
+}
 
-    // ---------------------------------------------------------------------------------------------------
-    // Timer support is quite preliminary - but it's only used by cassette tape load/timeout and a tiny
-    // number of other programs use it. We don't get it quite right here... we are only decrementing the
-    // timer by 3 ticks every scanline which approximates the 9901 timer (64 CPU clocks per tick).
-    // Classic 99 does this more accurately and checks after every instruction for a possible decrement.
-    // But this is good enough for DS use and produces a roughly 46.9KHz timer which isn't too far off.
-    // ---------------------------------------------------------------------------------------------------
-    if (tms9901.TimerCounter)   // Has a timer been programmed?
+// ---------------------------------------------------------------------------------------------------
+// A SAMS bank switch just moved RAM out from under the CPU. Any block we cached from SAMS memory may
+// now be looking at the wrong bank (or its bank may be written through some other region before it
+// comes back) so if we have cached any SAMS code we drop all RAM blocks the same way a code write
+// does. Programs that only keep data in the SAMS banks never pay for this.
+// ---------------------------------------------------------------------------------------------------
+void TMS9900_SAMSBankChanged(void)
+{
+    if (samsBlocksCached)
     {
-        if (tms9901.PinState[PIN_TIMER_OR_IO] == IO_MODE)   // Timer only runs when we are in IO Mode
+        samsBlocksCached = 0;
+        memset(BlockCodeMark, 0x00, sizeof(BlockCodeMark));
+        if (++blockEpoch == 0) TMS9900_FlushBlockCache();   // On the very rare wrap we start over with a clean cache
+        blockExit = 1;                                      // The block we are running might be in the bank that just left
+    }
+}
+
+// ---------------------------------------------------------------------------------------------
+// Where does a PC fetch for this address come from? This must match what ReadPC16() does.
+// ---------------------------------------------------------------------------------------------
+static inline __attribute__((always_inline)) u8 *BlockSource(u16 address)
+{
+    return PageRead[address>>8] + address;
+}
+
+// ---------------------------------------------------------------------------------------------
+// How many immediate or symbolic address words follow this opcode in the instruction stream.
+// ---------------------------------------------------------------------------------------------
+static u8 BlockImmediateWords(u16 opcode, u8 op8)
+{
+    if ((op8 >= op_li) && (op8 <= op_ci)) return 1;                     // LI, AI, ANDI, ORI, CI
+    if ((op8 == op_lwpi) || (op8 == op_limi)) return 1;
+    if ((op8 >= op_szc) && (op8 <= op_socb_II))                         // Format I - both source and destination addressing
+    {
+        return (((opcode & 0x0030) == 0x0020) ? 1:0) + (((opcode & 0x0C00) == 0x0800) ? 1:0);
+    }
+    if (((op8 >= op_blwp) && (op8 <= op_abs)) || ((op8 >= op_coc) && (op8 <= op_div)))   // Source addressing only
+    {
+        return (((opcode & 0x0030) == 0x0020) ? 1:0);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Anything that can move the PC somewhere other than the next instruction (or change the
+// interrupt mask) ends the block. The main loop will look up the next block from there.
+// ---------------------------------------------------------------------------------------------
+static u8 BlockEndsWith(u8 op8)
+{
+    if ((op8 >= op_jmp) && (op8 <= op_jop)) return 1;
+    switch (op8)
+    {
+        case op_b:
+        case op_bl:
+        case op_blwp:
+        case op_rtwp:
+        case op_x:
+        case op_xop:
+        case op_limi:
+        case op_rset:
+        case op_idle:
+            return 1;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Can this word be part of a cached block that started in memory of type memType? The whole
+// block must come from the same sort of memory (so the fetch penalty is the same throughout)
+// and RAM blocks must stay clear of chunks that have proven to be self-modifying.
+// ---------------------------------------------------------------------------------------------
+static inline u8 BlockWordOK(u32 address, u8 memType, u16 epoch)
+{
+    if (address > 0xFFFE) return 0;
+    if (MemType[address>>4] != memType) return 0;
+    if ((memType == MF_SAMS8) && ((address ^ tms9900.PC) & 0xF000)) return 0;  // SAMS blocks stay inside one 4K bank
+    if (epoch && (BlockSMCCount[BlockChunk(address)] >= BLOCK_SMC_LIMIT)) return 0;
+    return 1;
+}
+
+// ---------------------------------------------------------------------------------------------------
+// Is this block part of a candidate for busy-wait fast-forwarding? The loop must do nothing but read
+// memory into registers and compare things - the classic wait on the VDP status at >8802 or on a
+// scratchpad flag the interrupt routine sets. No memory writes other than the workspace registers,
+// no auto-increment and no CRU. A register that gets added to, shifted, incremented etc. must be
+// loaded earlier in the loop or it would never settle down (that's a delay loop and not what we are
+// after here) and a register used to address memory must not be written at all - that way we can
+// check the addresses once with the registers as they stand. Whether the loop really is spinning is
+// decided at run time by TMS9900_SpinSkip() - this just weeds out everything else cheaply.
+// ---------------------------------------------------------------------------------------------------
+static u8 BlockSpinBody(TMS9900_Block *block)
+{
+    u16 loaded  = 0x0000;   // Registers we have seen loaded so far in this block
+    u16 written = 0x0000;   // Registers written anywhere in this block
+    u16 pointer = 0x0000;   // Registers used to address memory
+
+    for (u8 i=0; i < (block->numInstr-1); i++)
+    {
+        u16 opcode = block->instr[i].opcode;
+        u8  op8    = block->instr[i].op8;
+        u8  reg    = opcode & 0x0F;
+        u8  mode   = (opcode >> 4) & 3;                 // Source addressing mode (for those that have one)
+
+        // Format I, COC/CZC and the single operand instructions all have a general source operand
+        if (((op8 >= op_szc) && (op8 <= op_socb_II)) || (op8 == op_coc) || (op8 == op_czc) || ((op8 >= op_clr) && (op8 <= op_abs)))
         {
-            // This is a gross misrepresentation of how the timer works... needs to be more accurate but good enough for now
-            if (tms9901.TimerCounter > 3) tms9901.TimerCounter -= 3;
-            else
+            if (mode == MODE_INC) return 0;
+            if (mode != MODE_REG) pointer |= (1 << reg);
+        }
+
+        if ((op8 >= op_szc) && (op8 <= op_socb_II))     // Format I
+        {
+            u8 family  = (op8 - op_szc) / 5;            // szc, szcb, s, sb, c, cb, a, ab, mov, movb, soc, socb
+            u8 dstMode = (opcode >> 10) & 3;
+            u8 dstReg  = (opcode >> 6) & 0x0F;
+
+            if ((family == 4) || (family == 5))         // C and CB only read the destination
             {
-                // Timeout... possibly raise interrupt and reload timer
-                TMS9901_RaiseTimerInterrupt();
-                tms9901.TimerCounter = tms9901.TimerStart;
+                if (dstMode == MODE_INC) return 0;
+                if (dstMode != MODE_REG) pointer |= (1 << dstReg);
+                continue;
             }
+            if (dstMode != MODE_REG) return 0;
+            if ((family == 2) || (family == 3) || (family == 6) || (family == 7))   // S, SB, A, AB
+            {
+                if (!(loaded & (1 << dstReg))) return 0;
+            }
+            if ((family == 8) || (family == 9)) loaded |= (1 << dstReg);            // MOV, MOVB
+            written |= (1 << dstReg);
+            continue;
+        }
+
+        switch (op8)
+        {
+            case op_li:
+                loaded |= (1 << reg);
+                written |= (1 << reg);
+                break;
+            case op_ci:
+                break;
+            case op_andi:
+            case op_ori:
+                written |= (1 << reg);
+                break;
+            case op_ai:
+            case op_sra:
+            case op_srl:
+            case op_sla:
+            case op_src:
+                if (!(loaded & (1 << reg))) return 0;
+                written |= (1 << reg);
+                break;
+            case op_clr:
+            case op_seto:
+                if (mode != MODE_REG) return 0;
+                loaded |= (1 << reg);
+                written |= (1 << reg);
+                break;
+            case op_neg:
+            case op_inv:
+            case op_inc:
+            case op_inct:
+            case op_dec:
+            case op_dect:
+            case op_swpb:
+            case op_abs:
+                if (mode != MODE_REG) return 0;
+                if (!(loaded & (1 << reg))) return 0;
+                written |= (1 << reg);
+                break;
+            case op_coc:
+            case op_czc:
+                break;
+            default:
+                return 0;
         }
     }
 
-    do
+    pointer &= ~0x0001;     // R0 can't be an index register (symbolic @yyyy) and *R0 is rare enough to not worry about
+    return (written & pointer) ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------------------------------
+// A counted copy loop - the MOV or MOVB must step through memory on at least one side (*Rx+) with the
+// other side either stepping too or sitting on one address like the VDP data port (*Rx or @yyyy)
+// and the DEC or DECT counts down a register that isn't one of the pointers. This is how just about
+// every game gets data into VDP memory (the VMBW style upload) and moves blocks of RAM around.
+// ---------------------------------------------------------------------------------------------------
+static u8 BlockCopies(TMS9900_Block *block)
+{
+    u16 opcode  = block->instr[0].opcode;
+    u8  op8     = block->instr[0].op8;
+    u8  count   = block->instr[1].op8;
+    u8  cntReg  = block->instr[1].opcode & 0x0F;
+    u8  srcMode = (opcode >> 4) & 3;
+    u8  srcReg  = opcode & 0x0F;
+    u8  dstMode = (opcode >> 10) & 3;
+    u8  dstReg  = (opcode >> 6) & 0x0F;
+
+    if ((op8 < op_mov) || (op8 > op_movb_II)) return 0;                         // MOV or MOVB (any mode pair)
+    if ((count != op_dec) && (count != op_dect)) return 0;
+    if (((block->instr[1].opcode >> 4) & 3) != MODE_REG) return 0;
+    if ((srcMode != MODE_INC) && (dstMode != MODE_INC)) return 0;               // Has to step through memory
+    if ((srcMode == MODE_REG) || (dstMode == MODE_REG)) return 0;
+    if (((srcMode == MODE_SYM) && srcReg) || ((dstMode == MODE_SYM) && dstReg)) return 0;   // No indexing
+
+    if ((srcMode != MODE_SYM) && (srcReg == cntReg)) return 0;
+    if ((dstMode != MODE_SYM) && (dstReg == cntReg)) return 0;
+    if ((srcMode != MODE_SYM) && (dstMode != MODE_SYM) && (srcReg == dstReg)) return 0;
+    return 1;
+}
+
+static u8 BlockSpins(TMS9900_Block *block, u16 startPC, u16 endPC)
+{
+    TMS9900_PreDecode *last = &block->instr[block->numInstr-1];
+    if ((last->op8 < op_jmp) || (last->op8 > op_jop)) return SPIN_NONE;
+
+    u16 target = endPC + (((s8)last->opcode) << 1);
+
+    // The classic software delay - count a register down (or up) to zero with nothing else in the loop
+    if ((target == startPC) && (block->numInstr == 2) && (last->op8 == op_jne) && (((block->instr[0].opcode >> 4) & 3) == MODE_REG))
+    {
+        u8 op8 = block->instr[0].op8;
+        if ((op8 == op_dec) || (op8 == op_dect) || (op8 == op_inc) || (op8 == op_inct)) return SPIN_DELAY;
+    }
+
+    if ((target == startPC) && (block->numInstr == 3) && (last->op8 == op_jne) && BlockCopies(block)) return SPIN_COPY;
+
+    if (target == startPC) return BlockSpinBody(block) ? SPIN_LOOP : SPIN_NONE;
+
+    // A lone JMP back a short way might be closing a loop with the block before it
+    if ((block->numInstr == 1) && (last->op8 == op_jmp) && (target < startPC) && ((startPC - target) <= 96) && !TMS9900_IsTrap(startPC))
+    {
+        return SPIN_TAIL;
+    }
+
+    // A conditional jump out of the loop with a JMP right back to our start following it?
+    u16 next = *(u16*)BlockSource(endPC);
+    if ((last->op8 != op_jmp) && ((next & 0xFF00) == 0x1000) && ((u16)(endPC + 2 + (((s8)next) << 1)) == startPC))
+    {
+        return BlockSpinBody(block) ? SPIN_HEAD : SPIN_NONE;
+    }
+    return SPIN_NONE;
+}
+
+// ---------------------------------------------------------------------------------------------------
+// Superinstructions - rewrite the most common back to back pairs in a freshly built block so that
+// the pair runs through one handler (see tms9900_fused.inc). The jump pairs can only be the last two
+// instructions (jumps end a block) so those are looked at first and the move+count pairs fill in the
+// rest. Spin blocks are left alone as the fast-forward code looks at their instructions. The pairs
+// came from the PAIR_HISTOGRAM host build - retune here and in tms9900_fused.inc if a better set turns
+// up. Each fused handler is a little more ITCM on the DS so keep the list to the pairs that matter.
+// ---------------------------------------------------------------------------------------------------
+static u8 FusedJump(u8 first, u8 second)
+{
+    if (first == op_dec)
+    {
+        if (second == op_jne) return op_dec_jne;
+        if (second == op_jeq) return op_dec_jeq;
+        if (second == op_jgt) return op_dec_jgt;
+    }
+    else if (first == op_ci)
+    {
+        if (second == op_jne) return op_ci_jne;
+        if (second == op_jeq) return op_ci_jeq;
+    }
+    else if ((first >= op_c) && (first <= op_c_II))     // Any of the C mode pairs - the fused handler decodes the modes
+    {
+        if (second == op_jne) return op_c_jne;
+        if (second == op_jeq) return op_c_jeq;
+    }
+    return 0;
+}
+
+static void BlockFuse(TMS9900_Block *block)
+{
+    TMS9900_PreDecode *instr = block->instr;
+    u8 last = block->numInstr;
+
+#ifdef TMS9900_PAIR_HISTOGRAM
+    return;                                             // Counting the pairs - they need to stay as they are
+#endif
+    if (last < 2) return;
+    u8 fused = FusedJump(instr[last-2].op8, instr[last-1].op8);
+    if (fused) {instr[last-2].op8 = fused; last -= 2;}
+
+    for (u8 i=0; (i+1) < last; i++)
+    {
+        if (instr[i+1].op8 != op_dec) continue;
+        if ((instr[i].op8 >= op_mov) && (instr[i].op8 <= op_mov_II))        instr[i].op8 = op_mov_dec;
+        else if ((instr[i].op8 >= op_movb) && (instr[i].op8 <= op_movb_II)) instr[i].op8 = op_movb_dec;
+        else continue;
+        i++;                                            // The DEC is spoken for
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------
+// Decode a straight-line run of instructions starting at the current PC into the given cache slot.
+// If the code lives somewhere we don't want to cache (a SAMS bank mapped in twice, peripheral
+// registers, code that keeps re-writing itself...) we decode just the one instruction into the scratch block which
+// is then run once and forgotten - same as the emulator did before there was a block cache.
+// ---------------------------------------------------------------------------------------------------
+TMS9900_Block *TMS9900_BuildBlock(u8 *source, TMS9900_Block *block)
+{
+    u16 address = tms9900.PC;
+    u8  memType = MemType[address>>4];
+    u16 epoch = 0;
+    u8  maxInstr = BLOCK_MAX_INSTR;
+
+    switch (memType)
+    {
+        case MF_MEM16:      // Console ROM or the scratchpad RAM
+            if (address & 0x8000) epoch = blockEpoch;
+            break;
+        case MF_RAM8:       // 32K expansion RAM (or cart RAM like the Mini Memory or Super Cart)
+            epoch = blockEpoch;
+            break;
+        case MF_SAMS8:      // SAMS banked RAM - the source pointer tells the banks apart
+            if (SAMS_IsAliased(address >> 12)) maxInstr = 0;   // Writes through the other mapping would go unseen
+            else {epoch = blockEpoch; samsBlocksCached = 1;}
+            break;
+        case MF_CART:       // Banked cart ROM - the source pointer tells the banks apart
+        case MF_CART_NB:    // Non-banked cart ROM (MBX lower 4K)
+        case MF_PERIF:      // DSR ROM - flushed whenever the DSR is paged in or out
+            break;
+        default:            // Anything else is not cached
+            maxInstr = 0;
+            break;
+    }
+
+    if (maxInstr && !BlockWordOK(address, memType, epoch)) maxInstr = 0;  // Code that keeps rewriting itself?
+    if (!maxInstr) {block = &BlockScratch; maxInstr = 1; epoch = 0;}
+
+    u32 pc = address;
+    u8 numInstr = 0;
+    while (numInstr < maxInstr)
     {
-        if (tms9900.cpuInt) TMS9900_HandlePendingInterrupts();
-        if (tms9900.idleReq)
+        u16 opcode = *(u16*)BlockSource(pc);
+        u8  op8 = (u8)OpcodeLookup[opcode];
+        u8  words = 1 + BlockImmediateWords(opcode, op8);
+
+        // Make sure the whole instruction (including immediate words) is something we can cache with this block
+        if (block != &BlockScratch)
         {
-            tms9900.cycles += 4;
-            idle_counter++;
+            u8 ok = 1;
+            for (u8 i=1; i<words; i++) ok &= BlockWordOK(pc+(i*2), memType, epoch);
+            if (!ok)
+            {
+                if (numInstr) break;                                    // End the block just before this instruction
+                block = &BlockScratch; maxInstr = 1; epoch = 0;         // Otherwise this one instruction is run uncached
+            }
         }
-        else
+
+        TMS9900_PreDecode *instr = &block->instr[numInstr++];
+        instr->opcode = opcode;
+        instr->op8 = op8;
+        instr->fetchCycles = 0;
+        for (u8 i=0; i<words; i++)
         {
-            u8 data8;
-            u16 data16;
+            u16 wordAddr = (u16)(pc + (i*2));
+            if (PageFlags[wordAddr>>8] & PAGE_WAIT) instr->fetchCycles += PAGE_WAIT;   // Same penalty as ReadPC16() would charge
+            if (i) instr->imm[i-1] = *(u16*)BlockSource(wordAddr);
+        }
+        pc += (words*2);
 
-            if (tms9900.PC == 0x40e8) HandleTICCSector();  // Disk access is not common but trap it here...
-            tms9900.currentOp = ReadPC16a();
-            u8 op8 = (u8)OpcodeLookup[tms9900.currentOp];
+        if (BlockEndsWith(op8)) break;
+        if (TMS9900_IsTrap((u16)pc)) break;                             // A PC trap must be at the start of a block
+    }
 
-            switch (op8)
+    block->source = source;
+    block->epoch = epoch;
+    block->numInstr = numInstr;
+    block->spin = (block != &BlockScratch) ? BlockSpins(block, address, (u16)pc) : SPIN_NONE;
+    if (blockFusion && (block != &BlockScratch) && (block->spin == SPIN_NONE)) BlockFuse(block);
+
+    // ---------------------------------------------------------------------------
+    // For RAM blocks, mark every 16-byte chunk we pulled code from so that any
+    // write into those chunks will invalidate the block (and any mirrors too).
+    // ---------------------------------------------------------------------------
+    if (epoch)
+    {
+        for (u32 chunk = (address>>4); chunk <= ((pc-1)>>4); chunk++)
+        {
+            if (myConfig.RAMMirrors && ((chunk & 0xFC0) == 0x800))
             {
-// We need to swap in the 'a' = accurate versions of the memory fetch handlers
-// These handlers are a bit slower but necessary to allow for SAMS banked memory access.
-#define ReadWP_RAM16    ReadWP_RAM16a
-#define WriteWP_RAM16   WriteWP_RAM16a
-#define ReadPC16        ReadPC16a
-#define Ts              Ts_Accurate
-#define Td              Td_Accurate
-#define TsTd            TsTd_Accurate
-            #include "tms9900.inc"
-#undef ReadWP_RAM16
-#undef WriteWP_RAM16
-#undef ReadPC16
-#undef Ts
-#undef Td
-#undef TsTd
+                BlockCodeMark[0x800 | (chunk & 0x00F)] = 1;
+                BlockCodeMark[0x810 | (chunk & 0x00F)] = 1;
+                BlockCodeMark[0x820 | (chunk & 0x00F)] = 1;
+                BlockCodeMark[0x830 | (chunk & 0x00F)] = 1;
             }
+            else BlockCodeMark[chunk] = 1;
         }
     }
-    while(tms9900.cycles < myCounter);    // There are 228 CPU clocks per line on the TI
 
-    tms9900.cycleDelta = tms9900.cycles-myCounter;
+    return block;
+}
+
+
+// ---------------------------------------------------------------------------------
+// Find the block for the current PC - or build it if this is the first time...
+// ---------------------------------------------------------------------------------
+static inline __attribute__((always_inline)) TMS9900_Block *BlockLookup(void)
+{
+    u8 *source = BlockSource(tms9900.PC);
+    TMS9900_Block *block = &BlockCache[((uintptr_t)source >> 1) & (BLOCK_CACHE_SIZE-1)];
+    if ((block->source != source) || (block->epoch && (block->epoch != blockEpoch)))
+    {
+        block = TMS9900_BuildBlock(source, block);
+    }
+    return block;
+}
+
+// ---------------------------------------------------------------------------------------------------
+// Busy-wait fast-forwarding. Lots of games sit in a tight loop reading the VDP status or a flag in
+// the scratchpad waiting for the next interrupt. Nothing those loops read can change until the next
+// event (the end of the scanline or the 9901 timer) so once an iteration of a spin loop leaves the
+// CPU exactly as it found it - registers, status, VDP status and latch - every iteration until then
+// is going to do the same. We skip ahead by however many whole iterations fit before the event and
+// let the last one run for real so the CPU stops in exactly the same place it would have.
+// ---------------------------------------------------------------------------------------------------
+static inline __attribute__((always_inline)) u16 SpinRegister(u8 reg)
+{
+    u16 address = (u16)WP_REG(reg);
+    return *(u16*)(PageRead[address>>8] + address);
+}
+
+// Snapshot the CPU just before a SPIN_LOOP, SPIN_HEAD or SPIN_DELAY block runs
+void TMS9900_SpinEnter(void)
+{
+    spinPC = 1;
+    if ((PageFlags[tms9900.WP>>8] | PageFlags[(u16)WP_REG(15)>>8]) & PAGE_DEVICE) return;   // Workspace in a device?! Not for us...
+
+    for (u8 reg=0; reg<16; reg++) spinRegs[reg] = SpinRegister(reg);
+    STATUS_SYNC();
+    spinWP = tms9900.WP;
+    spinST = tms9900.ST;
+    spinInt = tms9900.cpuInt;
+    spinVDPStatus = VDPStatus;
+    spinVDPLatch = VDPCtrlLatch;
+    spinCycles = tms9900.cycles;
+    spinPC = tms9900.PC;
+}
+
+// Memory reads must not have any side effects - plain memory or the VDP status (which we check didn't change)
+static u8 SpinReadOK(u16 address)
+{
+    if (!(PageFlags[address>>8] & PAGE_DEVICE)) return 1;
+    return (MemType[address>>4] == MF_VDP_R) && (address & 2);
+}
+
+// Check one general source/destination operand - anything other than a register must be a harmless read
+static u8 SpinOperandOK(u8 mode, u8 reg, const u16 **pImm)
+{
+    if (mode == MODE_REG) return 1;
+    if (mode == MODE_IND) return SpinReadOK(SpinRegister(reg));
+    u16 address = *(*pImm)++;
+    if (reg) address += SpinRegister(reg);
+    return SpinReadOK(address);
+}
+
+// Every memory operand in the loop - the registers used to address memory are never written (see BlockSpinBody())
+static u8 SpinOperandsOK(const TMS9900_PreDecode *instr, u8 numInstr)
+{
+    for (u8 i=0; i < (numInstr-1); i++, instr++)
+    {
+        const u16 *pImm = instr->imm;
+        u16 opcode = instr->opcode;
+        u8  op8 = instr->op8;
+
+        if (((op8 >= op_szc) && (op8 <= op_socb_II)) || (op8 == op_coc) || (op8 == op_czc) || ((op8 >= op_clr) && (op8 <= op_abs)))
+        {
+            if (!SpinOperandOK((opcode >> 4) & 3, opcode & 0x0F, &pImm)) return 0;
+        }
+        if ((op8 >= op_szc) && (op8 <= op_socb_II))
+        {
+            if (!SpinOperandOK((opcode >> 10) & 3, (opcode >> 6) & 0x0F, &pImm)) return 0;
+        }
+    }
+    return 1;
+}
+
+// ---------------------------------------------------------------------------------------------------
+// Status as set by the last INC/INCT/DEC/DECT of a counted loop we skipped over (from the register
+// value before that last step) - same as the opcode handlers work it out.
+// ---------------------------------------------------------------------------------------------------
+static void SpinCountStatus(u16 before, s8 step)
+{
+    u16 after = before + step;
+
+    tms9900.ST = STATUS_CLEAR_LAECO | CompareZeroLookup16[after];
+    statusLazy = 0;
+    if (step < 0)
+    {
+        u16 sData = -step;
+        if (after < before)                                                          tms9900.ST |= ST_C;
+        if (((sData&0x8000)!=(before&0x8000))&&((after&0x8000)!=(before&0x8000)))    tms9900.ST |= ST_OV;
+    }
+    else
+    {
+        u16 dData = step;
+        if (after < before)                                                          tms9900.ST |= ST_C;
+        if (((before&0x8000)==(dData&0x8000))&&((after&0x8000)!=(dData&0x8000)))     tms9900.ST |= ST_OV;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------
+// A counted delay loop (DEC Rx / JNE back to the DEC - or DECT, INC or INCT) just went around once.
+// We know exactly how many more times it will go around before the register hits zero so we can
+// run out as many of those as fit before the next event in one go. The register, status and cycle
+// count end up just as if every iteration had run - and if the event comes first, we stop right
+// where the CPU would have been when it arrived.
+// ---------------------------------------------------------------------------------------------------
+static void TMS9900_DelaySkip(const TMS9900_PreDecode *instr)
+{
+    if (tms9900.PC != spinPC) {spinPC = 1; return;}     // Counted all the way down (or never took the snapshot)
+    spinPC = 1;
+    if (intCheck) return;                               // An interrupt to look at before the next time around
+
+    u8  reg   = instr->opcode & 0x0F;
+    s8  step  = (instr->op8 == op_dec) ? -1 : (instr->op8 == op_dect) ? -2 : (instr->op8 == op_inc) ? 1 : 2;
+    u16 value = SpinRegister(reg);                      // Can't be zero or we wouldn't have jumped back
+
+    // How many more times around before the register hits zero (and we drop out of the loop)?
+    u32 remaining;
+    if (step == -1)      remaining = value - 1;
+    else if (step == 1)  remaining = 0xFFFF - value;
+    else if (value & 1)  remaining = 0xFFFFFFFF;        // Stepping by 2 from an odd value never hits zero - spins until an interrupt
+    else if (step == -2) remaining = (value >> 1) - 1;
+    else                 remaining = ((0x10000 - value) >> 1) - 1;
+
+    u32 iteration = tms9900.cycles - spinCycles;
+    s32 left = (s32)(eventNext - tms9900.cycles);
+    if ((left <= 0) || !iteration) return;
+
+    u32 skip = ((u32)left - 1) / iteration;             // Only whole iterations that finish before the event
+    if (skip > remaining) skip = remaining;
+    if (!skip) return;
+
+    u16 before = value + (u16)((skip - 1) * step);
+    WriteWP_RAM16(WP_REG(reg), before + step);
+    SpinCountStatus(before, step);
+
+    tms9900.cycles += skip * iteration;
+#ifdef DS99_HOST
+    tms9900_instructions += skip * 2;
+#endif
+}
+
+// ---------------------------------------------------------------------------------------------------
+// The stepping side of a copy loop must be plain memory (and not the workspace - we hold the registers
+// in our hands until the end). The fixed side may also be the VDP or GROM data port. Writes must not
+// land on cached code - the normal write handlers deal with that when the CPU gets there itself.
+// ---------------------------------------------------------------------------------------------------
+static inline __attribute__((always_inline)) u8 CopyNotWorkspace(u16 address)
+{
+    // With RAM mirrors on, >8000-82FF is the same memory as >83xx - compare both through the >83xx mirror
+    return (u16)(ScratchpadMirror(address) - ScratchpadMirror(tms9900.WP)) >= 32;
+}
+
+static inline __attribute__((always_inline)) u8 CopyReadOK(u16 address, u16 step)
+{
+    u8 page = address >> 8;
+    if (!(PageFlags[page] & PAGE_DEVICE)) return CopyNotWorkspace(address);
+    if (step || (address & 2)) return 0;        // Stepping through ports, VDP status or GROM address - leave those to the CPU
+    return (PageRead8[page] == ReadVDP8) || (PageRead8[page] == ReadGROM8);
+}
+
+// ---------------------------------------------------------------------------------------------------
+// Copy loop reads from the fixed side data port. The GROM wait states are already in the iteration
+// we timed so we take the byte without charging for it again.
+// ---------------------------------------------------------------------------------------------------
+static inline __attribute__((always_inline)) u8 CopyRead8(u16 address)
+{
+    u8 page = address >> 8;
+    if (PageRead8[page] == ReadGROM8) return ReadGROMData();
+    return PageRead8[page](address);
+}
+
+static inline __attribute__((always_inline)) u16 CopyRead16(u16 address)
+{
+    u8 page = address >> 8;
+    if (PageRead8[page] == ReadGROM8) {u16 data = ReadGROMData(); return data | ((u16)ReadGROMData() << 8);}
+    return PageRead16[page](address);
+}
+
+static inline __attribute__((always_inline)) u8 CopyWriteOK(u16 address)
+{
+    u8 page = address >> 8;
+    if (PageWrite[page]) return !BlockCodeMark[BlockChunk(address)] && CopyNotWorkspace(address);
+    return !(address & 2) && (PageWrite8[page] == WriteVDP8);
+}
+
+// ---------------------------------------------------------------------------------------------------
+// A counted copy loop (see BlockCopies()) just went around once. We move as many more bytes or words
+// as fit before the next event right here - a byte at a time through the page table (or straight into
+// VDP memory for the usual VMBW style upload) - charging exactly what the CPU would have. The cost of
+// an iteration only changes with the wait states of the memory on either side so we stop whenever
+// we step into a page that isn't like the one we just timed (or into anything that isn't plain memory
+// or a data port) and let the CPU carry on from there. Status, registers and cycles come out just as
+// if every iteration had run. We never run the count all the way down - the last one is left to the
+// CPU so it falls out of the loop on its own.
+// ---------------------------------------------------------------------------------------------------
+static void TMS9900_CopySkip(const TMS9900_PreDecode *instr)
+{
+    if (tms9900.PC != spinPC) {spinPC = 1; return;}     // All done (or never took the snapshot)
+    spinPC = 1;
+    if (intCheck) return;                               // An interrupt to look at before the next time around
+
+    u16 opcode  = instr[0].opcode;
+    u16 bytes   = (opcode & 0x1000) ? 1 : 2;            // MOVB or MOV
+    u8  srcMode = (opcode >> 4) & 3;
+    u8  srcReg  = opcode & 0x0F;
+    u8  dstMode = (opcode >> 10) & 3;
+    u8  dstReg  = (opcode >> 6) & 0x0F;
+    u8  cntReg  = instr[1].opcode & 0x0F;
+    s8  step    = (instr[1].op8 == op_dec) ? -1 : -2;
+    const u16 *pImm = instr[0].imm;
+
+    u16 src   = (srcMode == MODE_SYM) ? *pImm++ : SpinRegister(srcReg);
+    u16 dst   = (dstMode == MODE_SYM) ? *pImm   : SpinRegister(dstReg);
+    u16 count = SpinRegister(cntReg);                   // Can't be zero or we wouldn't have jumped back
+    u16 srcStep = (srcMode == MODE_INC) ? bytes : 0;
+    u16 dstStep = (dstMode == MODE_INC) ? bytes : 0;
+
+    u32 remaining;
+    if (step == -1)      remaining = count - 1;
+    else if (count & 1)  remaining = 0xFFFFFFFF;        // DECT from an odd count never hits zero
+    else                 remaining = (count >> 1) - 1;
+
+    u32 iteration = tms9900.cycles - spinCycles;
+    s32 left = (s32)(eventNext - tms9900.cycles);
+    if ((left <= 0) || !iteration) return;
+
+    u32 skip = ((u32)left - 1) / iteration;             // Only whole iterations that finish before the event
+    if (skip > remaining) skip = remaining;
+    if (!skip) return;
+
+    // The wait states of the iteration we just timed - every one we run for it must match
+    u8  srcFlags = PageFlags[(u16)(src - srcStep) >> 8];
+    u8  dstFlags = PageFlags[(u16)(dst - dstStep) >> 8];
+    u8  data8 = 0;
+    u32 done = 0;
+
+    if ((bytes == 1) && srcStep && !dstStep && (PageWrite8[dst>>8] == WriteVDP8) && !(dst & 2))
+    {
+        // The VMBW - straight from memory into VDP RAM
+        while ((done < skip) && (PageFlags[src>>8] == srcFlags) && CopyReadOK(src, srcStep))
+        {
+            data8 = PageRead[src>>8][BYTE_LANE(src)];
+            pVDPVidMem[VAddr] = data8;
+            VDPWrote9918(VAddr);
+            VAddr = (VAddr+1)&0x3FFF;
+            src++; done++;
+        }
+        if (done) {VDPDlatch = data8; VDPCtrlLatch = 0;}
+    }
+    else
+    {
+        while (done < skip)
+        {
+            u16 s = (bytes == 2) ? (src & 0xFFFE) : src;
+            u16 d = (bytes == 2) ? (dst & 0xFFFE) : dst;
+            if ((PageFlags[s>>8] != srcFlags) || (PageFlags[d>>8] != dstFlags)) break;
+            if (!CopyReadOK(s, srcStep) || !CopyWriteOK(d)) break;
+
+            u8 sp = s >> 8, dp = d >> 8;
+            if (bytes == 2)
+            {
+                u16 data16 = (srcFlags & PAGE_DEVICE) ? CopyRead16(s) : *(u16*)(PageRead[sp] + s);
+                if (PageWrite[dp]) *(u16*)(PageWrite[dp] + d) = data16; else PageWrite16[dp](d, data16);
+            }
+            else
+            {
+                data8 = (srcFlags & PAGE_DEVICE) ? CopyRead8(s) : PageRead[sp][BYTE_LANE(s)];
+                if (PageWrite[dp]) PageWrite[dp][BYTE_LANE(d)] = data8; else PageWrite8[dp](d, data8);
+            }
+            src += srcStep; dst += dstStep; done++;
+        }
+    }
+    if (!done) return;
+
+    if (srcStep) WriteWP_RAM16(WP_REG(srcReg), src);
+    if (dstStep) WriteWP_RAM16(WP_REG(dstReg), dst);
+    u16 before = count + (u16)((done - 1) * step);
+    WriteWP_RAM16(WP_REG(cntReg), before + step);
+
+    if (bytes == 1) tms9900.ST = (tms9900.ST & ~ST_OP) | (CompareZeroLookup8[data8] & ST_OP);   // Parity from the last MOVB
+    SpinCountStatus(before, step);
+
+    tms9900.cycles += done * iteration;
+#ifdef DS99_HOST
+    tms9900_instructions += done * 3;
+#endif
+}
+
+// ---------------------------------------------------------------------------------------------------
+// A spin block just ran all the way through. The SPIN_HEAD of a two block loop only checks what it
+// read and leaves the rest for its SPIN_TAIL - which must be the very next thing to run (an interrupt
+// in between calls the whole thing off). At the end of the loop, if nothing changed, we skip ahead.
+// ---------------------------------------------------------------------------------------------------
+void TMS9900_SpinSkip(const TMS9900_PreDecode *instr, u8 numInstr, u8 spin)
+{
+    if (spin == SPIN_DELAY)
+    {
+        TMS9900_DelaySkip(instr);
+        return;
+    }
+
+    if (spin == SPIN_COPY)
+    {
+        TMS9900_CopySkip(instr);
+        return;
+    }
+
+    if (spin == SPIN_HEAD)
+    {
+        spinTail = 1;
+        if ((tms9900.PC == spinPC) || (spinPC & 1)) return;            // Never took the snapshot
+        if (!SpinOperandsOK(instr, numInstr)) {spinPC = 1; return;}
+        spinTail = tms9900.PC;                                          // Out of the loop or on to the JMP back
+        spinInstr = numInstr + 1;
+        return;
+    }
+
+    if (spin == SPIN_TAIL)
+    {
+        u16 start = tms9900.PC - 2 - (((s8)instr->opcode) << 1);       // Where this JMP was
+        u16 tail = spinTail;
+        spinTail = 1;
+        if (start != tail) return;
+    }
+    else
+    {
+        if ((tms9900.PC != spinPC) || !SpinOperandsOK(instr, numInstr)) {spinPC = 1; return;}
+        spinInstr = numInstr;
+    }
+
+    if (tms9900.PC != spinPC) return;       // Fell out of the loop (or never took the snapshot)
+    spinPC = 1;
+
+    if (intCheck) return;                   // An interrupt to look at before the next time around
+    STATUS_SYNC();
+    if ((tms9900.WP != spinWP) || (tms9900.ST != spinST) || (tms9900.cpuInt != spinInt)) return;
+    if ((VDPStatus != spinVDPStatus) || (VDPCtrlLatch != spinVDPLatch)) return;
+    for (u8 reg=0; reg<16; reg++) if (SpinRegister(reg) != spinRegs[reg]) return;
+
+    // ------------------------------------------------------------------------------------------
+    // Only whole iterations that finish before the event - the last one runs normally so that
+    // we stop mid-loop at the same spot (and same cycle count) as if we had run every one.
+    // ------------------------------------------------------------------------------------------
+    u32 iteration = tms9900.cycles - spinCycles;
+    s32 left = (s32)(eventNext - tms9900.cycles);
+    if ((left <= 0) || !iteration) return;
+
+    u32 skip = ((u32)left - 1) / iteration;
+    tms9900.cycles += skip * iteration;
+#ifdef DS99_HOST
+    tms9900_instructions += skip * spinInstr;
+#endif
+}
+
+// ---------------------------------------------------------------------------------------------------
+// The X = Execute instruction in the block cache cores. The block only pre-decoded the X itself so
+// the target instruction's immediate words (if any) are fetched here from right after the X - with
+// the same wait state penalty ReadPC16() would charge - and the handler reads them through pImm
+// as usual. X always ends a block so there is nothing after it in the block to get out of step.
+// ---------------------------------------------------------------------------------------------------
+static __attribute__((noinline)) const u16 *BlockFetchX(u16 *xImm, u8 op8)
+{
+    u8 words = BlockImmediateWords(tms9900.currentOp, op8);
+    for (u8 i=0; i<words; i++)
+    {
+        u16 address = tms9900.PC + (i*2);
+        if (PageFlags[address>>8] & PAGE_WAIT) AddCycleCount(PAGE_WAIT);
+        xImm[i] = *(u16*) (PageRead[address>>8] + address);
+    }
+    return xImm;
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------
+// A bit more CPU intensive - this runs somewhere between 10 and 15% slower on the DS but allows us to handle the IDLE
+// instruction. This only gets enabled when needed... most carts will use TMS9900_Run() instead for much improved
+// emulation speed (mostly needed for the older DS-Lite/Phat hardware). The 9901 timer is a scheduled event (see
+// TMS9901_ScheduleTimer()) and SAMS banks are in the page table so IDLE is the only thing left that needs this core.
+// --------------------------------------------------------------------------------------------------------------------------------
+#include "tms9900_accurate.inc"
+
+void TMS9900_RunAccurate(void)
+{
+    if (tms9900.accurateEmuFlags & ACCURATE_EMU_IDLE) TMS9900_RunAccurateIdle();
+    else TMS9900_Run();
 }
 
 // --------------------------------------------------------------------------------------------------------------
-// Execute 1 scanline worth of TMS9900 instructions. We keep track of the cycle delta - that is, the overage
-// from one scanline to the next and we compensate the next scanline by the appopriate delta to keep things
-// running at the right speed. In practice this has been good enough to render all the TI games properly.
+// Execute TMS9900 instructions until the next event is due (normally the end of the scanline - see the event
+// table). LoopTMS9900() keeps track of the cycle delta - that is, the overage from one scanline to the next
+// and compensates the next scanline by the appopriate delta to keep things running at the right speed.
+//
+// Instructions are run out of the block cache - straight-line runs of code that have already been fetched,
+// looked up in OpcodeLookup[] and had their immediate words gathered. We still check the cycle count after
+// every instruction and drop out of a block whenever an interrupt is raised or the memory underneath the
+// block changes (bank switch, self-modifying code) so the emulation is exactly what it was without the
+// cache... it's just that hot loops no longer pay for the fetch and decode every time around.
 //
 // This is chewing up a big chunk of the ITCM memory. Right now the entire opcode handling is roughly 20K of
 // fast instruction memory... but it buys us at least 10% speed by keeping those instructions in the cache.
 // --------------------------------------------------------------------------------------------------------------
 ITCM_CODE void TMS9900_Run(void)
 {
-    u32 myCounter = tms9900.cycles+228-tms9900.cycleDelta;
+#ifdef DS99_HOST
+    if (TMS9900_RunHook) {TMS9900_RunHook(); return;}   // The host JIT takes over if enabled
+#endif
+
+    u32 myCounter = eventNext;
+    const TMS9900_PreDecode *instr;
+    const u16 *pImm;
+    u16 xImm[2];
+    u8 count;
+    u8 op8;
+    u8 data8;
+    u16 data16;
+
+// We need to swap in the 'Block' versions of the PC fetch and source/destination handlers
+// so that the immediate words come from the pre-decoded instruction rather than memory.
+#define ReadPC16()      ReadPC16_Block(&pImm)
+#define Ts(b)           Ts_Block((b), &pImm)
+#define Td(b)           Td_Block((b), &pImm)
+#define TsMode(b,m)     TsMode_Block((b), (m), &pImm)
+#define TdMode(b,m)     TdMode_Block((b), (m), &pImm)
+
+// Everything we need to do before handing a pre-decoded instruction off to its handler
+#define BLOCK_FETCH()                               \
+    pImm = instr->imm;                              \
+    tms9900.currentOp = instr->opcode;              \
+    tms9900.PC += 2;                                \
+    AddCycleCount(instr->fetchCycles);              \
+    CountInstruction();                             \
+    CountPair()
+
+#ifdef THREADED_DISPATCH
+    #define DISPATCH_FUSED
+    #include "tms9900_dispatch.inc"
+    #undef DISPATCH_FUSED
+    #define EXECUTE_X()     {op8 = (u8)OpcodeLookup[tms9900.currentOp]; pImm = BlockFetchX(xImm, op8); goto *OpcodeDispatch[op8];}
+
+    // -----------------------------------------------------------------------------------------------
+    // Each handler runs the next instruction in the block directly unless the block is finished,
+    // the scanline is done or something (interrupt, bank switch, code write) has asked us to exit.
+    // -----------------------------------------------------------------------------------------------
+    #define NEXT_OPCODE                                                                 \
+        do                                                                              \
+        {                                                                               \
+            instr++;                                                                    \
+            if (!--count || blockExit || (tms9900.cycles >= myCounter)) goto block_done;\
+            BLOCK_FETCH();                                                              \
+            goto *OpcodeDispatch[instr->op8];                                           \
+        } while (0)
+#endif
 
     do
     {
-        u8 data8;
-        u16 data16;
+        if (intCheck) TMS9900_HandlePendingInterrupts();
+        if (PC_TRAPPED()) TMS9900_RunTraps();  // Disk access (or any other PC trap) is not common but trap it here...
 
-        if (tms9900.cpuInt) TMS9900_HandlePendingInterrupts();
-        if (tms9900.PC == 0x40e8) HandleTICCSector();  // Disk access is not common but trap it here...
-        tms9900.currentOp = ReadPC16();
-        u8 op8 = (u8)OpcodeLookup[tms9900.currentOp];
+        TMS9900_Block *block = BlockLookup();
+
+        instr = block->instr;
+        count = block->numInstr;
+        blockExit = 0;
+        myCounter = eventNext;  // An event might have been scheduled by the last block (e.g. the 9901 timer)
+        if (block->spin && (block->spin != SPIN_TAIL)) TMS9900_SpinEnter();
+
+#ifdef THREADED_DISPATCH
+        BLOCK_FETCH();
+        goto *OpcodeDispatch[instr->op8];
 
-        switch (op8)
-        {
         #include "tms9900.inc"
+        #include "tms9900_fused.inc"
+        #undef NEXT_OPCODE
+        #undef EXECUTE_X
+
+block_done:
+#else
+        do
+        {
+            BLOCK_FETCH();
+            op8 = instr->op8;
+            #define EXECUTE_X()     {op8 = (u8)OpcodeLookup[tms9900.currentOp]; pImm = BlockFetchX(xImm, op8); goto execute_x;}
+execute_x:
+            switch (op8)
+            {
+            #include "tms9900.inc"
+            #include "tms9900_fused.inc"
+            }
+            #undef EXECUTE_X
+            instr++;
         }
+        while (--count && !blockExit && (tms9900.cycles < myCounter));
+#endif
+        if (block->spin && !count) TMS9900_SpinSkip(block->instr, block->numInstr, block->spin);  // Ran the whole block - just waiting?
     }
-    while(tms9900.cycles < myCounter);    // There are 228 CPU clocks per line on the TI
+    while(tms9900.cycles < eventNext);    // Until the next event (there are 228 CPU clocks per line on the TI)
+
+    STATUS_SYNC();                        // Everyone outside the core expects to see the full status
+
+#undef BLOCK_FETCH
+#undef ReadPC16
+#undef Ts
+#undef Td
+#undef TsMode
+#undef TdMode
+}
 
-    tms9900.cycleDelta = tms9900.cycles-myCounter;
+#ifdef DS99_HOST
+// ---------------------------------------------------------------------------------------------------------------
+// Host build only - the x86-64 JIT in host/source/tms9900_jit.c translates blocks from the block cache into
+// native code. The instructions it doesn't translate itself call back in here to run the regular handler
+// (including the instruction fetch bookkeeping that TMS9900_Run() does before each handler).
+// ---------------------------------------------------------------------------------------------------------------
+MACHINE_LOCAL void (*TMS9900_RunHook)(void) = NULL;
+MACHINE_LOCAL u32  TMS9900_BlockFlushes = 0;
+
+TMS9900_Block *TMS9900_LookupBlock(void)
+{
+    return BlockLookup();
+}
+
+void TMS9900_ExecutePreDecoded(const TMS9900_PreDecode *instr)
+{
+    const u16 *pImm = instr->imm;
+    u16 xImm[2];
+    u8 op8 = instr->op8;
+    u8 data8;
+    u16 data16;
+
+    tms9900.currentOp = instr->opcode;
+    tms9900.PC += 2;
+    AddCycleCount(instr->fetchCycles);
+    CountInstruction();
+
+#define ReadPC16()      ReadPC16_Block(&pImm)
+#define Ts(b)           Ts_Block((b), &pImm)
+#define Td(b)           Td_Block((b), &pImm)
+#define TsMode(b,m)     TsMode_Block((b), (m), &pImm)
+#define TdMode(b,m)     TdMode_Block((b), (m), &pImm)
+#ifdef THREADED_DISPATCH
+    #include "tms9900_dispatch.inc"
+    #define NEXT_OPCODE     goto predecoded_done
+    #define EXECUTE_X()     {op8 = (u8)OpcodeLookup[tms9900.currentOp]; pImm = BlockFetchX(xImm, op8); goto *OpcodeDispatch[op8];}
+    goto *OpcodeDispatch[op8];
+    #include "tms9900.inc"
+    #undef NEXT_OPCODE
+predecoded_done:
+#else
+    #define EXECUTE_X()     {op8 = (u8)OpcodeLookup[tms9900.currentOp]; pImm = BlockFetchX(xImm, op8); goto execute_x;}
+execute_x:
+    switch (op8)
+    {
+    #include "tms9900.inc"
+    }
+#endif
+    #undef EXECUTE_X
+    STATUS_SYNC();      // The translated code always works with the full status
+#undef ReadPC16
+#undef Ts
+#undef Td
+#undef TsMode
+#undef TdMode
 }
+#endif
 
 // End of file
@@ -18,11 +18,28 @@
 #ifndef TMS9900_H_
 #define TMS9900_H_
 
-extern u32   debug[];   // For debugging on the DS...
+#include "../../DS99.h"
+
+extern MACHINE_LOCAL u32   debug[];   // For debugging on the DS...
+
+// -----------------------------------------------------------------------------------------------------------------
+// The 12 two-operand (Format I) opcodes each get a generic handler plus one handler for each of the common pairs
+// of register (R) and indirect (I) addressing. The suffix is the source mode then the destination mode. Anything
+// using Symbolic/Indexed or Autoincrement addressing goes to the generic handler which decodes the mode at run
+// time (those have memory fetches or a register write-back anyway so the decode is a small part of the cost).
+// The order here must match FORMAT1_HANDLER() in TMS9900_buildopcodes() so don't re-arrange these...
+// -----------------------------------------------------------------------------------------------------------------
+#define FORMAT1_MODE_PAIRS(op)  op, op##_RR, op##_IR, op##_RI, op##_II
+
+#define MODE_REG        0       // Rx
+#define MODE_IND        1       // *Rx
+#define MODE_SYM        2       // @yyyy(Rx) or @yyyy if Rx=0
+#define MODE_INC        3       // *Rx+
 
 // -----------------------------------------------------------------------------------------------------------------
 // The TMS9900 Opcodes... there are 69 of these plus we reserve the first one for 'bad' and the last one for 'max'
 // We pre-decode all possible (65535) 16-bit values into one of these opcodes for relatively blazingly fast speed.
+// With the Format I opcodes expanded by addressing mode we end up with 118 handlers which still fits in a byte.
 // -----------------------------------------------------------------------------------------------------------------
 enum _OPCODES
 {
@@ -84,29 +101,97 @@ enum _OPCODES
     op_stcr,
     op_mpy,
     op_div,
-    op_szc,
-    op_szcb,
-    op_s,
-    op_sb,
-    op_c,
-    op_cb,
-    op_a,
-    op_ab,
-    op_mov,
-    op_movb,
-    op_soc,
-    op_socb,
+    FORMAT1_MODE_PAIRS(op_szc),
+    FORMAT1_MODE_PAIRS(op_szcb),
+    FORMAT1_MODE_PAIRS(op_s),
+    FORMAT1_MODE_PAIRS(op_sb),
+    FORMAT1_MODE_PAIRS(op_c),
+    FORMAT1_MODE_PAIRS(op_cb),
+    FORMAT1_MODE_PAIRS(op_a),
+    FORMAT1_MODE_PAIRS(op_ab),
+    FORMAT1_MODE_PAIRS(op_mov),
+    FORMAT1_MODE_PAIRS(op_movb),
+    FORMAT1_MODE_PAIRS(op_soc),
+    FORMAT1_MODE_PAIRS(op_socb),
+
+    // The fused pairs - never produced by OpcodeLookup[], only by BlockFuse() in the block cache
+    op_dec_jne,
+    op_dec_jeq,
+    op_dec_jgt,
+    op_ci_jne,
+    op_ci_jeq,
+    op_c_jne,
+    op_c_jeq,
+    op_mov_dec,
+    op_movb_dec,
     op_max
 };
 
-extern u8   MemCPU[];
-extern u8   MemGROM[];
+// ----------------------------------------------------------------------------------------
+// The 16-bit bus memory (MemCPU[], the cart buffer and SAMS memory) is kept in the host's
+// native word order so that every word fetch is just a plain 16-bit load. The TI is big
+// endian so the even (high) byte of a word lives at the odd offset in our buffers - any
+// 8-bit access has to flip the low address bit with BYTE_LANE() to find the right byte.
+// Anything that comes from or goes to the outside world (ROM files, save states, etc.)
+// stays in the TI's byte order and is passed through TMS9900_SwapWords() on the way.
+// ----------------------------------------------------------------------------------------
+#define BYTE_LANE(address)  ((address) ^ 1)
+
+extern void TMS9900_SwapWords(u8 *buf, u32 len);
+extern void TMS9900_CopyWords(void *dest, const void *src, u32 len);
+
+// ----------------------------------------------------------------------------------------
+// The CPU address space is also split into 256 byte pages for the memory handlers. Each
+// page has a host pointer biased by the page's TI address (so PageRead[address>>8]+address
+// is the byte in host memory) which makes RAM, ROM, cart banks and SAMS banks a single
+// indexed load. Pages that can't be plain memory (VDP, GROM, speech and any page that
+// mixes memory types like the DSR space) set PAGE_DEVICE and go through the handlers.
+// Writes go straight through PageWrite[] when it's not NULL - otherwise the write handler
+// takes care of it (ROM, bank switching, sound, VDP, etc). PageRead[] is never NULL... for
+// device pages it points to whatever MemCPU[] has behind the device (same as it ever was).
+// ----------------------------------------------------------------------------------------
+#define PAGE_SHIFT          8
+#define PAGE_COUNT          (0x10000 >> PAGE_SHIFT)
+#define PAGE_WAIT           0x04    // On the 8-bit multiplexed bus... this is also the cycle penalty so it can be added directly
+#define PAGE_DEVICE         0x80    // Reads must go through PageRead16[]/PageRead8[]
+
+extern MACHINE_LOCAL u8    *PageRead[PAGE_COUNT];
+extern MACHINE_LOCAL u8    *PageWrite[PAGE_COUNT];
+extern MACHINE_LOCAL u8     PageFlags[PAGE_COUNT];
+extern MACHINE_LOCAL u16  (*PageRead16[PAGE_COUNT])(u16 address);
+extern MACHINE_LOCAL u8   (*PageRead8[PAGE_COUNT])(u16 address);
+extern MACHINE_LOCAL void (*PageWrite16[PAGE_COUNT])(u16 address, u16 data);
+extern MACHINE_LOCAL void (*PageWrite8[PAGE_COUNT])(u16 address, u8 data);
+
+#define PAGE_BYTE(address)  (PageRead[(address)>>PAGE_SHIFT][BYTE_LANE(address)])  // A peek at memory without any side effects
+
+extern void TMS9900_MapMemory(u16 start, u16 end);
+
+// ----------------------------------------------------------------------------------------
+// PC traps - a peripheral that emulates part of its DSR at a high level (the TI disk
+// controller sector read/write at >40E8) registers the address and a handler. The CPU
+// cores only look at the trap list when the PC is in a page flagged in PageTrap[] so an
+// unused trap (or one in a page nobody is running from) costs nothing. This is kept out of
+// PageFlags[] on purpose - a non-device page's flags are added straight on as the penalty.
+// ----------------------------------------------------------------------------------------
+#define MAX_PC_TRAPS        4
+
+extern MACHINE_LOCAL u8   PageTrap[PAGE_COUNT];
+#define PC_TRAPPED()        (PageTrap[tms9900.PC >> PAGE_SHIFT])
+
+extern void TMS9900_AddTrap(u16 address, void (*handler)(void));
+extern u8   TMS9900_IsTrap(u16 address);
+extern void TMS9900_RunTraps(void);
+extern void TMS9900_SyncScratchpad(void);
+
+extern MACHINE_LOCAL u8   MemCPU[];
+extern MACHINE_LOCAL u8   MemGROM[];
 extern u8   DiskDSR[];
-extern u16  BankMasks[];
-extern u8   MemType[0x10000>>4];
+extern const u16 BankMasks[];
+extern MACHINE_LOCAL u8   MemType[0x10000>>4];
 
-extern u8 cart_cru_shadow[16];
-extern u8 super_bank;
+extern MACHINE_LOCAL u8 cart_cru_shadow[16];
+extern MACHINE_LOCAL u8 super_bank;
 
 // ----------------------------------------------------------------------------
 // The entire state of the TMS9900 so we can easily save/load for save states.
@@ -117,7 +202,7 @@ typedef struct _TMS9900
     u32     WP;
     u32     ST;
     u32     cycles;
-    s32     cycleDelta;
+    s32     cycleDelta;         // How far the last scanline ran past its end - the next line is that much shorter
     u32     bankOffset;
     u8*     cartBankPtr;
     u16     bankMask;
@@ -134,10 +219,109 @@ typedef struct _TMS9900
     u16     illegalOPs;
 } TMS9900;
 
-extern TMS9900 tms9900;
+extern MACHINE_LOCAL TMS9900 tms9900;
+
+#ifdef DS99_HOST
+extern MACHINE_LOCAL u32 tms9900_instructions;   // Host build only - total instructions executed (for benchmarking)
+#ifdef TMS9900_PAIR_HISTOGRAM
+extern u32 TMS9900_PairHistogram[256][256];
+#endif
+#endif
 
 #define WP_REG(x)  (tms9900.WP + ((x)<<1))  // Registers are every 16-bits from the WP... no bounds check so we assume program is well-behaved
 
+// -----------------------------------------------------------------------------------------------------------
+// The block cache holds straight-line runs of pre-decoded instructions so that TMS9900_Run() doesn't have to
+// fetch, look-up and gather the immediate words for every instruction every time through a hot loop. Each
+// block is exactly 128 bytes (an 8 byte header plus 15 instructions at 8 bytes each) so the whole cache is a
+// tidy 64K. Blocks are found by the host memory address of their first instruction - this means a cart bank
+// switch automatically selects a different set of blocks without us having to throw anything away.
+// -----------------------------------------------------------------------------------------------------------
+#define BLOCK_CACHE_SIZE    512     // Number of blocks in the cache - must be a power of 2
+#define BLOCK_MAX_INSTR     15      // Longest straight-line run we will pre-decode into one block
+#define BLOCK_SMC_LIMIT     8       // After this many self-modifying writes, a 16-byte chunk of RAM is no longer cached
+
+typedef struct
+{
+    u16     opcode;                 // The raw opcode - the handlers still pull register numbers and addressing modes from this
+    u8      op8;                    // Pre-decoded OpcodeLookup[] value
+    u8      fetchCycles;            // Memory penalty for fetching the opcode and any immediate words (8-bit memory is 4 cycles/word)
+    u16     imm[2];                 // Up to two immediate / symbolic address words in the order the handler consumes them
+} TMS9900_PreDecode;
+
+typedef struct
+{
+    u8     *source;                 // Host address of the first instruction word (cartBankPtr based for banked cart space)
+    u16     epoch;                  // Zero for ROM blocks. RAM blocks must match blockEpoch to still be valid.
+    u8      numInstr;               // How many pre-decoded instructions are in this block
+    u8      spin;                   // Part of a tight loop that only reads memory (SPIN_xxx) - see TMS9900_SpinSkip()
+    TMS9900_PreDecode instr[BLOCK_MAX_INSTR];
+} TMS9900_Block;
+
+extern MACHINE_LOCAL u8  BlockCodeMark[0x10000>>4];
+extern MACHINE_LOCAL u8  blockExit;
+extern MACHINE_LOCAL u8  blockFusion;
+
+// ---------------------------------------------------------------------------------------------------------------
+// Busy-wait loops come in two shapes - a block that jumps right back to its own start (SPIN_LOOP) or a block that
+// ends with a conditional jump out of the loop (SPIN_HEAD) followed by a lone JMP back to the start (SPIN_TAIL).
+// Counted delay loops (DEC Rx / JNE $-2 and friends) are SPIN_DELAY and get run out in one go. Counted copy
+// loops (MOVB *R1+,*R15 / DEC R2 / JNE and friends) are SPIN_COPY and the data gets moved natively.
+// ---------------------------------------------------------------------------------------------------------------
+#define SPIN_NONE           0
+#define SPIN_LOOP           1
+#define SPIN_HEAD           2
+#define SPIN_TAIL           3
+#define SPIN_DELAY          4
+#define SPIN_COPY           5
+
+extern void TMS9900_SpinEnter(void);
+extern void TMS9900_SpinSkip(const TMS9900_PreDecode *instr, u8 numInstr, u8 spin);
+
+// ---------------------------------------------------------------------------------------------------------------
+// Events are scheduled against the CPU cycle counter. The CPU cores run until the next one is due (eventNext) and
+// LoopTMS9900() hands them out when the core returns. There are only a couple of them so a small fixed table that
+// we scan for the earliest entry is all we need. Scheduling an event that is earlier than the one the CPU is
+// currently running towards sets blockExit so the running core picks up the new eventNext right away.
+// ---------------------------------------------------------------------------------------------------------------
+#define EVENT_VDP_LINE      0       // The end of the scanline (or run of blank scanlines) the CPU is working through
+#define EVENT_TIMER         1       // The TMS9901 timer has counted down to zero
+#define EVENT_MAX           2
+
+extern MACHINE_LOCAL u32 eventNext;
+extern MACHINE_LOCAL u32 eventCycle[EVENT_MAX];
+extern MACHINE_LOCAL u8  eventActive;
+
+// Is this event scheduled and has the CPU reached it?
+#define TMS9900_EventDue(e) ((eventActive & (1 << (e))) && ((s32)(tms9900.cycles - eventCycle[e]) >= 0))
+
+// ---------------------------------------------------------------------------------------------------------------
+// The cores only look for a pending interrupt when intCheck is set - which only happens when something could
+// have changed the answer: an interrupt being raised or the interrupt mask being opened up (LIMI, RTWP)...
+// ---------------------------------------------------------------------------------------------------------------
+extern MACHINE_LOCAL u8  intCheck;
+
+#ifdef DS99_HOST
+// ---------------------------------------------------------------------------------------------------------------
+// Host build only - the hooks the x86-64 JIT (host/source/tms9900_jit.c) uses to sit on top of the block cache.
+// When TMS9900_RunHook is set, TMS9900_Run() hands the whole scanline over to it.
+// ---------------------------------------------------------------------------------------------------------------
+extern MACHINE_LOCAL void (*TMS9900_RunHook)(void);
+extern MACHINE_LOCAL TMS9900_Block BlockCache[BLOCK_CACHE_SIZE];
+extern MACHINE_LOCAL u16  blockEpoch;
+extern MACHINE_LOCAL u32  TMS9900_BlockFlushes;   // Counts TMS9900_FlushBlockCache() calls so the JIT knows to drop its translations too
+extern TMS9900_Block *TMS9900_LookupBlock(void);
+extern void TMS9900_ExecutePreDecoded(const TMS9900_PreDecode *instr);
+extern void TMS9900_HandlePendingInterrupts(void);
+extern u16  MemoryRead16(u16 address);
+extern void MemoryWrite16(u16 address, u16 data);
+extern u8   MemoryRead8(u16 address);
+extern void MemoryWrite8(u16 address, u8 data);
+extern void WriteWP_RAM16(u16 address, u16 data);
+extern u16  CompareZeroLookup8[256];
+extern u16  ParityTable[256];
+#endif
+
 // --------------------------------------------
 // Some common cycle times for GROM access
 // --------------------------------------------
@@ -181,20 +365,51 @@ enum _STATUS_FLAGS
 // plus some handling for when we add values, subtract values or compare values...
 // ---------------------------------------------------------------------------------------------------------
 #define STATUS_CLEAR_LAE        (tms9900.ST & ~(ST_LGT | ST_AGT | ST_EQ))
-#define STATUS_CLEAR_LAEC       (tms9900.ST & ~(ST_LGT | ST_AGT | ST_EQ | ST_C))
 #define STATUS_CLEAR_LAEP       (tms9900.ST & ~(ST_LGT | ST_AGT | ST_EQ | ST_OP))
 #define STATUS_CLEAR_LAECO      (tms9900.ST & ~(ST_LGT | ST_AGT | ST_EQ | ST_C | ST_OV))
-#define STATUS_CLEAR_LAEOP      (tms9900.ST & ~(ST_LGT | ST_AGT | ST_EQ | ST_OV | ST_OP))
-#define STATUS_CLEAR_LAECOP     (tms9900.ST & ~(ST_LGT | ST_AGT | ST_EQ | ST_C | ST_OV | ST_OP))
+
+// For the handlers that leave the zero-compare bits to the lazy status (see below)
+#define STATUS_CLEAR_C          (tms9900.ST & ~(ST_C))
+#define STATUS_CLEAR_P          (tms9900.ST & ~(ST_OP))
+#define STATUS_CLEAR_CO         (tms9900.ST & ~(ST_C | ST_OV))
+#define STATUS_CLEAR_OP         (tms9900.ST & ~(ST_OV | ST_OP))
+#define STATUS_CLEAR_COP        (tms9900.ST & ~(ST_C | ST_OV | ST_OP))
+
+// ---------------------------------------------------------------------------------------------------
+// Lazy status. Almost every instruction sets LGT/AGT/EQ from its result but most of the time the next
+// instruction overwrites them before anything looks. So the handlers just note the result and we work
+// out the three bits only when a jump, STST, COC/CZC/TB or a context switch needs them - or when the
+// CPU core returns so everyone else always sees a complete tms9900.ST. A byte result is kept sign
+// extended which gives the same three bits. Carry, overflow and parity are still set right away.
+// Anything that sets all three bits directly in tms9900.ST (compares, RTWP) just clears statusLazy.
+// ---------------------------------------------------------------------------------------------------
+extern MACHINE_LOCAL u16 statusResult;
+extern MACHINE_LOCAL u8  statusLazy;
+
+#define STATUS_LAZY16(x)        do {statusResult = (x); statusLazy = 1;} while (0)
+#define STATUS_LAZY8(x)         do {statusResult = (u16)(s16)(s8)(x); statusLazy = 1;} while (0)
+#define STATUS_SYNC()                                                                                               \
+    do                                                                                                              \
+    {                                                                                                               \
+        if (statusLazy)                                                                                             \
+        {                                                                                                           \
+            tms9900.ST = STATUS_CLEAR_LAE | (statusResult ? (((s16)statusResult > 0) ? (ST_LGT|ST_AGT) : ST_LGT) : ST_EQ); \
+            statusLazy = 0;                                                                                         \
+        }                                                                                                           \
+    } while (0)
 
 // --------------------------------------------------------------------------------------------------
 // The accurate emulation flags.... either of these will put the emulator into a more accurate mode
 // but it will come at the cost of some slowdown... mostly of relevance to the old DS hardware.
+// The TIMER and SAMS flags are no longer set (the timer is an event and SAMS is in the page table)
+// but older save states may still have them so they keep their values - TI99LoadState() drops them.
 // --------------------------------------------------------------------------------------------------
 #define ACCURATE_EMU_IDLE       0x01
 #define ACCURATE_EMU_TIMER      0x02
 #define ACCURATE_EMU_SAMS       0x04
 
+#define ACCURATE_UNUSED_FRAMES  120     // Frames without an IDLE before we drop back to the fast core
+
 // --------------------------------------------------------
 // Interrupt Masks... we only handle VDP and Timer
 // --------------------------------------------------------
@@ -240,6 +455,7 @@ enum _MEM_TYPE
 };
 
 extern void TMS9900_Reset(void);
+extern void TMS9900_buildopcodes(void);
 extern void TMS9900_Run(void);
 extern void TMS9900_RunAccurate(void);
 extern void TMS9900_Kickoff(void);
@@ -247,6 +463,12 @@ extern void TMS9900_RaiseInterrupt(u16 iMask);
 extern void TMS9900_ClearInterrupt(u16 iMask);
 extern void TMS9900_SetAccurateEmulationFlag(u16 flag);
 extern void TMS9900_ClearAccurateEmulationFlag(u16 flag);
+extern void TMS9900_CheckAccurateUsage(void);
+extern void TMS9900_FlushBlockCache(void);
+extern void TMS9900_BlockCodeWrite(u16 address);
+extern void TMS9900_SAMSBankChanged(void);
+extern void TMS9900_ScheduleEvent(u8 event, u32 cycle);
+extern void TMS9900_CancelEvent(u8 event);
 extern u32  SAMS_Read32(u32 address);
 extern void SAMS_Write32(u32 address, u32 data);
 extern void SAMS_MapDSR(u8 dataBit);
@@ -76,7 +76,7 @@ u16 CRU_AliasTable[] = {0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,
 // so that it's as fast as possible. We will also try to put as much of the CRU logic into the
 // .ITCM fast instruction memory to speed up that processing to help the poor DS CPU along...
 // --------------------------------------------------------------------------------------------
-TMS9901 tms9901      __attribute__((section(".dtcm")));
+MACHINE_DTCM  TMS9901 tms9901;
 
 
 // --------------------------------------------------------------------
@@ -92,9 +92,48 @@ void TMS9901_Reset(void)
     // -------------------------------------------------------------------------------------------------------------------
     tms9901.PinState[PIN_TIMER_OR_IO]  =  IO_MODE;
 
+    TMS9900_CancelEvent(EVENT_TIMER);
     TMS9900_ClearInterrupt(0xFFFF);
 }
 
+// ------------------------------------------------------------------------------------------------------------
+// The 9901 timer decrements once every 64 CPU clocks but only while we are in IO mode. Rather than count it
+// down as we go, we work out the CPU cycle at which it will hit zero and schedule an event for that cycle.
+// The CPU then runs flat out until the timer actually expires and TMS9901_TimerEvent() takes it from there.
+// ------------------------------------------------------------------------------------------------------------
+void TMS9901_ScheduleTimer(void)
+{
+    TMS9900_CancelEvent(EVENT_TIMER);
+
+    if (tms9901.TimerCounter && (tms9901.PinState[PIN_TIMER_OR_IO] == IO_MODE))   // Timer only runs when we are in IO Mode
+    {
+        TMS9900_ScheduleEvent(EVENT_TIMER, tms9900.cycles + (tms9901.TimerCounter * 64));
+    }
+}
+
+// ------------------------------------------------------------------------------------------------------------
+// While the timer is running the TimerCounter is stale - this brings it up to date from the scheduled event.
+// Called when we drop back into timer mode (where the count can be read back) and before a save state.
+// ------------------------------------------------------------------------------------------------------------
+void TMS9901_UpdateTimer(void)
+{
+    if (eventActive & (1 << EVENT_TIMER))
+    {
+        s32 remaining = (s32)(eventCycle[EVENT_TIMER] - tms9900.cycles);
+        tms9901.TimerCounter = (remaining > 0) ? ((remaining + 63) / 64) : 0;
+    }
+}
+
+// ------------------------------------------------------------------------------------------------------------
+// The timer has counted down to zero... possibly raise the interrupt and reload the timer to go again.
+// ------------------------------------------------------------------------------------------------------------
+void TMS9901_TimerEvent(void)
+{
+    TMS9901_RaiseTimerInterrupt();
+    tms9901.TimerCounter = tms9901.TimerStart;
+    TMS9901_ScheduleTimer();
+}
+
 // -----------------------------------------------------------------------------------------
 // Write up to 16 bits of information to the CRU. This routine handles the data shifting
 // as needed to clock out one or more bits (up to the full 16 bits) to the CRU. The CPU
@@ -156,12 +195,23 @@ ITCM_CODE void TMS9901_WriteCRU(u16 cruAddress, u16 data, u8 num)
             u8 cruA = cruAddress & 0x1F; // Map down to 32 bits...
 
             // -------------------------------------------------------------------------------------------------
-            // Bit 0 is special as it defines if we are in Timer or I/O mode... We don't yet handle timer
-            // mode but it's only used for Cassette IO which is not currently supported but we track it still.
+            // Bit 0 is special as it defines if we are in Timer or I/O mode... The timer only counts down
+            // in IO mode so we freeze the count going into timer mode (where it can be read back) and
+            // schedule the expiry again once we are back out in IO mode.
             // -------------------------------------------------------------------------------------------------
             if (cruA == PIN_TIMER_OR_IO)
             {
-                tms9901.PinState[PIN_TIMER_OR_IO] = (dataBit ? TIMER_MODE : IO_MODE);
+                if (dataBit)
+                {
+                    TMS9901_UpdateTimer();
+                    TMS9900_CancelEvent(EVENT_TIMER);
+                    tms9901.PinState[PIN_TIMER_OR_IO] = TIMER_MODE;
+                }
+                else
+                {
+                    tms9901.PinState[PIN_TIMER_OR_IO] = IO_MODE;
+                    TMS9901_ScheduleTimer();
+                }
             }
             else
             if (tms9901.PinState[PIN_TIMER_OR_IO] == TIMER_MODE)
@@ -184,11 +234,11 @@ ITCM_CODE void TMS9901_WriteCRU(u16 cruAddress, u16 data, u8 num)
                     else tms9901.TimerStart &= ~(1 << (cruA-1));
                     tms9901.TimerStart &= 0x3FFF;                           // 14 bits of Timer
                     tms9901.TimerCounter = tms9901.TimerStart;              // Timer will countdown only in IO mode
-                    TMS9900_SetAccurateEmulationFlag(ACCURATE_EMU_TIMER);   // Force timer to be dealt with...
                 }
                 else if (cruA > 15)
                 {
                     tms9901.PinState[PIN_TIMER_OR_IO] = IO_MODE;        // Writes to pin 16 or more result in exit back to IO mode
+                    TMS9901_ScheduleTimer();
                 }
             }
             else    // We're in I/O Mode
@@ -15,6 +15,7 @@
 
 #include <nds.h>
 #include <string.h>
+#include "../../DS99.h"
 
 enum KEYS
 {
@@ -64,10 +65,10 @@ typedef struct _TMS9901
     u8      VDPIntteruptInProcess;      // Set to '1' if the VDP interrupt is in process
     u8      TimerIntteruptInProcess;    // Set to '1' if the Timer interrupt is in process
     u32     TimerStart;                 // The Starting value
-    u32     TimerCounter;               // The 14-bit Timer Counter 
+    u32     TimerCounter;               // The 14-bit Timer Counter (only brought up to date by TMS9901_UpdateTimer() while it runs)
 } TMS9901;
 
-extern TMS9901 tms9901;
+extern MACHINE_LOCAL TMS9901 tms9901;
 
 extern void     TMS9901_Reset(void);
 extern void     TMS9901_WriteCRU(u16 cruAddress, u16 data, u8 num);
@@ -77,5 +78,8 @@ extern void     TMS9901_RaiseVDPInterrupt(void);
 extern void     TMS9901_ClearVDPInterrupt(void);
 extern void     TMS9901_RaiseTimerInterrupt(void);
 extern void     TMS9901_ClearTimerInterrupt(void);
+extern void     TMS9901_ScheduleTimer(void);
+extern void     TMS9901_UpdateTimer(void);
+extern void     TMS9901_TimerEvent(void);
 
 #endif //TMS9901_H_
@@ -45,6 +45,7 @@
 #include <nds.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 
 #include "../../DS99.h"
 #include "../../DS99_utils.h"
@@ -52,20 +53,41 @@
 
 u8 MaxSprites[2] __attribute__((section(".dtcm"))) = {4, 32};     // Normally the TMS9918a only shows 4 sprites on a line... for emulation we bump this up if configured
 
-u16 *pVidFlipBuf __attribute__((section(".dtcm"))) = (u16*) (0x06000000);    // Video flipping buffer
-
-u8 XBuf_A[256*192] ALIGN(32) = {0}; // Screen is 256x192. Ping Pong Buffer A
-u8 XBuf_B[256*192] ALIGN(32) = {0}; // Screen is 256x192. Ping Pong Buffer B
-u8 *XBuf __attribute__((section(".dtcm"))) = XBuf_A;
-
-u32 lutTablehh[256][16];    // Look up table for colors - pre-generated for maximum speed!
-u32 fastBackgroundLut[256] __attribute__((section(".dtcm"))); // For when the color is background - happens often enough
-
-u8 OH __attribute__((section(".dtcm"))) = 0;
-u8 IH __attribute__((section(".dtcm"))) = 0;
-
-u8 scan_collisions_every __attribute__((section(".dtcm"))) = 32;
-u8 CollisionCheckEvery[] = {255, 4, 8, 16, 32, 64, 255};
+MACHINE_DTCM  u16 *pVidFlipBuf = (u16*) (0x06000000);  // Video flipping buffer
+
+MACHINE_LOCAL u8 XBuf_A[256*192] ALIGN(32) = {0}; // Screen is 256x192. Ping Pong Buffer A
+MACHINE_LOCAL u8 XBuf_B[256*192] ALIGN(32) = {0}; // Screen is 256x192. Ping Pong Buffer B
+MACHINE_DTCM  u8 *XBuf;        // Points at XBuf_A or XBuf_B - ResetTI() starts it off at XBuf_A
+
+// -----------------------------------------------------------------------------------------------
+// Our background/foreground color table makes computations FAST! Indexed by the (FG<<4 | BG)
+// color byte and then four pattern bits - each pattern bit picks the FG or BG color for one
+// of the four pixels (the high bit is the leftmost pixel in the lowest byte). Generated at
+// compile time (see TABLE_256() in DS99.h) rather than rebuilt on every VDP reset.
+// -----------------------------------------------------------------------------------------------
+#define LUT_PIXEL(c, k, n)  ((u32)((((k) >> (3-(n))) & 1) ? ((c) >> 4) : ((c) & 0x0F)) << ((n)*8))
+#define LUT_ENTRY(c, k)     (LUT_PIXEL(c, k, 0) | LUT_PIXEL(c, k, 1) | LUT_PIXEL(c, k, 2) | LUT_PIXEL(c, k, 3))
+#define LUT_ROW(c)          {LUT_ENTRY(c, 0),  LUT_ENTRY(c, 1),  LUT_ENTRY(c, 2),  LUT_ENTRY(c, 3),  \
+                             LUT_ENTRY(c, 4),  LUT_ENTRY(c, 5),  LUT_ENTRY(c, 6),  LUT_ENTRY(c, 7),  \
+                             LUT_ENTRY(c, 8),  LUT_ENTRY(c, 9),  LUT_ENTRY(c, 10), LUT_ENTRY(c, 11), \
+                             LUT_ENTRY(c, 12), LUT_ENTRY(c, 13), LUT_ENTRY(c, 14), LUT_ENTRY(c, 15)}
+#define LUT_BACKGROUND(c)   ((u32)((c) & 0x0F) * 0x01010101)
+
+u32 lutTablehh[256][16] = {TABLE_256(LUT_ROW, 0)};    // Look up table for colors - pre-generated for maximum speed!
+u32 fastBackgroundLut[256] __attribute__((section(".dtcm"))) = {TABLE_256(LUT_BACKGROUND, 0)}; // For when the color is background - happens often enough
+
+MACHINE_DTCM  u8 OH = 0;
+MACHINE_DTCM  u8 IH = 0;
+
+// -----------------------------------------------------------------------------------------------
+// Sprite pattern bits doubled up for magnified sprites - each bit of the byte becomes two side
+// by side bits of the u16 so one pattern line expands to the pixels it covers on screen.
+// -----------------------------------------------------------------------------------------------
+#define SPR_DBL_BIT(b, n)   ((u16)(((b) >> (n)) & 1) * (3 << ((n)*2)))
+#define SPR_DOUBLE(b)       (SPR_DBL_BIT(b,0) | SPR_DBL_BIT(b,1) | SPR_DBL_BIT(b,2) | SPR_DBL_BIT(b,3) | \
+                             SPR_DBL_BIT(b,4) | SPR_DBL_BIT(b,5) | SPR_DBL_BIT(b,6) | SPR_DBL_BIT(b,7))
+
+u16 SprDouble[256] = {TABLE_256(SPR_DOUBLE, 0)};
 
 // ---------------------------------------------------------------------------------------
 // Screen handlers and masks for VDP table address registers.
@@ -82,7 +104,7 @@ tScrMode SCR[MAXSCREEN+1] __attribute__((section(".dtcm")))  = {
   { RefreshLine3,0x7F,0x00,0x3F,0xFF,0x3F,0x00,0x00,0x00,0x00 }, /* VDP Mode 2 aka MSX SCREEN 3 aka "MULTICOLOR" */
 };
 
-void (*RefreshLine)(u8 uY) __attribute__((section(".dtcm"))) = RefreshLine0;
+MACHINE_DTCM  void (*RefreshLine)(u8 uY) = RefreshLine0;
 
 /** Palette9918[] ********************************************/
 /** 16 standard colors used by TMS9918/TMS9928 VDP chips.   **/
@@ -94,121 +116,310 @@ u8 TMS9918A_palette[16*3] __attribute__((section(".dtcm")))  = {
   0x20,0x80,0x20,   0xC0,0x40,0xA0,   0xA0,0xA0,0xA0,   0xE0,0xE0,0xE0,
 };
 
-u8 pVDPVidMem[0x4000] ALIGN(32) ={0};                   // VDP video memory... 16K
-
-u16 CurLine     __attribute__((section(".dtcm")));      // Current scanline
-u8 VDP[16]      __attribute__((section(".dtcm")));      // VDP Registers
-u8 VDPStatus    __attribute__((section(".dtcm")));      // VDP Status
-u8 VDPDlatch    __attribute__((section(".dtcm")));      // VDP register D Latch
-u16 VAddr       __attribute__((section(".dtcm")));      // VDP Video Address
-u8 VDPCtrlLatch __attribute__((section(".dtcm")));      // VDP control latch key
-u8 *ChrGen      __attribute__((section(".dtcm")));      // VDP tables (screens)
-u8 *ChrTab      __attribute__((section(".dtcm")));      // VDP tables (screens)
-u8 *ColTab      __attribute__((section(".dtcm")));      // VDP tables (screens)
-u8 *SprGen      __attribute__((section(".dtcm")));      // VDP tables (sprites)
-u8 *SprTab      __attribute__((section(".dtcm")));      // VDP tables (sprites)
-u8 ScrMode      __attribute__((section(".dtcm")));      // Current screen mode
-u8 FGColor      __attribute__((section(".dtcm")));      // Foreground Color
-u8 BGColor      __attribute__((section(".dtcm")));      // Background Color
+MACHINE_LOCAL u8 pVDPVidMem[0x4000] ALIGN(32) ={0};                   // VDP video memory... 16K
+
+MACHINE_DTCM  u16 CurLine;          // Current scanline
+MACHINE_DTCM  u8 VDP[16];           // VDP Registers
+MACHINE_DTCM  u8 VDPStatus;         // VDP Status
+MACHINE_DTCM  u8 VDPDlatch;         // VDP register D Latch
+MACHINE_DTCM  u16 VAddr;            // VDP Video Address
+MACHINE_DTCM  u8 VDPCtrlLatch;      // VDP control latch key
+MACHINE_DTCM  u8 *ChrGen;           // VDP tables (screens)
+MACHINE_DTCM  u8 *ChrTab;           // VDP tables (screens)
+MACHINE_DTCM  u8 *ColTab;           // VDP tables (screens)
+MACHINE_DTCM  u8 *SprGen;           // VDP tables (sprites)
+MACHINE_DTCM  u8 *SprTab;           // VDP tables (sprites)
+MACHINE_DTCM  u8 ScrMode;           // Current screen mode
+MACHINE_DTCM  u8 FGColor;           // Foreground Color
+MACHINE_DTCM  u8 BGColor;           // Background Color
 
 // Sprite and Character Masks for the VDP
-u16 ChrTabM     __attribute__((section(".dtcm"))) = 0x3FFF;
-u16 ColTabM     __attribute__((section(".dtcm"))) = 0x3FFF;
-u16 ChrGenM     __attribute__((section(".dtcm"))) = 0x3FFF;
-u16 SprTabM     __attribute__((section(".dtcm"))) = 0x3FFF;
-
-
-/** CheckSprites() ***********************************************/
-/** This function is periodically called to check for sprite    **/
-/** collisions. The caller of this will set the flag as needed. **/
-/** Returning zero (0) means no collision. Otherwise collision. **/
-/*****************************************************************/
-ITCM_CODE byte CheckSprites(void)
+MACHINE_DTCM  u16 ChrTabM = 0x3FFF;
+MACHINE_DTCM  u16 ColTabM = 0x3FFF;
+MACHINE_DTCM  u16 ChrGenM = 0x3FFF;
+MACHINE_DTCM  u16 SprTabM = 0x3FFF;
+
+// ---------------------------------------------------------------------------------------
+// Scanline dirty tracking. Most frames on most games only change a handful of lines (if
+// any) so rather than draw all 192 lines every frame we keep track of which lines might
+// look different from the last time they were drawn and only draw those again:
+//
+//   VDPBlockRows[]  - for each 64 byte block of VRAM, the character rows of the screen
+//                     (bit 0 = lines 0-7 ... bit 23 = lines 184-191) drawn from that block.
+//                     Rebuilt by Invalidate9918() whenever the VDP tables move around.
+//   VDPDirtyRows    - character rows fed by a VRAM block written since we last looked.
+//   VDPLineDirty[]  - one bit per scanline (a byte per character row) - lines to redraw.
+//
+// A register change that alters what is on screen (mode, table addresses, colors...)
+// simply marks every line dirty. Sprites move around far too often to have the sprite
+// attribute table feed every row - instead each line remembers which sprites were on it
+// when it was last drawn and is drawn again only if that changed or one of those sprites
+// was written since (see SpriteLineChanged()). Lines that are not drawn still have their
+// sprites scanned so the 5th sprite status is exactly as it would have been.
+// ---------------------------------------------------------------------------------------
+MACHINE_LOCAL u32 VDPBlockRows[0x4000>>6];  // Which character rows each 64 byte block of VRAM feeds
+MACHINE_DTCM  u32 VDPDirtyRows = 0;         // Character rows touched by a VRAM write since we last looked
+MACHINE_DTCM  u8  VDPLineDirty[24];         // One bit per scanline that must be drawn again
+MACHINE_DTCM  u8  VDPFrameDirty = 1;        // Set if any line was drawn since the last screen update
+MACHINE_DTCM  u8  SprLinesDirty = 1;        // Set if the per-line sprite lists must be rebuilt (see ScanSprites())
+MACHINE_DTCM  u32 SprWritten = 0;           // Sprites with an attribute written since the start of this frame
+MACHINE_DTCM  u32 SprWrittenLast = 0;       // ... and those written during the frame before
+
+#define ALL_ROWS    0x00FFFFFF              // All 24 character rows
+
+// ---------------------------------------------------------------------------------------
+// The span cache for GRAPHIC 1 and GRAPHIC 2 - each 8 pixel wide slice of a character
+// (one pattern byte in its colors) pre-expanded into the two words RefreshLine1/2 store
+// to the screen buffer. It is keyed the same way the VDP looks up the bitmap mode tables:
+// (third of screen << 11) | (character << 3) | (pixel row) - in GRAPHIC 1 there is only the
+// one third. A span is built the first time it is drawn and stays good until a write to
+// the pattern or color byte it was built from (see SpanWrite9918()) or the tables move.
+// ---------------------------------------------------------------------------------------
+#define SPAN_KEYS   0x2000
+
+MACHINE_LOCAL u32 SpanCache[SPAN_KEYS][2] ALIGN(32);   // The 8 pixels of each span as two words
+MACHINE_LOCAL u32 SpanValid[SPAN_KEYS/32];             // One bit per span - set once built
+
+#define SPAN_IS_VALID(key)      (SpanValid[(key)>>5] & (1u<<((key)&31)))
+#define SPAN_INVALIDATE(key)    SpanValid[(key)>>5] &= ~(1u<<((key)&31))
+
+// Flag every block in the given range of VRAM as feeding the given character rows
+static void VDP_MapBlocks(u16 addr, u16 len, u32 rows)
 {
-  unsigned int I,J,LS,LD;
-  byte *S,*D,*PS,*PD,*T;
-  int DH,DV;
+    for (u16 block = (addr>>6); block <= ((addr+len-1)>>6) && (block < (0x4000>>6)); block++)
+    {
+        VDPBlockRows[block] |= rows;
+    }
+}
 
-  /* Find valid, displayed sprites */
-  DV = TMS9918_Sprites16 ? -16:-8;
-  for(I=J=0,S=SprTab;(I<32)&&(S[0]!=208);++I,S+=4)
-  {
-    if(((S[0]<191)||(S[0]>255+DV))&&((int)S[1]-(S[3]&0x80? 32:0)>DV))  J|=1<<I;
-  }
+// ---------------------------------------------------------------------------------------
+// The VDP tables have moved (or the mode changed or VRAM was reloaded wholesale) - work
+// out again which rows each block of VRAM feeds and mark the entire screen to be drawn.
+// ---------------------------------------------------------------------------------------
+void Invalidate9918(void)
+{
+    u16 chrTab = ChrTab - pVDPVidMem;
+    u16 colTab = ColTab - pVDPVidMem;
+    u16 chrGen = ChrGen - pVDPVidMem;
 
-  // ------------------------------------------------------------------
-  // Run through all displayed sprites and see if there is any overlap.
-  // This is a bit CPU intensive - we check vertical overlap first as
-  // it's a bit faster to see if these have any chance of collision.
-  // ------------------------------------------------------------------
-  if(TMS9918_Sprites16)
-  {
-    for(S=SprTab;J;J>>=1,S+=4)
-      if(J&1)
-        for(I=J>>1,D=S+4;I;I>>=1,D+=4)
-          if(I&1)
-          {
-            DV=(int)S[0]-(int)D[0]; // Check if these sprites might coincide vertically
-            if((DV<16)&&(DV>-16))
-            {
-              DH=(int)S[1]-(int)D[1]-(S[3]&0x80? 32:0)+(D[3]&0x80? 32:0);
-              if((DH<16)&&(DH>-16)) // Check if these sprites might coincide horizontally
-              {
-                PS=SprGen+((int)(S[2]&0xFC)<<3);
-                PD=SprGen+((int)(D[2]&0xFC)<<3);
-                if(DV>0) PD+=DV; else { DV=-DV;PS+=DV; }
-                if(DH<0) { DH=-DH;T=PS;PS=PD;PD=T; }
-                while(DV<16)
-                {
-                  LS=((unsigned int)PS[0]<<8)+PS[16];
-                  LD=((unsigned int)PD[0]<<8)+PD[16];
-                  if(LD&(LS>>DH)) break;
-                  else { ++DV;++PS;++PD; }
-                }
-                if(DV<16) return(1);
-              }
-            }
-          }
-  }
-  else
-  {
-    for(S=SprTab;J;J>>=1,S+=4)
-      if(J&1)
-        for(I=J>>1,D=S+4;I;I>>=1,D+=4)
-          if(I&1)
-          {
-            DV=(int)S[0]-(int)D[0];
-            if((DV<8)&&(DV>-8))
-            {
-              DH=(int)S[1]-(int)D[1]-(S[3]&0x80? 32:0)+(D[3]&0x80? 32:0);
-              if((DH<8)&&(DH>-8))
-              {
-                PS=SprGen+((int)S[2]<<3);
-                PD=SprGen+((int)D[2]<<3);
-                if(DV>0) PD+=DV; else { DV=-DV;PS+=DV; }
-                if(DH<0) { DH=-DH;T=PS;PS=PD;PD=T; }
-                while((DV<8)&&!(*PD&(*PS>>DH))) { ++DV;++PS;++PD; }
-                if(DV<8) return(1);
-              }
-            }
-          }
-  }
+    memset(VDPBlockRows, 0x00, sizeof(VDPBlockRows));
+
+    // Each character row reads its own run of the name table - 40 names in TEXT mode and 32 otherwise
+    u16 rowLen = (ScrMode == 0) ? 40:32;
+    for (u8 row=0; row<24; row++)
+    {
+        VDP_MapBlocks(chrTab + row*rowLen, rowLen, 1<<row);
+    }
+
+    if (ScrMode == 2)
+    {
+        // Bitmap mode - each third of the screen has its own patterns and colors (subject to the table masks)
+        for (u16 offset=0; offset<0x2000; offset += 64)
+        {
+            u32 rows = 0xFF << ((offset>>11)*8);
+            VDP_MapBlocks(chrGen + (offset & ChrGenM), 64, rows | VDP_BLOCK_SPANS);
+            VDP_MapBlocks(colTab + (offset & ColTabM), 64, rows | VDP_BLOCK_SPANS);
+        }
+    }
+    else if (ScrMode == 1)
+    {
+        // Any pattern (and color) can show up on any row
+        VDP_MapBlocks(chrGen, 0x800, ALL_ROWS | VDP_BLOCK_SPANS);
+        VDP_MapBlocks(colTab, 32, ALL_ROWS | VDP_BLOCK_SPANS);
+    }
+    else
+    {
+        VDP_MapBlocks(chrGen, 0x800, ALL_ROWS);
+    }
+
+    // Sprites can be anywhere - there are no sprites in TEXT mode. The attribute table doesn't feed any
+    // rows of its own - the per-line sprite lists work out which lines a sprite write touches.
+    if (ScrMode != 0)
+    {
+        VDP_MapBlocks(SprTab - pVDPVidMem, 128, VDP_BLOCK_SPRITES);
+        VDP_MapBlocks(SprGen - pVDPVidMem, 0x800, ALL_ROWS);
+    }
+
+    memset(VDPLineDirty, 0xFF, sizeof(VDPLineDirty));
+    VDPDirtyRows = 0;
+
+    memset(SpanValid, 0x00, sizeof(SpanValid));     // The spans are keyed by table offset - start them over
+    SprLinesDirty = 1;                              // The sprite table may have moved or the sprites changed size
+}
+
+// ---------------------------------------------------------------------------------------
+// VRAM was written other than through the data port (e.g. a disk sector read by DMA)
+// ---------------------------------------------------------------------------------------
+void Dirty9918(u16 addr, u16 len)
+{
+    for (u32 i=0; i<len; i++)
+    {
+        VDPWrote9918((addr+i)&0x3FFF);
+    }
+}
 
-  /* No collision */
-  return(0);
+// Drop every span built from this byte of a bitmap mode table - with the table masks in
+// play more than one span can be fed from the same byte (up to 128 for the color table)
+static void SpanInvalidateMasked(u16 offset, u16 mask)
+{
+    if (offset >= SPAN_KEYS) return;                // Not in this table
+    u16 unmasked = ~mask & (SPAN_KEYS-1);           // Key bits the table mask throws away
+    if (offset & unmasked) return;                  // The VDP never looks at this byte through the mask
+
+    u16 bits = unmasked;
+    for (;;)
+    {
+        SPAN_INVALIDATE(offset | bits);
+        if (!bits) break;
+        bits = (bits-1) & unmasked;
+    }
+}
+
+// A VRAM byte that feeds the span cache was written - forget the spans built from it
+ITCM_CODE void SpanWrite9918(u16 addr)
+{
+    u16 chrGen = ChrGen - pVDPVidMem;
+    u16 colTab = ColTab - pVDPVidMem;
+
+    if (ScrMode == 1)
+    {
+        if ((u16)(addr - chrGen) < 0x800) SPAN_INVALIDATE(addr - chrGen);
+        if ((u16)(addr - colTab) < 32)          // One color byte covers 8 characters - all 64 of their spans
+        {
+            SpanValid[((addr - colTab)<<6)>>5]     = 0;
+            SpanValid[(((addr - colTab)<<6)>>5)+1] = 0;
+        }
+    }
+    else
+    {
+        SpanInvalidateMasked(addr - chrGen, ChrGenM);
+        SpanInvalidateMasked(addr - colTab, ColTabM);
+    }
 }
 
 
+// ---------------------------------------------------------------------------------------
+// Per-line sprite lists - rather than walk the sprite attribute table on every one of the
+// 192 lines, each line keeps a mask of all the sprites (ahead of the Y=208 terminator)
+// that cover it. The lists are rebuilt the first time a line is scanned after a sprite Y
+// coordinate is written (see VDPWrote9918()) or the table moves or the sprite size changes.
+// ---------------------------------------------------------------------------------------
+MACHINE_LOCAL u32 SprLineMask[192];         // Bit N set if sprite N covers this line
+MACHINE_LOCAL u32 SprLineDrawn[192];        // The SprLineMask[] of this line when it was last drawn
+MACHINE_DTCM  u8  SprLastScanned = 31;      // The sprite with Y==208 that ends the table or else sprite 31
+
+static void BuildSpriteLines(void)
+{
+    byte *AT = SprTab;
+    s16 K, first, last;
+
+    memset(SprLineMask, 0x00, sizeof(SprLineMask));
+    SprLastScanned = 31;
+
+    for (u8 sprite=0; sprite<32; ++sprite, AT+=4)
+    {
+        K=AT[0];                                        // K = sprite Y coordinate
+        if(K==208) {SprLastScanned=sprite; break;}      // Iteration terminates if Y=208 and we save the last scanned sprite
+        if(K>256-IH) K-=256;                            // Y coordinate may be negative
+
+        // The sprite covers lines K+1 to K+OH - see ScanSprites() for why it's off by one
+        first = K+1;  if (first < 0)  first = 0;
+        last  = K+OH; if (last > 191) last = 191;
+        for (s16 Y=first; Y<=last; Y++)
+        {
+            SprLineMask[Y] |= (1u<<sprite);
+        }
+    }
+
+    SprLinesDirty = 0;
+}
+
+// ---------------------------------------------------------------------------------------
+// Sprite collision - just like the real VDP we lay the pixels of the sprites on this line
+// down one at a time into an occupancy mask for the line and if a sprite lands a pixel on
+// one already taken we have a collision. Sprite color plays no part (transparent sprites
+// collide too) and pixels off the left or right edge of the screen never collide. The mask
+// is 320 bits with pixel X at bit X+32 (MSB first) so sprites hanging off the left fit.
+// ---------------------------------------------------------------------------------------
+static ITCM_CODE void CollideSprites(byte Y, u32 M)
+{
+    u32 occ[10] = {0};
+    byte *AT[4], *PT;
+    int X[4], K, n=0;
+    u8 near = 0;
+    u32 bits, hi, lo;
+    u16 pos;
+
+    if (!(M & (M-1))) return;   // It takes two to collide
+
+    // Find where the (at most four) sprites sit on the line - skip any entirely off screen
+    for ( ; M; M &= M-1)
+    {
+        AT[n] = SprTab + (__builtin_ctz(M)<<2);
+        X[n]  = AT[n][3]&0x80? AT[n][1]-32:AT[n][1];    // Sprite may be shifted left by 32
+        if ((X[n]<256) && (X[n]>-OH)) n++;
+    }
+
+    // Sprites that are not within a sprite width of each other can't possibly touch - the common case
+    for (int i=0; i<n; i++)
+        for (int j=i+1; j<n; j++)
+            if (abs(X[i]-X[j]) < OH) near = 1;
+    if (!near) return;
+
+    for (int i=0; i<n; i++)
+    {
+        K  = AT[i][0];                      // K = sprite Y coordinate
+        if(K>256-IH) K-=256;                // Y coordinate may be negative
+        K  = Y-K-1;
+        PT = SprGen
+           + ((int)(IH>8? (AT[i][2]&0xFC):AT[i][2])<<3)
+           + (OH>IH? (K>>1):K);
+
+        // The pixels this sprite covers on the line - leftmost in the MSB
+        bits = ((u32)PT[0]<<8) | (IH>8? PT[16]:0x00);
+        bits = (OH>IH) ? (((u32)SprDouble[bits>>8]<<16) | SprDouble[bits&0xFF]) : (bits<<16);
+
+        pos = X[i]+32;
+        hi  = bits >> (pos&31);
+        lo  = (pos&31) ? (bits << (32-(pos&31))) : 0;
+        if ((pos>>5) == 0) hi = 0;          // Off the left edge
+        if ((pos>>5) == 8) lo = 0;          // Off the right edge
+
+        if ((occ[pos>>5] & hi) | (occ[(pos>>5)+1] & lo))
+        {
+            VDPStatus |= TMS9918_STAT_OVRLAP;   // Set the collision bit
+            return;
+        }
+        occ[pos>>5]     |= hi;
+        occ[(pos>>5)+1] |= lo;
+    }
+}
+
+// ---------------------------------------------------------------------------------------
+// Does this line need drawing again for its sprites? It does if a sprite has come onto or
+// gone off the line (moved, resized or cut off by a new Y=208 terminator) or a sprite that
+// is or was on the line had its position, pattern or color written since the line was last
+// drawn. Lines are drawn once a frame so anything written this frame or last will do.
+// ---------------------------------------------------------------------------------------
+static ITCM_CODE u8 SpriteLineChanged(byte Y)
+{
+    if(!ScrMode || !TMS9918_ScreenON) return 0;     // No sprites drawn - turning them on redraws everything
+
+    if (SprLinesDirty) BuildSpriteLines();
+
+    u32 now = SprLineMask[Y], was = SprLineDrawn[Y];
+    return (now != was) || ((now | was) & (SprWritten | SprWrittenLast));
+}
+
 /** ScanSprites() ********************************************/
 /** Compute bitmask of sprites shown in a given scanline.   **/
-/** Returns the last sprite to be scanned or -1 if none.    **/
-/** Also updates 5th sprite fields in the status register.  **/
+/** Returns the highest sprite shown or -1 if none.         **/
+/** Also updates 5th sprite fields in the status register   **/
+/** and sets the collision bit if two sprites overlap.      **/
 /*************************************************************/
 ITCM_CODE int ScanSprites(byte Y, unsigned int *Mask)
 {
-    byte *AT;
-    u8 sprite,MS,S5;
-    s16 K;
+    u32 shown, past4;
 
     // Assume no sprites shown - we OR in a '1' for each visible sprite
     *Mask = 0x00000000;
@@ -219,43 +430,30 @@ ITCM_CODE int ScanSprites(byte Y, unsigned int *Mask)
         return(-1);
     }
 
-    s16 fifth_sprite_num =-1;                   // Used to detect the 5th sprite on a line
-    AT = SprTab;                                // Pointer to the sprite table in VDP memory
-    MS = MaxSprites[myConfig.maxSprites]+1;     // We either render 4 sprites (normal - this is how an 9918 would work) or 32 sprites (enhanded mode for emulation only)
-    S5 = 5;                                     // We always want to trap on the 5th sprite
-    u8 last = 31;                               // The last sprite number is 31 but we may break early if Y==208
+    if (SprLinesDirty) BuildSpriteLines();
 
-    // ------------------------------------------------------------------
-    // Scan through all possible 32 sprites to see what's being shown...
-    // ------------------------------------------------------------------
-    for(sprite=0;sprite<32;++sprite,AT+=4)
-    {
-        K=AT[0];                            // K = sprite Y coordinate
-        if(K==208) {last=sprite; break;}    // Iteration terminates if Y=208 and we save the last scanned sprite
-        if(K>256-IH) K-=256;                // Y coordinate may be negative
+    // -------------------------------------------------------------------------------------------
+    // A sprite is on this line if Y is one of the OH lines after its Y coordinate (see the notes
+    // below) - the per-line mask has them all in priority order. At first this looked wrong as
+    // if it was off by 1 for comparing the Y (scanline) number with the sprite Y coordinate but
+    // the Y position is tricky. A coordinate of 0 means draw at the first pixel line (one below
+    // the top-most pixel line of the screen). A 255 means draw at the 0th top-most pixel line
+    // of the screen. Y positions below 255 but above 208 are negative indexes which allow for
+    // the sprite to be positioned partially cropped at the top. Finally, the reason 208 was
+    // chosen by TI as the sentinal value is that it's 16 pixels below the lowest pixel row of
+    // 192 and the sprite would be completely off-screen. Tricky...
+    // -------------------------------------------------------------------------------------------
+    shown = SprLineMask[Y];
 
-        // -------------------------------------------------------------------------------------------
-        // Mark all valid sprites with 1s, break at MaxSprites. Track last scanned sprite for 5S num
-        // At first this looked wrong as if it was off by 1 for comparing the Y (scanline) number
-        // with the sprite Y coordinate but the Y position is tricky. A coordinate of 0 means draw
-        // at the first pixel line (one below the top-most pixel line of the screen). A 255 means
-        // draw at the 0th top-most pixel line of the screen. Y positions below 255 but above 208 are
-        // negative indexes which allow for the sprite to be positioned partially cropped at the top.
-        // Finally, the reason 208 was chosen by TI as the sentinal value is that it's 16 pixels below
-        // the lowest pixel row of 192 and the sprite would be completely off-screen. Tricky...
-        // -------------------------------------------------------------------------------------------
-        if((Y>K)&&(Y<=K+OH))
-        {
-            // If we exceed four sprites per line, set 5th sprite number
-            if(!--S5) fifth_sprite_num = sprite;
+    // Knock off the first four sprites - anything left is the 5th sprite onwards
+    past4 = shown;
+    for (u8 i=0; (i<4) && past4; i++) past4 &= past4-1;
 
-            // If we exceed maximum number of sprites per line, stop here
-            if(!--MS) break;
+    // The VDP only fetches the first four sprites on a line - those are the ones that can collide
+    if (!(VDPStatus & TMS9918_STAT_OVRLAP)) CollideSprites(Y, shown & ~past4);
 
-            // Mark sprite as ready to draw
-            *Mask |= (1<<sprite);
-        }
-    }
+    // We either render 4 sprites (normal - this is how an 9918 would work) or all 32 sprites (enhanded mode for emulation only)
+    if (MaxSprites[myConfig.maxSprites] == 4) shown &= ~past4;
 
     // ------------------------------------------------------------------------
     // The if a 5th  sprite was found on this line, we check to see if we've
@@ -264,20 +462,21 @@ ITCM_CODE int ScanSprites(byte Y, unsigned int *Mask)
     // ------------------------------------------------------------------------
     if ((VDPStatus & TMS9918_STAT_5THSPR) == 0) // If the 5S flag is not already latched
     {
-        if (fifth_sprite_num != -1) // If we have a 5th sprite number detected
+        if (past4) // If we have a 5th sprite number detected
         {
-            VDPStatus &= ~TMS9918_STAT_5THNUM;                      // Clear out any previous sprite number
-            VDPStatus |= (TMS9918_STAT_5THSPR | fifth_sprite_num);  // Set the 5th sprite flag and number
+            VDPStatus &= ~TMS9918_STAT_5THNUM;                                  // Clear out any previous sprite number
+            VDPStatus |= (TMS9918_STAT_5THSPR | __builtin_ctz(past4));          // Set the 5th sprite flag and number
         }
         else // This is undocumented behavior but a real VDP will behave like this and Miner 2049er will rely on it
         {
             VDPStatus &= ~TMS9918_STAT_5THNUM;      // Clear out any previous sprite number
-            VDPStatus |= last;                      // Set the 5th sprite number to the last scanned sprite on the line (the one with Y==208 or else sprite 31)
+            VDPStatus |= SprLastScanned;            // Set the 5th sprite number to the last scanned sprite on the line (the one with Y==208 or else sprite 31)
         }
     }
 
-  // Return last scanned sprite - the caller's Mask is also filled in with a list of all shown sprites
-  return(sprite-1);
+  // Return highest shown sprite - the caller's Mask is also filled in with a list of all shown sprites
+  *Mask = shown;
+  return(shown ? (31 - __builtin_clz(shown)) : -1);
 }
 
 
@@ -465,13 +664,11 @@ ITCM_CODE void RefreshLine0(u8 Y)
 /*************************************************************/
 ITCM_CODE void RefreshLine1(u8 uY)
 {
-  register byte K=0,Offset,BC;
+  register byte K,Offset,BC;
   register u8 *T;
   register u32 *P;
-  u8 lastT;
 
   P=(u32*) (XBuf+(uY<<8));
-  u32 ptLow = 0; u32 ptHigh = 0;
 
   if(!ScreenON)
     memset(P,BGColor,256);
@@ -480,21 +677,20 @@ ITCM_CODE void RefreshLine1(u8 uY)
     T=ChrTab+((int)(uY&0xF8)<<2);
     Offset=uY&0x07;
 
-    lastT = ~(*T);
-
     for(int X=0;X<32;X++)
     {
-      if (lastT != *T) // Is this set of pixels different than the last one?
+      u16 key = ((u16)T[X]<<3) | Offset;
+      u32 *span = SpanCache[key];
+      if (!SPAN_IS_VALID(key)) // First time we've drawn this one since it last changed - expand the pattern into its colors
       {
-          lastT=*T;
-          BC=ColTab[lastT>>3];
-          K=ChrGen[((int)lastT<<3)+Offset];
-          ptLow  = lutTablehh[BC][K>>4];
-          ptHigh = lutTablehh[BC][K&0xF];
+          BC = ColTab[key>>6];
+          K  = ChrGen[key];
+          span[0] = lutTablehh[BC][K>>4];
+          span[1] = lutTablehh[BC][K&0xF];
+          SpanValid[key>>5] |= (1u<<(key&31));
       }
-      *P++ = ptLow;
-      *P++ = ptHigh;
-      T++;
+      *P++ = span[0];
+      *P++ = span[1];
     }
     RefreshSprites(uY);
   }
@@ -516,33 +712,30 @@ ITCM_CODE void RefreshLine2(u8 uY)
     memset(P,BGColor,256);
   else
   {
-    u32 ptLow = 0; u32 ptHigh = 0;
-
     J   = ((u16)((u16)uY&0xC0)<<5)+(uY&0x07);
     T   = ChrTab+((u16)((u16)uY&0xF8)<<2);
-    u8 lastT = ~(*T);
 
     for(int X=0;X<32;X++)
     {
-      if (lastT != *T) // Is this set of pixels different than the last one?
+      I = J + ((u16)T[X]<<3);
+      u32 *span = SpanCache[I];
+      if (!SPAN_IS_VALID(I)) // First time we've drawn this one since it last changed - expand the pattern into its colors
       {
-          lastT = *T;
-          I     = (u16)lastT<<3;
-          BC    = ColTab[(J+I)&ColTabM];
-          K     = ChrGen[(J+I)&ChrGenM];
+          BC = ColTab[I&ColTabM];
+          K  = ChrGen[I&ChrGenM];
           if (K)
           {
-              ptLow  = lutTablehh[BC][K>>4];
-              ptHigh = lutTablehh[BC][K&0xF];
+              span[0] = lutTablehh[BC][K>>4];
+              span[1] = lutTablehh[BC][K&0xF];
           }
           else // It's all background
           {
-              ptLow = ptHigh = fastBackgroundLut[BC];
+              span[0] = span[1] = fastBackgroundLut[BC];
           }
+          SpanValid[I>>5] |= (1u<<(I&31));
       }
-      *P++ = ptLow;
-      *P++ = ptHigh;
-      T++;
+      *P++ = span[0];
+      *P++ = span[1];
     }
 
     RefreshSprites(uY);
@@ -601,6 +794,7 @@ ITCM_CODE void RefreshLine3(u8 uY)
  ********************************************************************************/
 u8 VDP_RegisterMasks[] __attribute__((section(".dtcm"))) = { 0x03, 0xfb, 0x0f, 0xff, 0x07, 0x7f, 0x07, 0xff };
 byte SprHeights[4] __attribute__((section(".dtcm"))) = { 8,16,16,32 };
+u8 VDP_RegisterDisplay[] __attribute__((section(".dtcm"))) = { 0x02, 0xdb, 0x0f, 0xff, 0x07, 0x7f, 0x07, 0xff };  // Less external video and the IRQ enable
 
 ITCM_CODE byte Write9918(u8 iReg, u8 value)
 {
@@ -618,6 +812,12 @@ ITCM_CODE byte Write9918(u8 iReg, u8 value)
   /* The TI99 is normally 16K but it's possible to use the VDP chip in 4K mode */
   VRAMMask = (iReg==1) && ((VDP[1]^value) & TMS9918_REG1_RAM16K) ? 0 : TMS9918_VRAMMask;  // Setting zero here forces re-computation of the VDP tables below
 
+  /* Remember what the screen is drawn from so we know if this write changes anything we see */
+  u8 bRedraw = ((VDP[iReg] ^ value) & VDP_RegisterDisplay[iReg]) != 0;
+  u8 oldMode = ScrMode, oldOH = OH, oldIH = IH;
+  u8 *oldChrTab = ChrTab, *oldColTab = ColTab, *oldChrGen = ChrGen, *oldSprTab = SprTab, *oldSprGen = SprGen;
+  u16 oldColTabM = ColTabM, oldChrGenM = ChrGenM;
+
   /* Store value into the register */
   VDP[iReg]=value;
   
@@ -703,6 +903,15 @@ ITCM_CODE byte Write9918(u8 iReg, u8 value)
       break;
   }
 
+  /* Writing the same value usually changes nothing - but not always (e.g. the first writes after a reset) */
+  if (!bRedraw)
+  {
+      bRedraw = (ScrMode != oldMode) || (OH != oldOH) || (IH != oldIH) ||
+                (ChrTab != oldChrTab) || (ColTab != oldColTab) || (ChrGen != oldChrGen) || (SprTab != oldSprTab) || (SprGen != oldSprGen) ||
+                (ColTabM != oldColTabM) || (ChrGenM != oldChrGenM);
+  }
+  if (bRedraw) Invalidate9918();
+
   /* Return IRQ, if generated */
   return(bIRQ);
 }
@@ -771,13 +980,13 @@ ITCM_CODE byte RdCtrl9918(void)
 /** screen buffer. Loop9918() returns 1 if an interrupt is  **/
 /** to be generated, 0 otherwise.                           **/
 /*************************************************************/
-u8 frameSkipIdx __attribute__((section(".dtcm"))) = 0;
+MACHINE_DTCM  u8 frameSkipIdx = 0;
 u8 frameSkip[3] __attribute__((section(".dtcm"))) = {0xFF, 0x03, 0x01};   // Frameskip OFF, Light, Agressive
 
-u16 tms_num_lines  __attribute__((section(".dtcm"))) = TMS9918_LINES;
-u16 tms_start_line __attribute__((section(".dtcm"))) = TMS9918_START_LINE;
-u16 tms_end_line   __attribute__((section(".dtcm"))) = TMS9918_END_LINE;
-u16 tms_cpu_line   __attribute__((section(".dtcm"))) = TMS9918_LINE;
+MACHINE_DTCM  u16 tms_num_lines = TMS9918_LINES;
+MACHINE_DTCM  u16 tms_start_line = TMS9918_START_LINE;
+MACHINE_DTCM  u16 tms_end_line = TMS9918_END_LINE;
+MACHINE_DTCM  u16 tms_cpu_line = TMS9918_LINE;
 
 ITCM_CODE byte Loop9918(void)
 {
@@ -802,23 +1011,42 @@ ITCM_CODE byte Loop9918(void)
       if ((frameSkipIdx & frameSkip[myConfig.frameSkip]) == 0)
       {
           unsigned int tmp;
-          ScanSprites(CurLine - tms_start_line, &tmp);    // Skip rendering - but still scan sprites for 5th sprite flag
+          ScanSprites(CurLine - tms_start_line, &tmp);    // Skip rendering - but still scan sprites for 5th sprite flag and collisions
       }
       else
       {
-          RefreshLine(CurLine - tms_start_line);
-      }
+          u8 uY = CurLine - tms_start_line;
 
-      // ---------------------------------------------------------------------------
-      // Some programs require that we handle collisions more frequently than just
-      // end of line. So we check every X scanlines. This is somewhat CPU intensive
-      // so we are careful how often we run it - especially on older hardware.
-      // ---------------------------------------------------------------------------
-      if ((CurLine % scan_collisions_every) == 0)
-      {
-          if (!(VDPStatus&TMS9918_STAT_OVRLAP)) // If not already in collision...
+          // A new frame - sprite writes from two frames back can't affect anything we are about to draw
+          if (uY == 0)
           {
-             if (CheckSprites()) VDPStatus|=TMS9918_STAT_OVRLAP; // Set the collision bit
+              SprWrittenLast = SprWritten;
+              SprWritten = 0;
+          }
+
+          // Bring in the rows written since we last looked - every line on those rows must be drawn again
+          if (VDPDirtyRows)
+          {
+              u32 rows = VDPDirtyRows & ALL_ROWS;
+              VDPDirtyRows = 0;
+              for (u8 row=0; rows; row++, rows >>= 1)
+              {
+                  if (rows & 1) VDPLineDirty[row] = 0xFF;
+              }
+          }
+
+          // Frame blending alternates between two screen buffers so there every line is drawn every frame
+          if ((VDPLineDirty[uY>>3] & (1<<(uY&7))) || myConfig.frameBlend || SpriteLineChanged(uY))
+          {
+              VDPLineDirty[uY>>3] &= ~(1<<(uY&7));
+              RefreshLine(uY);
+              SprLineDrawn[uY] = SprLineMask[uY];
+              VDPFrameDirty = 1;
+          }
+          else
+          {
+              unsigned int tmp;
+              ScanSprites(uY, &tmp);    // Line is unchanged - but still scan sprites for 5th sprite flag and collisions
           }
       }
   }
@@ -838,12 +1066,6 @@ ITCM_CODE byte Loop9918(void)
 
       /* Set VBlank status flag */
       VDPStatus|=TMS9918_STAT_VBLANK;
-
-      /* At the end of a frame, we always do one more collision check */
-      if (!(VDPStatus&TMS9918_STAT_OVRLAP)) // If not already in collision...
-      {
-        if (CheckSprites()) VDPStatus|=TMS9918_STAT_OVRLAP; // Set the collision bit
-      }
   }
 
   /* Done */
@@ -892,48 +1114,7 @@ void Reset9918(void)
     tms_num_lines  = (myConfig.isPAL ? TMS9929_LINES       :  TMS9918_LINES);
     tms_cpu_line   = (myConfig.isPAL ? TMS9929_LINE        :  TMS9918_LINE);
 
-    // -----------------------------------------------------------------------
-    // Determine how often we should check for sprite collisions. Some clever
-    // demos and games require that we check more often than end of frame.
-    // -----------------------------------------------------------------------
-    if (myConfig.spriteCheck) // Force a specific collision check value?
-    {
-        scan_collisions_every = CollisionCheckEvery[myConfig.spriteCheck];
-    }
-    else // Use "normal" default values
-    {
-        scan_collisions_every = (isDSiMode() ? 32 : 64);  // Reasonable values for DSi vs DS-Lite/Phat on how often to check for collisions
-    }
-
-    // ---------------------------------------------------------------
-    // Our background/foreground color table makes computations FAST!
-    // ---------------------------------------------------------------
-    int colfg,colbg;
-    for (colfg=0;colfg<16;colfg++)
-    {
-        for (colbg=0;colbg<16;colbg++)
-        {
-          fastBackgroundLut[(colfg<<4) | colbg] = (colbg<<0) | (colbg<<8) | (colbg<<16) | (colbg<<24); // 0 0 0 0 - this one is called often enough that we keep it in fast DTCM memory
-
-          lutTablehh[(colfg<<4) | colbg][ 0] = (colbg<<0) | (colbg<<8) | (colbg<<16) | (colbg<<24); // 0 0 0 0
-          lutTablehh[(colfg<<4) | colbg][ 1] = (colbg<<0) | (colbg<<8) | (colbg<<16) | (colfg<<24); // 0 0 0 1
-          lutTablehh[(colfg<<4) | colbg][ 2] = (colbg<<0) | (colbg<<8) | (colfg<<16) | (colbg<<24); // 0 0 1 0
-          lutTablehh[(colfg<<4) | colbg][ 3] = (colbg<<0) | (colbg<<8) | (colfg<<16) | (colfg<<24); // 0 0 1 1
-          lutTablehh[(colfg<<4) | colbg][ 4] = (colbg<<0) | (colfg<<8) | (colbg<<16) | (colbg<<24); // 0 1 0 0
-          lutTablehh[(colfg<<4) | colbg][ 5] = (colbg<<0) | (colfg<<8) | (colbg<<16) | (colfg<<24); // 0 1 0 1
-          lutTablehh[(colfg<<4) | colbg][ 6] = (colbg<<0) | (colfg<<8) | (colfg<<16) | (colbg<<24); // 0 1 1 0
-          lutTablehh[(colfg<<4) | colbg][ 7] = (colbg<<0) | (colfg<<8) | (colfg<<16) | (colfg<<24); // 0 1 1 1
-
-          lutTablehh[(colfg<<4) | colbg][ 8] = (colfg<<0) | (colbg<<8) | (colbg<<16) | (colbg<<24); // 1 0 0 0
-          lutTablehh[(colfg<<4) | colbg][ 9] = (colfg<<0) | (colbg<<8) | (colbg<<16) | (colfg<<24); // 1 0 0 1
-          lutTablehh[(colfg<<4) | colbg][10] = (colfg<<0) | (colbg<<8) | (colfg<<16) | (colbg<<24); // 1 0 1 0
-          lutTablehh[(colfg<<4) | colbg][11] = (colfg<<0) | (colbg<<8) | (colfg<<16) | (colfg<<24); // 1 0 1 1
-          lutTablehh[(colfg<<4) | colbg][12] = (colfg<<0) | (colfg<<8) | (colbg<<16) | (colbg<<24); // 1 1 0 0
-          lutTablehh[(colfg<<4) | colbg][13] = (colfg<<0) | (colfg<<8) | (colbg<<16) | (colfg<<24); // 1 1 0 1
-          lutTablehh[(colfg<<4) | colbg][14] = (colfg<<0) | (colfg<<8) | (colfg<<16) | (colbg<<24); // 1 1 1 0
-          lutTablehh[(colfg<<4) | colbg][15] = (colfg<<0) | (colfg<<8) | (colfg<<16) | (colfg<<24); // 1 1 1 1
-        }
-    }
+    Invalidate9918();                   // Draw the entire screen on the first frame
 }
 
 // End of file
@@ -2,6 +2,7 @@
 #define _TMS9918A_H_
 
 #include <nds.h>
+#include "../../DS99.h"
 
 #define MAXSCREEN           3   // Highest screen mode supported
 
@@ -55,38 +56,73 @@ typedef struct {
   byte R2,R3,R4,R5,R6,M2,M3,M4,M5;
 } tScrMode;
 
-extern u8 *XBuf;
-extern u8 XBuf_A[];
-extern u8 XBuf_B[];
-extern u8 OH;
-extern u8 IH;
+extern MACHINE_LOCAL u8 *XBuf;
+extern MACHINE_LOCAL u8 XBuf_A[];
+extern MACHINE_LOCAL u8 XBuf_B[];
+extern MACHINE_LOCAL u8 OH;
+extern MACHINE_LOCAL u8 IH;
 
 extern u8 bResetVLatch;
 
 extern u8 TMS9918A_palette[16*3];
 extern tScrMode SCR[MAXSCREEN+1];
 
-extern u32   debug[];   // For debugging on the DS... 
+extern MACHINE_LOCAL u32   debug[];   // For debugging on the DS... 
 
 extern void RefreshLine0(u8 uY);
 extern void RefreshLine1(u8 uY);
 extern void RefreshLine2(u8 uY);
 extern void RefreshLine3(u8 uY);
 
-extern u8 pVDPVidMem[];
+extern MACHINE_LOCAL u8 pVDPVidMem[];
 
-extern u8 VDPDlatch;
-extern u16 VAddr;
-extern u8 VDPCtrlLatch;
+extern MACHINE_LOCAL u8 VDPDlatch;
+extern MACHINE_LOCAL u16 VAddr;
+extern MACHINE_LOCAL u8 VDPCtrlLatch;
 
 extern void WrCtrl9918(byte value);
 
+// ---------------------------------------------------------------------------------------
+// Scanline dirty tracking - a line is only drawn again if something it is drawn from has
+// changed since it was last drawn. Every 64 byte block of VRAM knows which character rows
+// (8 scanlines each) of the screen it feeds and a write to the block flags those rows.
+// The top bit flags the pattern and color table blocks which also feed the span cache and
+// the next bit flags the sprite attribute table which feeds the per-line sprite lists (a
+// sprite write only redraws the lines that sprite is on - see SpriteLineChanged()).
+// ---------------------------------------------------------------------------------------
+#define VDP_BLOCK_SPANS     0x80000000
+#define VDP_BLOCK_SPRITES   0x40000000
+
+extern MACHINE_LOCAL u32 VDPBlockRows[0x4000>>6];
+extern MACHINE_LOCAL u32 VDPDirtyRows;
+extern MACHINE_LOCAL u8  VDPFrameDirty;
+extern MACHINE_LOCAL u8  SprLinesDirty;
+extern MACHINE_LOCAL u32 SprWritten;
+
+extern void Invalidate9918(void);
+extern void Dirty9918(u16 addr, u16 len);
+extern void SpanWrite9918(u16 addr);
+
+// A byte of VRAM at addr was just written - flag the rows it feeds and drop anything cached from it
+inline void VDPWrote9918(u16 addr)
+{
+    u32 rows = VDPBlockRows[addr>>6];
+    VDPDirtyRows |= rows;
+    if (rows & VDP_BLOCK_SPANS) SpanWrite9918(addr);
+    if (rows & VDP_BLOCK_SPRITES)
+    {
+        SprWritten |= 1u << ((addr >> 2) & 31);     // The table is 128 byte aligned so this is the sprite number
+        if (!(addr & 3)) SprLinesDirty = 1;         // Only the sprite Y coordinates decide which lines a sprite is on
+    }
+}
+
 /** WrData9918() *********************************************/
 /** Write a value V to the VDP Data Port.                   **/
 /*************************************************************/
 inline void WrData9918(byte V)  // This one is used frequently so we try to inline it
 {
     VDPDlatch = pVDPVidMem[VAddr] = V;
+    VDPWrote9918(VAddr);
     VAddr     = (VAddr+1)&0x3FFF;
     VDPCtrlLatch = 0;
 }
@@ -95,20 +131,20 @@ extern byte RdData9918(void);
 extern byte RdCtrl9918(void);
 extern void Reset9918(void);
 
-extern u16 CurLine;                            // Current Scanline
-extern u8 VDP[16],VDPStatus,VDPDlatch;         // VDP registers
-extern u16 VAddr;                              // Storage for VIDRAM addresses
-extern u8 VDPCtrlLatch;                        // VDP control latch
-extern u8 *ChrGen,*ChrTab,*ColTab;             // VDP tables (screens)
-extern u8 *SprGen,*SprTab;                     // VDP tables (sprites)
-extern u8 ScrMode;                             // Current screen mode
-extern u8 FGColor,BGColor;                     // Colors
-extern u16 ColTabM, ChrGenM;                   // Color and Character Masks
-
-
-extern u16 tms_num_lines;
-extern u16 tms_start_line;
-extern u16 tms_end_line;
-extern u16 tms_cpu_line;
+extern MACHINE_LOCAL u16 CurLine;                            // Current Scanline
+extern MACHINE_LOCAL u8 VDP[16],VDPStatus,VDPDlatch;         // VDP registers
+extern MACHINE_LOCAL u16 VAddr;                              // Storage for VIDRAM addresses
+extern MACHINE_LOCAL u8 VDPCtrlLatch;                        // VDP control latch
+extern MACHINE_LOCAL u8 *ChrGen,*ChrTab,*ColTab;             // VDP tables (screens)
+extern MACHINE_LOCAL u8 *SprGen,*SprTab;                     // VDP tables (sprites)
+extern MACHINE_LOCAL u8 ScrMode;                             // Current screen mode
+extern MACHINE_LOCAL u8 FGColor,BGColor;                     // Colors
+extern MACHINE_LOCAL u16 ColTabM, ChrGenM;                   // Color and Character Masks
+
+
+extern MACHINE_LOCAL u16 tms_num_lines;
+extern MACHINE_LOCAL u16 tms_start_line;
+extern MACHINE_LOCAL u16 tms_end_line;
+extern MACHINE_LOCAL u16 tms_cpu_line;
 
 #endif
@@ -60,18 +60,18 @@
 #include "cpu/tms9918a/tms9918a.h"
 #include "disk.h"
 
-u8 TICC_REG[8] = {0,0,0,0,0,0,0,0};
-u8 TICC_DIR=0;   // 0 means towards track 0
+MACHINE_LOCAL u8 TICC_REG[8] = {0,0,0,0,0,0,0,0};
+MACHINE_LOCAL u8 TICC_DIR=0;   // 0 means towards track 0
 
-u8 bDiskDeviceInstalled  = 0;       // DSR installed or not installed... We don't do much with this yet.
-u8 diskSideSelected      = 0;       // Side 0 or Side 1
-u8 driveSelected         = DSK1;    // We support DSK1, DSK2 and DSK3
-u8 motorOn               = 0;       // 1=Motor On (Enabled/Strobed)
+MACHINE_LOCAL u8 bDiskDeviceInstalled  = 0;       // DSR installed or not installed... We don't do much with this yet.
+MACHINE_LOCAL u8 diskSideSelected      = 0;       // Side 0 or Side 1
+MACHINE_LOCAL u8 driveSelected         = DSK1;    // We support DSK1, DSK2 and DSK3
+MACHINE_LOCAL u8 motorOn               = 0;       // 1=Motor On (Enabled/Strobed)
 
-Disk_t Disk[MAX_DSKS];              // Contains all the Disk sector data plus some metadata for DSK1, DSK2 and DSK3
-u8 Disk1_ImageBuf[MAX_DSK_SIZE];    // Full buffering of 360K
-u8 Disk2_ImageBuf[MAX_DSK_SIZE];    // Full buffering of 360K
-u8 Disk3_ImageBuf[512];             // First two sectors only for the DS-Lite/Phat but full buffering on DSi (who will use the SharedMemBuffer[])
+MACHINE_LOCAL Disk_t Disk[MAX_DSKS];              // Contains all the Disk sector data plus some metadata for DSK1, DSK2 and DSK3
+MACHINE_LOCAL u8 Disk1_ImageBuf[MAX_DSK_SIZE];    // Full buffering of 360K
+MACHINE_LOCAL u8 Disk2_ImageBuf[MAX_DSK_SIZE];    // Full buffering of 360K
+MACHINE_LOCAL u8 Disk3_ImageBuf[512];             // First two sectors only for the DS-Lite/Phat but full buffering on DSi (who will use the SharedMemBuffer[])
 
 #define ERR_DEVICEERROR     6       // This is the only error we support. Good enough.
 
@@ -102,6 +102,9 @@ void disk_init(void)
     diskSideSelected      = 0;
     driveSelected         = DSK1;
     motorOn               = 0;
+
+    // The TI disk controller DSR sector read/write entry point is handled by us (see HandleTICCSector())
+    TMS9900_AddTrap(0x40e8, HandleTICCSector);
 }
 
 // ------------------------------------------------------
@@ -138,7 +141,7 @@ void disk_cru_write(u16 address, u8 data)
             if (data)
             {
                 // The Disk Controller DSR is visible
-                memcpy(&MemCPU[0x4000], DISK_DSR, 0x2000);
+                TMS9900_CopyWords(&MemCPU[0x4000], DISK_DSR, 0x2000);   // DSR image is in TI byte order
                 MemType[0x5ff0>>4] = MF_DISK;     // Disk Control registers ARE visible
             }
             else
@@ -147,6 +150,8 @@ void disk_cru_write(u16 address, u8 data)
                 memset(&MemCPU[0x4000], 0xFF, 0x2000);
                 MemType[0x5ff0>>4] = MF_PERIF;     // Disk Control registers NOT visible
             }
+            TMS9900_MapMemory(0x5F00, 0x5FFF);
+            TMS9900_FlushBlockCache();  // Any code we had cached at >4000 is no longer what's there
             break;
         case 1:
             motorOn = data;  // If enabled, strobe motor for 4.23 seconds... we just track motor on/off
@@ -300,7 +305,7 @@ void WriteTICCRegister(u16 address, u8 val)
 
 // ----------------------------------------------------------------------------------------------------------------
 // This is where the magic happens.. this ruotine is called to handle a sector and is done cleverly by way of 
-// looking at when the PC counter is at >40E8 whcih is the TI disk controller DSR's entry to handle sector
+// trapping the PC at >40E8 (see disk_init()) which is the TI disk controller DSR's entry to handle sector
 // reads and writes. In this way we can utilize the existing TI disk controller DSR and just handle the actual
 // sector read/write. This DSR allows us up to the standard 1600 bits x 256 sectors or 400K of disk space. We
 // limit to 360K which is the sort of standard Double-Sided Double-Density drive. If we wanted to go beyond 
@@ -310,13 +315,13 @@ void WriteTICCRegister(u16 address, u8 val)
  void HandleTICCSector(void)
 {
     bool success = true;
-    extern u8 pVDPVidMem[];
+    extern MACHINE_LOCAL u8 pVDPVidMem[];
     
     if (!bDiskDeviceInstalled) return; // We hit the correct PC counter but the DSR wasn't swapped in so ignore it...
     
     if (driveSelected != 1 && driveSelected != 2  && driveSelected != 3) // We only support DSK1, DSK2 or DSK3
     {
-        MemCPU[0x8350] = ERR_DEVICEERROR;  
+        MemCPU[BYTE_LANE(0x8350)] = ERR_DEVICEERROR;  
         tms9900.PC = 0x42a0;                // error 31 (not found)        
     }
     
@@ -324,10 +329,10 @@ void WriteTICCRegister(u16 address, u8 val)
     // 834C = drive (1-3)
     // 834D = 0: write, anything else = read
     // 834E = VDP buffer address
-    u8  drive        = MemCPU[0x834C];
-    u8  isRead       = MemCPU[0x834D];
-    u16 sectorNumber = (MemCPU[0x834A]<<8) | MemCPU[0x834B];
-    u16 destVDP      = (MemCPU[0x834E]<<8) | MemCPU[0x834F];
+    u8  drive        = MemCPU[BYTE_LANE(0x834C)];
+    u8  isRead       = MemCPU[BYTE_LANE(0x834D)];
+    u16 sectorNumber = (MemCPU[BYTE_LANE(0x834A)]<<8) | MemCPU[BYTE_LANE(0x834B)];
+    u16 destVDP      = (MemCPU[BYTE_LANE(0x834E)]<<8) | MemCPU[BYTE_LANE(0x834F)];
     u32 index        = (sectorNumber * 256);
     
     if ((drive == 1) || (drive == 2) || (drive == 3))
@@ -357,9 +362,11 @@ void WriteTICCRegister(u16 address, u8 val)
                 {
                     memcpy(&pVDPVidMem[destVDP], &Disk[drive].image[index], 256);
                 }
-                *((u16*)&MemCPU[0x834A]) = sectorNumber;     // fill in the return data
+                Dirty9918(destVDP, 256);                             // The sector may have landed on something that is on screen
+                MemCPU[BYTE_LANE(0x834A)] = (u8)sectorNumber;        // fill in the return data (low byte first -
+                MemCPU[BYTE_LANE(0x834B)] = (u8)(sectorNumber>>8);   // the same layout the DSR has always been handed)
                 Disk[drive].driveReadCounter = 2;            // briefly show that we are reading from the disk
-                MemCPU[0x8350] = 0;                          // should still be 0 if no error occurred
+                MemCPU[BYTE_LANE(0x8350)] = 0;               // should still be 0 if no error occurred
             } 
             else  // Must be write
             {
@@ -371,10 +378,11 @@ void WriteTICCRegister(u16 address, u8 val)
                         Disk[drive].dirtySectors[sectorNumber] = 1;  // Mark this specific sector as needing writing
                     }
                     memcpy(&Disk[drive].image[index], &pVDPVidMem[destVDP],256);
-                    *((u16*)&MemCPU[0x834A]) = sectorNumber;     // fill in the return data
+                    MemCPU[BYTE_LANE(0x834A)] = (u8)sectorNumber;        // fill in the return data (low byte first -
+                    MemCPU[BYTE_LANE(0x834B)] = (u8)(sectorNumber>>8);   // the same layout the DSR has always been handed)
                     Disk[drive].isDirty = 1;                     // Mark this disk as needing a write-back to SD card
                     Disk[drive].driveWriteCounter = 2;           // And briefly show that we are writing to the disk
-                    MemCPU[0x8350] = 0;                          // should still be 0 if no error occurred
+                    MemCPU[BYTE_LANE(0x8350)] = 0;               // should still be 0 if no error occurred
                 }
                 else
                 {
@@ -392,7 +400,7 @@ void WriteTICCRegister(u16 address, u8 val)
     }
     else
     {
-        MemCPU[0x8350] = ERR_DEVICEERROR; 
+        MemCPU[BYTE_LANE(0x8350)] = ERR_DEVICEERROR; 
         tms9900.PC = 0x42a0;                // error 31 (not found)
     }
 }
@@ -402,7 +410,7 @@ void WriteTICCRegister(u16 address, u8 val)
 // 4K worth of disk data for the buffered I/O (fopen/fwrite/fclose).
 // The default buffer size internally is 1K so this helps a bit...
 // ------------------------------------------------------------------
-char sd_buf[4096];
+MACHINE_LOCAL char sd_buf[4096];
 
 // --------------------------------------------------------------------------------------------------
 // Routines below this comment are all related to reading and writing .DSK files to and from the
@@ -539,8 +547,8 @@ void disk_backup_to_sd(u8 drive)
 // DS994a will use this listing to present a list of files to the user
 // so they can pick a file and easily paste it into the keyboard buffer.
 // ----------------------------------------------------------------------
-char dsk_listing[MAX_FILES_PER_DSK][12];    // We store the disk listing here...
-u8   dsk_num_files = 0;                     // And this is how many files we found (never more than MAX_FILES_PER_DSK)
+MACHINE_LOCAL char dsk_listing[MAX_FILES_PER_DSK][12];    // We store the disk listing here...
+MACHINE_LOCAL u8   dsk_num_files = 0;                     // And this is how many files we found (never more than MAX_FILES_PER_DSK)
 
 void disk_get_file_listing(u8 drive)
 {
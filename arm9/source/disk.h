@@ -27,20 +27,20 @@ typedef struct
     u8   *image;                        // The (up to) 360K disk image in sector format (V9T9 sector dump format)
 }  Disk_t;
 
-extern Disk_t Disk[MAX_DSKS];
+extern MACHINE_LOCAL Disk_t Disk[MAX_DSKS];
 
 #define MAX_FILES_PER_DSK           32          // We allow 32 files shown per disk... that's enough for our purposes and it's what we can show on screen comfortably
 #define MAX_DSK_FILE_LEN            12          // And room for 12 characters per file (really 10 plus NULL but we keep it on an even-byte boundary)
 
-extern char dsk_listing[MAX_FILES_PER_DSK][MAX_DSK_FILE_LEN];   // We store the disk listing here...
-extern u8   dsk_num_files;                                      // And we found this many files...
+extern MACHINE_LOCAL char dsk_listing[MAX_FILES_PER_DSK][MAX_DSK_FILE_LEN];   // We store the disk listing here...
+extern MACHINE_LOCAL u8   dsk_num_files;                                      // And we found this many files...
 
-extern u8 TICC_REG[8];
-extern u8 TICC_DIR;
-extern u8 bDiskDeviceInstalled;
-extern u8 diskSideSelected;
-extern u8 driveSelected;
-extern u8 motorOn;
+extern MACHINE_LOCAL u8 TICC_REG[8];
+extern MACHINE_LOCAL u8 TICC_DIR;
+extern MACHINE_LOCAL u8 bDiskDeviceInstalled;
+extern MACHINE_LOCAL u8 diskSideSelected;
+extern MACHINE_LOCAL u8 driveSelected;
+extern MACHINE_LOCAL u8 motorOn;
 
 extern void disk_init(void);
 extern u8   ReadTICCRegister(u16 address);
@@ -31,12 +31,12 @@
 // GROM read/write addresses but is instead mapped to some hotspot addresses within the DSR.
 // ------------------------------------------------------------------------------------------
 
-u8  pCodeEmulation __attribute__((section(".dtcm")))  = 0;     // Default to no p-code card emulation. Will be set '1' only if the user picks the p-code 'cart' and matching 64K special internal GROM.
-u8  pcode_bank = 0;
-u8  pcode_visible = 0;
-u16 pcode_gromAddress = 0x0000;
-u8  pcode_gromWriteLoHi = 0;
-u8  pcode_gromReadLoHi = 0;
+MACHINE_DTCM  u8  pCodeEmulation = 0;  // Default to no p-code card emulation. Will be set '1' only if the user picks the p-code 'cart' and matching 64K special internal GROM.
+MACHINE_LOCAL u8  pcode_bank = 0;
+MACHINE_LOCAL u8  pcode_visible = 0;
+MACHINE_LOCAL u16 pcode_gromAddress = 0x0000;
+MACHINE_LOCAL u8  pcode_gromWriteLoHi = 0;
+MACHINE_LOCAL u8  pcode_gromReadLoHi = 0;
 
 // ------------------------------------------------------
 // Set the p-code system to start on bank 0, not visible
@@ -93,6 +93,9 @@ void pcode_cru_write(u16 address, u8 data)
             MemType[0x5FFC>>4] = MF_PERIF;
             pcode_visible = 0;
         }
+        TMS9900_MapMemory(0x5B00, 0x5BFF);
+        TMS9900_MapMemory(0x5F00, 0x5FFF);
+        TMS9900_FlushBlockCache();  // Any code we had cached at >4000 is no longer what's there
         
     }
     else if (address == 0x40) // Is this the DSR banking bit? (which responds to >1F80 due to p-code card logic... by the time it gets here it's weight >40)
@@ -101,6 +104,7 @@ void pcode_cru_write(u16 address, u8 data)
         if (pcode_visible)
         {
             memcpy(&MemCPU[0x5000], MemCART + (0x1000 + (0x1000 * pcode_bank)), 0x1000);    // Make sure the right 4K bank is in place
+            TMS9900_FlushBlockCache();  // Any code we had cached at >5000 is no longer what's there
         }
     }
 }
@@ -173,7 +177,7 @@ u8 pcode_dsr_read(u16 address)
         return data;
     }
     
-    return MemCPU[address];
+    return MemCPU[BYTE_LANE(address)];
 }
 
 // End of file
@@ -15,12 +15,12 @@
 #include "DS99.h"
 #include "DS99_utils.h"
 
-extern u8  pCodeEmulation;
-extern u8  pcode_bank;
-extern u8  pcode_visible;
-extern u8  pcode_gromWriteLoHi;
-extern u8  pcode_gromReadLoHi;
-extern u16 pcode_gromAddress;
+extern MACHINE_LOCAL u8  pCodeEmulation;
+extern MACHINE_LOCAL u8  pcode_bank;
+extern MACHINE_LOCAL u8  pcode_visible;
+extern MACHINE_LOCAL u8  pcode_gromWriteLoHi;
+extern MACHINE_LOCAL u8  pcode_gromReadLoHi;
+extern MACHINE_LOCAL u16 pcode_gromAddress;
 
 extern void pcode_init(void);
 
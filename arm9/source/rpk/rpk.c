@@ -29,11 +29,11 @@ typedef struct {
 	unsigned int  input_chunk_end;
 } read_state;
 
-read_state read_st; // A bit too large to put into fast memory... but it's fast enough as normal memory
-lowzip_state st         __attribute__((section(".dtcm")));
-yxml_t xml              __attribute__((section(".dtcm")));
-char xml_value[64]      __attribute__((section(".dtcm")));
-Layout_t cart_layout    __attribute__((section(".dtcm")));
+MACHINE_LOCAL read_state read_st; // A bit too large to put into fast memory... but it's fast enough as normal memory
+MACHINE_DTCM  lowzip_state st;
+MACHINE_DTCM  yxml_t xml;
+MACHINE_DTCM  char xml_value[64];
+MACHINE_DTCM  Layout_t cart_layout;
 
 // -----------------------------------------------------------------------
 // We pass this into the lowzip handler who will call us back to read  a
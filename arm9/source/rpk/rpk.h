@@ -13,6 +13,8 @@
 #ifndef RPK_H
 #define RPK_H
 
+#include "../DS99.h"
+
 
 #define MAX_XML_ROMS     6
 #define MAX_XML_SOCKETS  6
@@ -58,7 +60,7 @@ typedef struct
     char     listname[64];
 } Layout_t;
 
-extern Layout_t cart_layout;
+extern MACHINE_LOCAL Layout_t cart_layout;
 
 u8 rpk_load(const char* filename);
 char *rpk_get_pcb_name(void);
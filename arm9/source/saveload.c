@@ -37,7 +37,28 @@
  ********************************************************************************/
 u8  spare[512] = {0x00};    // We keep some spare bytes so we can use them in the future without changing the structure
 static char szFile[160];
-extern char tmpBuf[];
+extern MACHINE_LOCAL char tmpBuf[];
+
+// ----------------------------------------------------------------------------------------
+// Our 16-bit memory is held in native word order but the .sav file keeps the TI's byte
+// order (so older saves and any outside tools see what they always have). We swap the
+// buffer around the write and swap it back afterwards... only happens on save so it's
+// not worth a separate buffer. Reads just swap in place once the data is in memory.
+// ----------------------------------------------------------------------------------------
+static u32 WriteWords(u8 *buf, u32 len, FILE *handle)
+{
+    TMS9900_SwapWords(buf, len);
+    u32 uNbO = fwrite(buf, len, 1, handle);
+    TMS9900_SwapWords(buf, len);
+    return uNbO;
+}
+
+static u32 ReadWords(u8 *buf, u32 len, FILE *handle)
+{
+    u32 uNbO = fread(buf, len, 1, handle);
+    TMS9900_SwapWords(buf, len);
+    return uNbO;
+}
 void TI99SaveState() 
 {
   u32 uNbO;
@@ -77,7 +98,8 @@ void TI99SaveState()
     u16 save_ver = TI_SAVE_VER;
     uNbO = fwrite(&save_ver, sizeof(u16), 1, handle);
     
-    // Write TMS9900 CPU and TMS9901 IO handling memory
+    // Write TMS9900 CPU and TMS9901 IO handling memory (bring the running timer count up to date first)
+    TMS9901_UpdateTimer();
     if (uNbO) uNbO = fwrite(&tms9900, sizeof(tms9900), 1, handle);
     if (uNbO) uNbO = fwrite(&tms9901, sizeof(tms9901), 1, handle);
       
@@ -85,19 +107,20 @@ void TI99SaveState()
     if (uNbO) uNbO = fwrite(&theSAMS, sizeof(theSAMS),1, handle); 
       
     // Save TI Memory that might possibly be volatile (RAM areas mostly)
-    if (uNbO) uNbO = fwrite(MemCPU+0x6000, 0x2000, 1, handle);  // Could be 'Super Space' cart with RAM
-    if (uNbO) uNbO = fwrite(MemCPU+0x8000, 0x0400, 1, handle);  // RAM with mirrors needs saving
+    if (uNbO) uNbO = WriteWords(MemCPU+0x6000, 0x2000, handle);  // Could be 'Super Space' cart with RAM
+    TMS9900_SyncScratchpad();  // Bring the >8000-82FF mirrors up to date so the state looks the same as it always has
+    if (uNbO) uNbO = WriteWords(MemCPU+0x8000, 0x0400, handle);  // RAM with mirrors needs saving
     
     // Most carts won't touch the expanded RAM memory so we can save writing 
     // it if the values in that RAM area are not touched...
     u16 isExpandedRamUsed = 0;
     for (u32 i=0x2000; i< 0x4000; i+=2)
     {
-        if (MemCPU[i] != 0xFF || MemCPU[i+1] != 0x00) isExpandedRamUsed = 1;
+        if (*(u16*)&MemCPU[i] != 0xFF00) isExpandedRamUsed = 1;
     }
     for (u32 i=0xA000; i< 0x10000; i+=2)
     {
-        if (MemCPU[i] != 0xFF || MemCPU[i+1] != 0x00) isExpandedRamUsed = 1;
+        if (*(u16*)&MemCPU[i] != 0xFF00) isExpandedRamUsed = 1;
     }
     
     // Write a variable to let us know if the RAM expanded area is used...
@@ -106,8 +129,8 @@ void TI99SaveState()
     // And if the RAM expanded area is used, we write that as well...
     if (isExpandedRamUsed)
     {
-        if (uNbO) uNbO = fwrite(MemCPU+0x2000, 0x2000, 1, handle); 
-        if (uNbO) uNbO = fwrite(MemCPU+0xA000, 0x6000, 1, handle); 
+        if (uNbO) uNbO = WriteWords(MemCPU+0x2000, 0x2000, handle); 
+        if (uNbO) uNbO = WriteWords(MemCPU+0xA000, 0x6000, handle); 
     }
     
     // Save the Memory Types for each region of memory
@@ -199,7 +222,7 @@ void TI99SaveState()
     {
         if (uNbO) uNbO = fwrite(&super_bank,  sizeof(super_bank),  1, handle); 
         if (uNbO) uNbO = fwrite(&cart_cru_shadow,  sizeof(cart_cru_shadow),  1, handle); 
-        if (uNbO) uNbO = fwrite(&MemCART[MAX_CART_SIZE-0x8000], 0x8000, 1, handle); 
+        if (uNbO) uNbO = WriteWords(&MemCART[MAX_CART_SIZE-0x8000], 0x8000, handle); 
     }
       
     if (myConfig.cartType == CART_TYPE_PAGEDCRU)
@@ -272,12 +295,15 @@ void TI99LoadState()
             // Load SAMS memory indexes
             if (uNbO) uNbO = fread(&theSAMS, sizeof(theSAMS),1, handle); 
             
+            // Older save states might have the TIMER or SAMS accurate flags - neither needs the accurate core now
+            tms9900.accurateEmuFlags &= ACCURATE_EMU_IDLE;
+
             // Ensure we are pointing to the right cart bank in memory
             tms9900.cartBankPtr = MemCART+tms9900.bankOffset;
             
             // Restore TI Memory that might possibly be volatile (RAM areas mostly)
-            if (uNbO) uNbO = fread(MemCPU+0x6000, 0x2000, 1, handle); 
-            if (uNbO) uNbO = fread(MemCPU+0x8000, 0x0400, 1, handle); 
+            if (uNbO) uNbO = ReadWords(MemCPU+0x6000, 0x2000, handle); 
+            if (uNbO) uNbO = ReadWords(MemCPU+0x8000, 0x0400, handle); 
 
             // Read back the variable that tells us if the RAM Expanded area is used...
             u16 isExpandedRamUsed = 0;
@@ -286,8 +312,8 @@ void TI99LoadState()
             // And if it that expanded RAM is used, we read it back in...
             if (isExpandedRamUsed)
             {
-                if (uNbO) uNbO = fread(MemCPU+0x2000, 0x2000, 1, handle); 
-                if (uNbO) uNbO = fread(MemCPU+0xA000, 0x6000, 1, handle); 
+                if (uNbO) uNbO = ReadWords(MemCPU+0x2000, 0x2000, handle); 
+                if (uNbO) uNbO = ReadWords(MemCPU+0xA000, 0x6000, handle); 
             }            
 
             // Restore the Memory Types for each region of memory
@@ -325,6 +351,7 @@ void TI99LoadState()
             SprGen = pSvg + pVDPVidMem;
             if (uNbO) uNbO = fread(&pSvg, sizeof(pSvg),1, handle); 
             SprTab = pSvg + pVDPVidMem;
+            Invalidate9918();                       // All new VRAM and tables - draw the entire screen again
             
             // Load PSG Sound Stuff
             if (uNbO) uNbO = fread(&snti99, sizeof(snti99),1, handle);
@@ -343,7 +370,7 @@ void TI99LoadState()
             // If the disk drive DSR was installed... put it back into the peripheral memory
             if (bDiskDeviceInstalled)
             {
-                memcpy(&MemCPU[0x4000], DISK_DSR, 0x2000);
+                TMS9900_CopyWords(&MemCPU[0x4000], DISK_DSR, 0x2000);
             }
 
             // Some p-code state vars...
@@ -390,7 +417,7 @@ void TI99LoadState()
             {
                 if (uNbO) uNbO = fread(&super_bank,  sizeof(super_bank),  1, handle); 
                 if (uNbO) uNbO = fread(&cart_cru_shadow,  sizeof(cart_cru_shadow),  1, handle); 
-                if (uNbO) uNbO = fread(&MemCART[MAX_CART_SIZE-0x8000], 0x8000, 1, handle); 
+                if (uNbO) uNbO = ReadWords(&MemCART[MAX_CART_SIZE-0x8000], 0x8000, handle); 
             }
             
             if (myConfig.cartType == CART_TYPE_PAGEDCRU)
@@ -404,6 +431,16 @@ void TI99LoadState()
             // Restore the SAMS memory banks as they were... this should get our memory map back properly
             SAMS_cru_write(0x0000, theSAMS.cruSAMS[0]);
             SAMS_cru_write(0x0001, theSAMS.cruSAMS[1]);            
+
+            // The memory map and cart bank came back with the state - rebuild the page table to match
+            TMS9900_MapMemory(0x0000, 0xFFFF);
+
+            // Memory has changed out from under the CPU so nothing in the block cache can be trusted
+            TMS9900_FlushBlockCache();
+
+            // Restart the 9901 timer from the saved count and take a look at any interrupt that was pending
+            TMS9901_ScheduleTimer();
+            intCheck = 1;
             
             // Fix up transparency
             if (BGColor)
@@ -46,7 +46,7 @@
 // queue them up but that's not how it works with MaxMod and the SFX sound effect handling.
 // -------------------------------------------------------------------------------------------
 
-Speech_t Speech __attribute__((section(".dtcm")));
+MACHINE_DTCM  Speech_t Speech;
 
 static u8 DummySpeechROM[(5*1024)+40];
 
@@ -205,8 +205,8 @@ static const SpeechTable_t SpeechTable[] =
 //------------------------------------------------------------------------
 void SpeechDataWrite(u8 data)
 {
-    static u8 LoadAddressIdx = 0;
-    static u8 LoadAddressByte[5];
+    static MACHINE_LOCAL u8 LoadAddressIdx = 0;
+    static MACHINE_LOCAL u8 LoadAddressByte[5];
     
     if (myConfig.sounddriver == 1) return; // Check if the Speech Module is disabled...
 
@@ -12,6 +12,8 @@
 #ifndef _SPEECH_H_
 #define _SPEECH_H_
 
+#include "DS99.h"
+
 enum SPEECH_STATE
 {
     SS_IDLE,
@@ -31,7 +33,7 @@ typedef struct
     u32 prevData32;
 } Speech_t;
 
-extern Speech_t Speech;
+extern MACHINE_LOCAL Speech_t Speech;
 
 extern void SpeechDataWrite(u8 data);
 extern u8   SpeechDataRead(void);
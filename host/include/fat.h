@@ -0,0 +1,26 @@
+// =====================================================================================
+// Copyright (c) 2023-2025 Dave Bernazzani (wavemotion-dave)
+//
+// Copying and distribution of this emulator, its source code and associated 
+// readme files, with or without modification, are permitted in any medium without 
+// royalty provided this copyright notice is used and wavemotion-dave is thanked profusely.
+//
+// The DS994a emulator is offered as-is, without any warranty.
+//
+// Please see the README.md file as it contains much useful info.
+// =====================================================================================
+
+// ---------------------------------------------------------------------------
+// Stand-in for libfat - on the host the normal C library file I/O is used.
+// ---------------------------------------------------------------------------
+#ifndef _HOST_FAT_H_
+#define _HOST_FAT_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+
+static inline bool fatInitDefault(void) {return true;}
+
+#endif // _HOST_FAT_H_
+
+// End of file
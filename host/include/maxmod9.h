@@ -0,0 +1,29 @@
+// =====================================================================================
+// Copyright (c) 2023-2025 Dave Bernazzani (wavemotion-dave)
+//
+// Copying and distribution of this emulator, its source code and associated 
+// readme files, with or without modification, are permitted in any medium without 
+// royalty provided this copyright notice is used and wavemotion-dave is thanked profusely.
+//
+// The DS994a emulator is offered as-is, without any warranty.
+//
+// Please see the README.md file as it contains much useful info.
+// =====================================================================================
+
+// ---------------------------------------------------------------------------
+// Stand-in for maxmod - the host build is silent so speech samples are just
+// counted (handy to know the speech path was exercised) and otherwise ignored.
+// ---------------------------------------------------------------------------
+#ifndef _HOST_MAXMOD9_H_
+#define _HOST_MAXMOD9_H_
+
+typedef unsigned int mm_word;
+typedef unsigned int mm_sfxhand;
+
+extern unsigned int host_speech_effects;
+
+static inline mm_sfxhand mmEffect(mm_word sample_ID) {(void)sample_ID; host_speech_effects++; return 0;}
+
+#endif // _HOST_MAXMOD9_H_
+
+// End of file
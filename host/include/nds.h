@@ -0,0 +1,123 @@
+// =====================================================================================
+// Copyright (c) 2023-2025 Dave Bernazzani (wavemotion-dave)
+//
+// Copying and distribution of this emulator, its source code and associated
+// readme files, with or without modification, are permitted in any medium without
+// royalty provided this copyright notice is used and wavemotion-dave is thanked profusely.
+//
+// The DS994a emulator is offered as-is, without any warranty.
+//
+// Please see the README.md file as it contains much useful info.
+// =====================================================================================
+
+// -----------------------------------------------------------------------------------
+// Thin stand-in for libnds so that the emulation core (CPU, VDP, 9901, SAMS, disk,
+// speech and the cart loader) can be compiled for a Linux host. We only provide the
+// handful of types, attributes and hardware registers the core actually touches -
+// video and DMA registers become harmless host variables or no-ops. The DS VRAM banks
+// that the core uses as fast memory (lookup tables, BIOS/GROM cache) are mapped at
+// their real DS addresses by the host platform layer so no core code has to change.
+// -----------------------------------------------------------------------------------
+#ifndef _HOST_NDS_H_
+#define _HOST_NDS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+typedef uint8_t     u8;
+typedef uint16_t    u16;
+typedef uint32_t    u32;
+typedef uint64_t    u64;
+typedef int8_t      s8;
+typedef int16_t     s16;
+typedef int32_t     s32;
+typedef int64_t     s64;
+typedef uint8_t     byte;
+
+typedef volatile u8  vu8;
+typedef volatile u16 vu16;
+typedef volatile u32 vu32;
+typedef volatile s16 vs16;
+typedef volatile s32 vs32;
+
+// ----------------------------------------------------------------------
+// The DS places hot code in ITCM and hot data in DTCM. On the host these
+// are just ordinary code and data - the .dtcm section attribute used in
+// the core is harmless for an ELF target so we leave that one alone.
+// ----------------------------------------------------------------------
+#define ITCM_CODE
+#define DTCM_DATA
+#define DTCM_BSS
+#define ALIGN(m)    __attribute__((aligned (m)))
+#define BIT(n)      (1 << (n))
+
+#define RGB15(r,g,b)  ((r)|((g)<<5)|((b)<<10))
+
+// ----------------------------------------------------------------------
+// Each machine (one per thread - see MACHINE_LOCAL in DS99.h) thinks it
+// owns the DS hardware so the stand-ins below are per thread as well.
+// ----------------------------------------------------------------------
+extern __thread u16 host_bg_palette[256];
+extern __thread u16 host_sprite_palette[256];
+#define BG_PALETTE      host_bg_palette
+#define SPRITE_PALETTE  host_sprite_palette
+
+// ----------------------------------------------------------------------
+// Video / background registers - written once at startup by the cart
+// loader. On the host they go nowhere.
+// ----------------------------------------------------------------------
+extern __thread vu32 host_dummy_reg32;
+extern __thread vs16 host_dummy_reg16;
+
+#define REG_BG3CNT              host_dummy_reg16
+#define REG_BG3PA               host_dummy_reg16
+#define REG_BG3PB               host_dummy_reg16
+#define REG_BG3PC               host_dummy_reg16
+#define REG_BG3PD               host_dummy_reg16
+#define REG_BG3X                host_dummy_reg32
+#define REG_BG3Y                host_dummy_reg32
+
+#define MODE_0_2D               0
+#define MODE_5_2D               5
+#define DISPLAY_BG0_ACTIVE      0
+#define DISPLAY_BG1_ACTIVE      0
+#define DISPLAY_BG3_ACTIVE      0
+#define DISPLAY_SPR_1D_LAYOUT   0
+#define DISPLAY_SPR_ACTIVE      0
+#define BG_BMP8_256x256         0
+#define VRAM_A_MAIN_BG_0x06000000 0
+
+#define videoSetMode(mode)      ((void)(mode))
+#define videoSetModeSub(mode)   ((void)(mode))
+#define vramSetBankA(a)         ((void)(a))
+
+// ----------------------------------------------------------------------
+// DMA is a straight memory copy/fill on the host. The emulated screen
+// ends up in the host copy of the DS frame buffer at 0x06000000.
+// ----------------------------------------------------------------------
+static inline void dmaCopyWordsAsynch(u8 channel, const void *src, void *dest, u32 size)
+{
+    (void)channel;
+    memcpy(dest, src, size);
+}
+
+static inline void dmaFillWords(u32 value, void *dest, u32 size)
+{
+    u32 *p = (u32 *)dest;
+    for (u32 i=0; i<size/4; i++) *p++ = value;
+}
+
+static inline void swiWaitForVBlank(void) {}
+static inline void DC_FlushAll(void) {}
+
+extern __thread bool host_dsi_mode;
+static inline bool isDSiMode(void) {return host_dsi_mode;}
+
+#endif // _HOST_NDS_H_
+
+// End of file
@@ -0,0 +1,454 @@
+// =====================================================================================
+// Copyright (c) 2023-2025 Dave Bernazzani (wavemotion-dave)
+//
+// Copying and distribution of this emulator, its source code and associated
+// readme files, with or without modification, are permitted in any medium without
+// royalty provided this copyright notice is used and wavemotion-dave is thanked profusely.
+//
+// The DS994a emulator is offered as-is, without any warranty.
+//
+// Please see the README.md file as it contains much useful info.
+// =====================================================================================
+
+// ------------------------------------------------------------------------------------
+// ds99batch - runs every cart in a directory headless on the Linux host and writes one
+// line of CSV per cart: the final frame CRC, emulated frames/sec, instruction count
+// and the illegal opcode count. Optionally saves a PNG of the final frame for each cart
+// and compares the lot against an earlier CSV so a whole cart library can be checked
+// for regressions after a change to the core in one go.
+//
+// The carts are shared out over a pool of worker threads (one per host core unless
+// told otherwise). Every cart runs on a brand new thread of its own and so on a brand
+// new machine (see MACHINE_LOCAL in DS99.h) - which means a cart gets exactly the same
+// result here as it does when run on its own with ds99bench.
+// ------------------------------------------------------------------------------------
+#include <nds.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "DS99.h"
+#include "DS99mngt.h"
+#include "DS99_utils.h"
+#include "cpu/tms9900/tms9901.h"
+#include "cpu/tms9900/tms9900.h"
+#include "cpu/tms9918a/tms9918a.h"
+#include "host_platform.h"
+#include "tms9900_jit.h"
+
+extern MACHINE_LOCAL u32 file_crc;
+
+#define BATCH_MAX_NAME      256
+#define BATCH_STACK_SIZE    (16*1024*1024)  // Room for the thread-local machine (several MB) on top of the stack itself
+
+// ------------------------------------------------------------------------------------
+// The run settings - the same for every cart and read-only once the workers start
+// ------------------------------------------------------------------------------------
+typedef struct
+{
+    const char      *cartDir;
+    const char      *biosDir;
+    const char      *pngDir;
+    u32             numFrames;
+    u32             warmFrames;
+    u8              bDSi;
+    u8              bSAMS;
+    u8              bJIT;
+    int             frameSkip;
+    HostKeyScript_t script;
+} BatchSettings_t;
+
+// ------------------------------------------------------------------------------------
+// One of these per cart - the worker that runs the cart fills in the results
+// ------------------------------------------------------------------------------------
+typedef struct
+{
+    char    name[BATCH_MAX_NAME];       // Cart filename within the cart directory
+    u8      bRan;                       // Cart booted and ran all of its frames
+    u32     crc;                        // File CRC (as shown on the DS)
+    u32     frameHash;                  // CRC of the final frame
+    double  fps;                        // Emulated frames/sec
+    u64     instructions;               // TMS9900 instructions run over the timed frames
+    u32     illegalOPs;
+    u16     lastIllegalOP;
+    u8      bPNG;                       // A PNG of the final frame was written
+    const char *status;
+} BatchJob_t;
+
+// ------------------------------------------------------------------------------------
+// A row from an earlier CSV we compare against
+// ------------------------------------------------------------------------------------
+typedef struct
+{
+    char    name[BATCH_MAX_NAME];
+    u32     frameHash;
+    double  fps;
+} BatchBaseline_t;
+
+static BatchSettings_t  settings;
+static BatchJob_t       *jobs = NULL;
+static u32              numJobs = 0;
+static u32              nextJob = 0;
+static u32              doneJobs = 0;
+static pthread_mutex_t  jobLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_attr_t   threadAttr;
+
+static void Usage(void)
+{
+    fprintf(stderr,
+        "Usage: ds99batch [options] <cart directory>\n"
+        "  -b <dir>     Directory holding 994aROM.bin, 994aGROM.bin (and optional 994aDISK.bin). Default: .\n"
+        "  -n <frames>  Number of frames to run each cart (default 600)\n"
+        "  -w <frames>  Warm-up frames run before timing starts (default 0)\n"
+        "  -k <script>  Scripted key presses as frame:KEY pairs, e.g. 90:SPACE,150:2\n"
+        "  -l           Emulate a DS-Lite/Phat (smaller cart/SAMS memory, no RAM mirrors)\n"
+        "  -s           Force the 32K+SAMS machine type\n"
+        "  -f <0|1|2>   Frame skip setting (default 0 - render every frame)\n"
+        "  -j           Run the fast core through the x86-64 JIT (the accurate core is unaffected)\n"
+        "  -p <threads> Number of carts to run at once (default - one per host core)\n"
+        "  -o <file>    Write the CSV here (default stdout)\n"
+        "  -i <dir>     Save a PNG of the final frame of each cart into this directory\n"
+        "  -r <file>    Compare against an earlier CSV - exit status is 1 if any cart changed or slowed\n"
+        "  -x <pct>     With -r, how much lower frames/sec must be to count as slower (default 20)\n"
+        "  -v           Verbose - show messages the emulator would print on the DS\n");
+}
+
+static double Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// ------------------------------------------------------------------------------------
+// Find the carts - the same .bin and .rpk files, in the same order, as the DS cart
+// picker shows (see TI99FindFiles()). That includes dropping the C/D/G 'sibling'
+// files so that each multi-file cart only runs once - TI99Init() finds the others.
+// ------------------------------------------------------------------------------------
+static int BatchNamecmp(const void *c1, const void *c2)
+{
+    char n1[BATCH_MAX_NAME], n2[BATCH_MAX_NAME];
+    strcpy(n1, ((const BatchJob_t *)c1)->name);
+    strcpy(n2, ((const BatchJob_t *)c2)->name);
+
+    // Force the '0' files to sort lower just as TI99Filescmp() does
+    if (n1[strlen(n1)-5] == '0') n1[strlen(n1)-5] = 'Z';
+    if (n2[strlen(n2)-5] == '0') n2[strlen(n2)-5] = 'Z';
+    return strcasecmp(n1, n2);
+}
+
+static u32 BatchFindCarts(const char *cartDir)
+{
+    DIR *dir = opendir(cartDir);
+    struct dirent *pent;
+    u32 maxJobs = 0;
+
+    if (!dir) return 0;
+    numJobs = 0;
+
+    while ((pent = readdir(dir)) != NULL)
+    {
+        const char *name = pent->d_name;
+        if (pent->d_type == DT_DIR) continue;
+        if ((strlen(name) <= 4) || (strlen(name) >= BATCH_MAX_NAME)) continue;
+        if ((strcasecmp(strrchr(name, '.') ? strrchr(name, '.'):"", ".bin") != 0) &&
+            (strcasecmp(strrchr(name, '.') ? strrchr(name, '.'):"", ".rpk") != 0)) continue;
+
+        if (numJobs == maxJobs)
+        {
+            maxJobs = maxJobs ? maxJobs*2 : 256;
+            jobs = realloc(jobs, maxJobs * sizeof(BatchJob_t));
+        }
+        memset(&jobs[numJobs], 0x00, sizeof(BatchJob_t));
+        strcpy(jobs[numJobs].name, name);
+        numJobs++;
+    }
+    closedir(dir);
+
+    if (numJobs)
+    {
+        qsort(jobs, numJobs, sizeof(BatchJob_t), BatchNamecmp);
+
+        // And remove the 'sibling' files that are part of the same binary package C/D/G files...
+        for (u32 i=0; i+1 < numJobs; )
+        {
+            size_t len = strlen(jobs[i].name);
+            if ((len > 5) && (len == strlen(jobs[i+1].name)) && (strncmp(jobs[i].name, jobs[i+1].name, len-5) == 0))
+            {
+                memmove(&jobs[i+1], &jobs[i+2], (numJobs-i-2) * sizeof(BatchJob_t));
+                numJobs--;
+            }
+            else i++;
+        }
+    }
+
+    return numJobs;
+}
+
+// ------------------------------------------------------------------------------------
+// Run one cart - this is always called on a thread of its own so the machine is fresh.
+// The same order of operations as ds99bench (and the DS when a game is picked).
+// ------------------------------------------------------------------------------------
+static void *BatchRunCart(void *arg)
+{
+    BatchJob_t *job = (BatchJob_t *)arg;
+    char path[1024];
+
+    snprintf(path, sizeof(path), "%s/%s", settings.cartDir, job->name);
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    fclose(fp);
+
+    if (!HostStartup(settings.bDSi)) return NULL;
+
+    if (HostLoadBIOSFiles(settings.biosDir))
+    {
+        if (settings.bSAMS) globalConfig.machineType = MACH_TYPE_SAMS;
+        globalConfig.frameSkip = settings.frameSkip;
+        HostSetGameConfig(path);
+
+        TI99Init(path, 1);
+
+        if (settings.bJIT) JIT_Enable();
+
+        u32 frame = 0;
+        for (; frame < settings.warmFrames; frame++)
+        {
+            HostApplyKeyScript(&settings.script, frame);
+            while (LoopTMS9900()) ;
+            if (++timingFrames == (myConfig.isPAL ? 50:60)) timingFrames = 0;
+        }
+
+        u32 startInstr = tms9900_instructions;
+        u64 instructions = 0;
+
+        double start = Now();
+        for (u32 i=0; i < settings.numFrames; i++, frame++)
+        {
+            HostApplyKeyScript(&settings.script, frame);
+            while (LoopTMS9900()) ;
+            if (++timingFrames == (myConfig.isPAL ? 50:60)) timingFrames = 0;
+
+            instructions += (u32)(tms9900_instructions - startInstr);  startInstr = tms9900_instructions;
+        }
+        double elapsed = Now() - start;
+        if (elapsed <= 0.0) elapsed = 1e-9;
+
+        job->crc            = file_crc;
+        job->frameHash      = HostFrameHash();
+        job->fps            = settings.numFrames / elapsed;
+        job->instructions   = instructions;
+        job->illegalOPs     = tms9900.illegalOPs;
+        job->lastIllegalOP  = tms9900.lastIllegalOP;
+        job->bRan           = 1;
+
+        if (settings.pngDir)
+        {
+            snprintf(path, sizeof(path), "%s/%s.png", settings.pngDir, job->name);
+            job->bPNG = HostFramePNG(path);
+        }
+    }
+
+    JIT_Release();
+    HostShutdown();
+    return NULL;
+}
+
+// ------------------------------------------------------------------------------------
+// A worker takes the next cart off the list, runs it on a fresh thread and waits for
+// it to finish - until there are no more carts left.
+// ------------------------------------------------------------------------------------
+static void *BatchWorker(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&jobLock);
+        u32 idx = nextJob++;
+        pthread_mutex_unlock(&jobLock);
+        if (idx >= numJobs) break;
+
+        pthread_t cartThread;
+        if (pthread_create(&cartThread, &threadAttr, BatchRunCart, &jobs[idx]) == 0)
+        {
+            pthread_join(cartThread, NULL);
+        }
+
+        pthread_mutex_lock(&jobLock);
+        doneJobs++;
+        fprintf(stderr, "[%u/%u] %-40s %s\n", doneJobs, numJobs, jobs[idx].name, jobs[idx].bRan ? "ran":"FAILED");
+        pthread_mutex_unlock(&jobLock);
+    }
+    return NULL;
+}
+
+// ------------------------------------------------------------------------------------
+// Read back an earlier CSV - we only need the cart name, frame hash and frames/sec.
+// The cart name is always the first column and always quoted.
+// ------------------------------------------------------------------------------------
+static u32 BatchReadBaseline(const char *csvFile, BatchBaseline_t **ppBase)
+{
+    FILE *fp = fopen(csvFile, "r");
+    char line[1024];
+    u32 count = 0, maxCount = 0;
+    BatchBaseline_t *base = NULL;
+
+    if (!fp) return 0;
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (line[0] != '"') continue;                  // Skip the header (and anything else odd)
+        char *end = strchr(line+1, '"');
+        if (!end || (end[1] != ',') || ((end - line) > BATCH_MAX_NAME)) continue;
+        *end = 0;
+
+        unsigned int crc, hash, frames;
+        double fps;
+        if (sscanf(end+2, "%x,%u,%x,%lf", &crc, &frames, &hash, &fps) != 4) continue;
+
+        if (count == maxCount)
+        {
+            maxCount = maxCount ? maxCount*2 : 256;
+            base = realloc(base, maxCount * sizeof(BatchBaseline_t));
+        }
+        strcpy(base[count].name, line+1);
+        base[count].frameHash = hash;
+        base[count].fps = fps;
+        count++;
+    }
+    fclose(fp);
+
+    *ppBase = base;
+    return count;
+}
+
+int main(int argc, char **argv)
+{
+    const char *keyScript = NULL;
+    const char *csvFile = NULL;
+    const char *baseFile = NULL;
+    double slowerPct = 20.0;
+    long numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+
+    memset(&settings, 0x00, sizeof(settings));
+    settings.biosDir = ".";
+    settings.numFrames = 600;
+    settings.bDSi = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:n:w:k:lsf:jp:o:i:r:x:vh")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b': settings.biosDir = optarg; break;
+            case 'n': settings.numFrames = (u32)strtoul(optarg, NULL, 10); break;
+            case 'w': settings.warmFrames = (u32)strtoul(optarg, NULL, 10); break;
+            case 'k': keyScript = optarg; break;
+            case 'l': settings.bDSi = 0; break;
+            case 's': settings.bSAMS = 1; break;
+            case 'f': settings.frameSkip = atoi(optarg); break;
+            case 'j': settings.bJIT = 1; break;
+            case 'p': numThreads = atol(optarg); break;
+            case 'o': csvFile = optarg; break;
+            case 'i': settings.pngDir = optarg; break;
+            case 'r': baseFile = optarg; break;
+            case 'x': slowerPct = atof(optarg); break;
+            case 'v': host_verbose = 1; break;
+            default:  Usage(); return 1;
+        }
+    }
+
+    if (optind >= argc) {Usage(); return 1;}
+    settings.cartDir = argv[optind];
+    if (numThreads < 1) numThreads = 1;
+
+    if (!HostParseKeyScript(keyScript, &settings.script))
+    {
+        fprintf(stderr, "Bad key script: %s\n", keyScript);
+        return 1;
+    }
+
+    if (!BatchFindCarts(settings.cartDir))
+    {
+        fprintf(stderr, "No carts found in %s\n", settings.cartDir);
+        return 1;
+    }
+
+    BatchBaseline_t *base = NULL;
+    u32 numBase = 0;
+    if (baseFile && !(numBase = BatchReadBaseline(baseFile, &base)))
+    {
+        fprintf(stderr, "Unable to read baseline %s\n", baseFile);
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if (csvFile && !(out = fopen(csvFile, "w")))
+    {
+        fprintf(stderr, "Unable to create %s\n", csvFile);
+        return 1;
+    }
+
+    // -------------------------------------------------------------
+    // Start the workers and wait for them to get through the list
+    // -------------------------------------------------------------
+    if (numThreads > numJobs) numThreads = numJobs;
+    pthread_attr_init(&threadAttr);
+    pthread_attr_setstacksize(&threadAttr, BATCH_STACK_SIZE);
+
+    pthread_t *workers = malloc(numThreads * sizeof(pthread_t));
+    double start = Now();
+    for (long i=0; i < numThreads; i++) pthread_create(&workers[i], &threadAttr, BatchWorker, NULL);
+    for (long i=0; i < numThreads; i++) pthread_join(workers[i], NULL);
+    double elapsed = Now() - start;
+    free(workers);
+    pthread_attr_destroy(&threadAttr);
+
+    // -------------------------------------------------------------
+    // Results in cart order - and against the baseline if we have one
+    // -------------------------------------------------------------
+    u32 numChanged = 0, numSlower = 0, numFailed = 0;
+    fprintf(out, "cart,file_crc,frames,frame_hash,fps,instructions,illegal_ops,last_illegal_op,png,status\n");
+    for (u32 i=0; i < numJobs; i++)
+    {
+        BatchJob_t *job = &jobs[i];
+
+        if (!job->bRan) {job->status = "error"; numFailed++;}
+        else if (!baseFile) job->status = "ok";
+        else
+        {
+            job->status = "new";
+            for (u32 j=0; j < numBase; j++)
+            {
+                if (strcmp(base[j].name, job->name) != 0) continue;
+                if (base[j].frameHash != job->frameHash)                       {job->status = "changed"; numChanged++;}
+                else if (job->fps < base[j].fps * (1.0 - slowerPct/100.0))    {job->status = "slower";  numSlower++;}
+                else job->status = "same";
+                break;
+            }
+        }
+
+        fprintf(out, "\"%s\",%08X,%u,%08X,%.1f,%llu,%u,%04X,%s,%s\n", job->name, job->crc, settings.numFrames,
+                job->frameHash, job->fps, (unsigned long long)job->instructions, job->illegalOPs, job->lastIllegalOP,
+                job->bPNG ? "yes":"no", job->status);
+    }
+    if (out != stdout) fclose(out);
+
+    fprintf(stderr, "%u carts in %.1f sec on %ld threads - %u failed", numJobs, elapsed, numThreads, numFailed);
+    if (baseFile) fprintf(stderr, ", %u changed, %u slower", numChanged, numSlower);
+    fprintf(stderr, "\n");
+
+    free(base);
+    free(jobs);
+
+    return (numChanged || numSlower) ? 1:0;
+}
+
+// End of file
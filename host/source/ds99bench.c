@@ -0,0 +1,221 @@
+// =====================================================================================
+// Copyright (c) 2023-2025 Dave Bernazzani (wavemotion-dave)
+//
+// Copying and distribution of this emulator, its source code and associated
+// readme files, with or without modification, are permitted in any medium without
+// royalty provided this copyright notice is used and wavemotion-dave is thanked profusely.
+//
+// The DS994a emulator is offered as-is, without any warranty.
+//
+// Please see the README.md file as it contains much useful info.
+// =====================================================================================
+
+// ------------------------------------------------------------------------------------
+// ds99bench - boots a cart headless on the Linux host and runs the emulation core as
+// fast as it will go for a number of frames. Reports emulated frames/sec along with
+// TMS9900 instructions/sec and cycles/sec so we have a repeatable number to compare
+// every change to TMS9900_Run() and Loop9918() against. The final frame CRC lets us
+// tell at a glance whether a change altered the emulated output.
+// ------------------------------------------------------------------------------------
+#include <nds.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "DS99.h"
+#include "DS99mngt.h"
+#include "DS99_utils.h"
+#include "cpu/tms9900/tms9901.h"
+#include "cpu/tms9900/tms9900.h"
+#include "cpu/tms9918a/tms9918a.h"
+#include "host_platform.h"
+#include "tms9900_jit.h"
+
+extern MACHINE_LOCAL u32 file_crc;
+
+static void Usage(void)
+{
+    fprintf(stderr,
+        "Usage: ds99bench [options] <cart.bin|cart.rpk>\n"
+        "  -b <dir>     Directory holding 994aROM.bin, 994aGROM.bin (and optional 994aDISK.bin). Default: .\n"
+        "  -n <frames>  Number of frames to time (default 3600)\n"
+        "  -w <frames>  Warm-up frames run before timing starts (default 0)\n"
+        "  -k <script>  Scripted key presses as frame:KEY pairs, e.g. 90:SPACE,150:2\n"
+        "  -l           Emulate a DS-Lite/Phat (smaller cart/SAMS memory, no RAM mirrors)\n"
+        "  -s           Force the 32K+SAMS machine type\n"
+        "  -f <0|1|2>   Frame skip setting (default 0 - render every frame)\n"
+        "  -t           Print a per-frame trace line (frame, PC, cycles, frame CRC)\n"
+        "  -j           Run the fast core through the x86-64 JIT (the accurate core is unaffected)\n"
+        "  -v           Verbose - show messages the emulator would print on the DS\n");
+}
+
+#ifdef TMS9900_PAIR_HISTOGRAM
+// ------------------------------------------------------------------------------------
+// Built with make PAIR_HISTOGRAM=1 - print the most common back to back instruction
+// pairs (within a block) so we know which pairs are worth a fused handler.
+// ------------------------------------------------------------------------------------
+#define OPNAME(op)              [op] = #op,
+#define OPNAME_FORMAT1(op)      OPNAME(op) OPNAME(op##_RR) OPNAME(op##_IR) OPNAME(op##_RI) OPNAME(op##_II)
+
+static const char *OpNames[256] =
+{
+    OPNAME(op_bad)  OPNAME(op_sra)  OPNAME(op_srl)  OPNAME(op_sla)  OPNAME(op_src)  OPNAME(op_li)   OPNAME(op_ai)
+    OPNAME(op_andi) OPNAME(op_ori)  OPNAME(op_ci)   OPNAME(op_stwp) OPNAME(op_stst) OPNAME(op_lwpi) OPNAME(op_limi)
+    OPNAME(op_idle) OPNAME(op_rset) OPNAME(op_rtwp) OPNAME(op_ckon) OPNAME(op_ckof) OPNAME(op_lrex) OPNAME(op_blwp)
+    OPNAME(op_b)    OPNAME(op_x)    OPNAME(op_clr)  OPNAME(op_neg)  OPNAME(op_inv)  OPNAME(op_inc)  OPNAME(op_inct)
+    OPNAME(op_dec)  OPNAME(op_dect) OPNAME(op_bl)   OPNAME(op_swpb) OPNAME(op_seto) OPNAME(op_abs)  OPNAME(op_jmp)
+    OPNAME(op_jlt)  OPNAME(op_jle)  OPNAME(op_jeq)  OPNAME(op_jhe)  OPNAME(op_jgt)  OPNAME(op_jne)  OPNAME(op_jnc)
+    OPNAME(op_joc)  OPNAME(op_jno)  OPNAME(op_jl)   OPNAME(op_jh)   OPNAME(op_jop)  OPNAME(op_sbo)  OPNAME(op_sbz)
+    OPNAME(op_tb)   OPNAME(op_coc)  OPNAME(op_czc)  OPNAME(op_xor)  OPNAME(op_xop)  OPNAME(op_ldcr) OPNAME(op_stcr)
+    OPNAME(op_mpy)  OPNAME(op_div)
+    OPNAME_FORMAT1(op_szc)  OPNAME_FORMAT1(op_szcb) OPNAME_FORMAT1(op_s)    OPNAME_FORMAT1(op_sb)
+    OPNAME_FORMAT1(op_c)    OPNAME_FORMAT1(op_cb)   OPNAME_FORMAT1(op_a)    OPNAME_FORMAT1(op_ab)
+    OPNAME_FORMAT1(op_mov)  OPNAME_FORMAT1(op_movb) OPNAME_FORMAT1(op_soc)  OPNAME_FORMAT1(op_socb)
+};
+
+static void PrintPairHistogram(u32 numPairs)
+{
+    u64 total = 0;
+    for (u32 i=0; i < 256*256; i++) total += TMS9900_PairHistogram[i>>8][i&0xFF];
+    if (!total) return;
+
+    printf("Top opcode pairs (%llu total):\n", (unsigned long long)total);
+    for (u32 n=0; n < numPairs; n++)
+    {
+        u32 best = 0;
+        for (u32 i=1; i < 256*256; i++)
+        {
+            if (TMS9900_PairHistogram[i>>8][i&0xFF] > TMS9900_PairHistogram[best>>8][best&0xFF]) best = i;
+        }
+        u32 count = TMS9900_PairHistogram[best>>8][best&0xFF];
+        if (!count) break;
+        printf("  %-12s %-12s %10u  %5.2f%%\n", OpNames[best>>8] ? OpNames[best>>8]:"?", OpNames[best&0xFF] ? OpNames[best&0xFF]:"?",
+               count, (100.0 * count) / total);
+        TMS9900_PairHistogram[best>>8][best&0xFF] = 0;
+    }
+}
+#endif
+
+static double Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    const char *biosDir = ".";
+    const char *keyScript = NULL;
+    u32 numFrames = 3600;
+    u32 warmFrames = 0;
+    u8  bDSi = 1;
+    u8  bSAMS = 0;
+    u8  bTrace = 0;
+    u8  bJIT = 0;
+    int frameSkip = 0;
+    HostKeyScript_t script;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:n:w:k:lsf:tjvh")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b': biosDir = optarg; break;
+            case 'n': numFrames = (u32)strtoul(optarg, NULL, 10); break;
+            case 'w': warmFrames = (u32)strtoul(optarg, NULL, 10); break;
+            case 'k': keyScript = optarg; break;
+            case 'l': bDSi = 0; break;
+            case 's': bSAMS = 1; break;
+            case 'f': frameSkip = atoi(optarg); break;
+            case 't': bTrace = 1; break;
+            case 'j': bJIT = 1; break;
+            case 'v': host_verbose = 1; break;
+            default:  Usage(); return 1;
+        }
+    }
+
+    if (optind >= argc) {Usage(); return 1;}
+    char *cart = argv[optind];
+
+    if (!HostParseKeyScript(keyScript, &script))
+    {
+        fprintf(stderr, "Bad key script: %s\n", keyScript);
+        return 1;
+    }
+
+    FILE *fp = fopen(cart, "rb");
+    if (!fp) {fprintf(stderr, "Unable to open cart %s\n", cart); return 1;}
+    fclose(fp);
+
+    if (!HostStartup(bDSi)) return 1;
+
+    if (!HostLoadBIOSFiles(biosDir))
+    {
+        fprintf(stderr, "994aROM.bin and 994aGROM.bin are required in %s\n", biosDir);
+        return 1;
+    }
+
+    // -------------------------------------------------------------
+    // Same order of operations as the DS when a game is picked...
+    // -------------------------------------------------------------
+    if (bSAMS) globalConfig.machineType = MACH_TYPE_SAMS;
+    globalConfig.frameSkip = frameSkip;
+    HostSetGameConfig(cart);
+    TI99Init(cart, 1);
+
+    if (bJIT && !JIT_Enable())
+    {
+        fprintf(stderr, "JIT not available on this host - running the interpreter\n");
+        bJIT = 0;
+    }
+
+    u32 frame = 0;
+    for (; frame < warmFrames; frame++)
+    {
+        HostApplyKeyScript(&script, frame);
+        while (LoopTMS9900()) ;
+        if (++timingFrames == (myConfig.isPAL ? 50:60)) timingFrames = 0;
+    }
+
+    u32 startInstr  = tms9900_instructions;
+    u32 startCycles = tms9900.cycles;
+    u64 instructions = 0;
+    u64 cycles = 0;
+
+    double start = Now();
+    for (u32 i=0; i < numFrames; i++, frame++)
+    {
+        HostApplyKeyScript(&script, frame);
+        while (LoopTMS9900()) ;
+        if (++timingFrames == (myConfig.isPAL ? 50:60)) timingFrames = 0;
+
+        // Accumulate in 64-bit so long runs don't wrap the 32-bit counters
+        instructions += (u32)(tms9900_instructions - startInstr);  startInstr  = tms9900_instructions;
+        cycles       += (u32)(tms9900.cycles - startCycles);        startCycles = tms9900.cycles;
+
+        if (bTrace) printf("frame %6u  PC=%04X WP=%04X ST=%04X cycles=%llu crc=%08X\n", frame,
+                           (u16)tms9900.PC, (u16)tms9900.WP, (u16)tms9900.ST, (unsigned long long)cycles, HostFrameHash());
+    }
+    double elapsed = Now() - start;
+    if (elapsed <= 0.0) elapsed = 1e-9;
+
+    printf("Cart:          %s (CRC %08X)\n", cart, file_crc);
+    printf("Frames:        %u in %.3f sec\n", numFrames, elapsed);
+    printf("Frames/sec:    %.1f (%.1fx real time)\n", numFrames / elapsed, (numFrames / elapsed) / (myConfig.isPAL ? 50.0:60.0));
+    printf("Instr/sec:     %.2f M (%llu total)\n", instructions / elapsed / 1e6, (unsigned long long)instructions);
+    printf("Cycles/sec:    %.2f M (%llu total)\n", cycles / elapsed / 1e6, (unsigned long long)cycles);
+    printf("Accurate core: %s (flags %02X)\n", tms9900.accurateEmuFlags ? "yes":"no", tms9900.accurateEmuFlags);
+    printf("JIT:           %s (%u blocks translated)\n", bJIT ? "yes":"no", JIT_BlocksTranslated());
+    printf("Illegal ops:   %u (last %04X)\n", tms9900.illegalOPs, tms9900.lastIllegalOP);
+    printf("Frame CRC:     %08X\n", HostFrameHash());
+#ifdef TMS9900_PAIR_HISTOGRAM
+    PrintPairHistogram(40);
+#endif
+
+    return 0;
+}
+
+// End of file
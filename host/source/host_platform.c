@@ -0,0 +1,461 @@
+// =====================================================================================
+// Copyright (c) 2023-2025 Dave Bernazzani (wavemotion-dave)
+//
+// Copying and distribution of this emulator, its source code and associated
+// readme files, with or without modification, are permitted in any medium without
+// royalty provided this copyright notice is used and wavemotion-dave is thanked profusely.
+//
+// The DS994a emulator is offered as-is, without any warranty.
+//
+// Please see the README.md file as it contains much useful info.
+// =====================================================================================
+#include <nds.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <sys/mman.h>
+#include <pthread.h>
+
+#include "DS99.h"
+#include "DS99mngt.h"
+#include "DS99_utils.h"
+#include "CRC32.h"
+#include "SAMS.h"
+#include "disk.h"
+#include "pcode.h"
+#include "speech.h"
+#include "cpu/tms9900/tms9901.h"
+#include "cpu/tms9900/tms9900.h"
+#include "cpu/tms9918a/tms9918a.h"
+#include "cpu/sn76496/SN76496.h"
+#include "host_platform.h"
+
+// ------------------------------------------------------------------------------------
+// The core uses a number of fixed DS VRAM addresses as fast general purpose memory:
+// the main frame buffer at 0x06000000 (pVidFlipBuf), the opcode lookup tables at
+// 0x06820000/0x06860000 and the BIOS, GROM and Disk DSR caches up at 0x0689A000+.
+// We simply reserve that same range of the host address space at startup so all of
+// those pointers are valid exactly as they are on the DS.
+//
+// There is only the one such range per process though - and any number of machines
+// (one per thread). The lookup tables and the console ROM caches up there are only
+// ever read once built so every machine shares them. The frame buffer is the one
+// thing a machine writes to so each machine gets its own (see HostStartup()).
+// ------------------------------------------------------------------------------------
+#define HOST_VRAM_BASE      0x06000000
+#define HOST_VRAM_SIZE      0x008A4000
+
+// ------------------------------------------------------------------------------------
+// Globals normally owned by DS99.c / DS99_utils.c which the core references...
+// ------------------------------------------------------------------------------------
+MACHINE_LOCAL u8 *SharedMemBuffer = 0;
+MACHINE_LOCAL char tmpBuf[256];
+MACHINE_LOCAL u8 fileBuf[0x2000];
+MACHINE_LOCAL u32 file_size = 0;
+MACHINE_LOCAL u16 timingFrames = 0;
+MACHINE_LOCAL u32 debug[0x10];
+
+MACHINE_LOCAL SN76496 snti99;
+
+MACHINE_LOCAL struct Config_t myConfig;
+MACHINE_LOCAL struct GlobalConfig_t globalConfig;
+
+MACHINE_LOCAL char currentDirROMs[MAX_PATH];
+MACHINE_LOCAL char currentDirDSKs[MAX_PATH];
+
+// ------------------------------------------------------------------------------------
+// And the handful of libnds / maxmod stand-ins declared in our include/ shim headers
+// ------------------------------------------------------------------------------------
+MACHINE_LOCAL u16  host_bg_palette[256];
+MACHINE_LOCAL u16  host_sprite_palette[256];
+MACHINE_LOCAL vu32 host_dummy_reg32;
+MACHINE_LOCAL vs16 host_dummy_reg16;
+MACHINE_LOCAL bool host_dsi_mode = true;
+unsigned int host_speech_effects = 0;
+
+u8 host_verbose = 0;
+
+// ------------------------------------------------------------------------------------
+// Stubs for the DS-only user interface and sound hooks the core calls into. There is
+// no bottom screen, no menu and no audio on the host so these are all quiet.
+// ------------------------------------------------------------------------------------
+void DS_Print(int iX,int iY,int iScr,char *szMessage)
+{
+    if (host_verbose)
+    {
+        // Skip the blank-out prints the UI uses to erase status messages
+        for (char *p=szMessage; *p; p++)
+        {
+            if (*p != ' ') {fprintf(stderr, "[%2d,%2d] %s\n", iX, iY, szMessage); break;}
+        }
+    }
+}
+
+void _putchar(char character)   {putchar(character);}
+void showMainMenu(void)         {}
+void processDirectAudio(void)   {}
+void MapPlayer2(void)           {}
+void SetDiagonals(void)         {}
+
+// The SN76496 is ARM assembly on the DS - the host build has no audio so we just park the chip
+void sn76496Reset(int chiptype, SN76496 *chip)  {(void)chiptype; memset(chip, 0x00, sizeof(SN76496));}
+void sn76496W(u8 data, SN76496 *chip)           {chip->snLastReg = data;}
+
+
+// ------------------------------------------------------------------------------------
+// Host version of the DS99.c ResetTI() - only the parts that touch emulated hardware.
+// The DS version also resets its hardware timers and UI key handling which we lack.
+// ------------------------------------------------------------------------------------
+void ResetTI(u8 bInitDisks)
+{
+    SpeechInit();                       // Ensure we are reading status byte for speech carts
+    SAMS_Initialize();                  // Map in SAMS if enabled
+    Reset9918();                        // Reset video chip
+
+    sn76496Reset(1, &snti99);           // Reset the SN/TI sound chip
+    sn76496W(0x90 | 0x0F  ,&snti99);    // Write new Volume for Channel A (off)
+    sn76496W(0xB0 | 0x0F  ,&snti99);    // Write new Volume for Channel B (off)
+    sn76496W(0xD0 | 0x0F  ,&snti99);    // Write new Volume for Channel C (off)
+
+    timingFrames = 0;
+    XBuf = XBuf_A;                      // Set the initial screen ping-pong buffer to A
+
+    if (bInitDisks) disk_init();        // Make sure the disk systems is up and running
+    pcode_init();                       // Make sure the p-code emulation is initialized.
+
+    memset(debug, 0x00, sizeof(debug));
+}
+
+
+// ------------------------------------------------------------------------------------
+// Process wide startup - done once no matter how many machines are started. Reserve
+// the DS VRAM address range and build the opcode and status tables that live there.
+// ------------------------------------------------------------------------------------
+static pthread_once_t hostOnce = PTHREAD_ONCE_INIT;
+static u8 bHostVRAM = 0;
+
+static void HostStartupOnce(void)
+{
+    void *vram = mmap((void*)HOST_VRAM_BASE, HOST_VRAM_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (vram != (void*)HOST_VRAM_BASE)
+    {
+        fprintf(stderr, "Unable to map DS VRAM range at 0x%08X\n", HOST_VRAM_BASE);
+        return;
+    }
+
+    TMS9900_buildopcodes();             // The opcode and status tables in VRAM are built once - same as LoadBIOSFiles() on the DS
+    bHostVRAM = 1;
+}
+
+// ------------------------------------------------------------------------------------
+// Machine startup - call once on each thread that is going to run a machine. Allocate
+// the cart and SAMS memory in the same way StartupMemoryAllocation() does on the DS/DSi
+// and give the machine a frame buffer of its own to stand in for the DS one.
+// ------------------------------------------------------------------------------------
+u8 HostStartup(u8 bDSi)
+{
+    pthread_once(&hostOnce, HostStartupOnce);
+    if (!bHostVRAM) return 0;
+
+    host_dsi_mode = bDSi;
+
+    pVidFlipBuf = malloc(256*256);
+    memset(pVidFlipBuf, 0x00, 256*256);
+
+    SharedMemBuffer = malloc(768*1024);
+    memset(SharedMemBuffer, 0x00, 768*1024);
+
+    if (isDSiMode())
+    {
+        theSAMS.numBanks = 256;                         // 256 * 4K = 1024K for DSi
+        MemSAMS = malloc((theSAMS.numBanks) * 0x1000);  // Allocate the SAMS memory
+
+        MAX_CART_SIZE = (u32)(8192 * 1024);             // 8MB (8192K) Max Cart for DSi
+        MemCART = malloc(MAX_CART_SIZE);                // Allocate the Cartridge Buffer
+    }
+    else
+    {
+        theSAMS.numBanks = 128;                         // 128 * 4K = 512K for DS-Lite/Phat
+        MemSAMS = SharedMemBuffer + (256 * 1024);       // Set the SAMS memory area
+
+        MAX_CART_SIZE = (u32)(512 * 1024);              // 512K Max Cart for DS-Lite/Phat
+        MemCART = SharedMemBuffer;                      // Set the Cartridge Buffer
+    }
+
+    memset(&globalConfig, 0x00, sizeof(globalConfig));
+    globalConfig.frameSkip = (isDSiMode() ? 0:1);       // Same as the DS defaults
+
+    return 1;
+}
+
+
+// ------------------------------------------------------------------------------------
+// Machine shutdown - the other half of HostStartup(). Hands back the memory this
+// thread's machine allocated so a thread can finish without leaking it.
+// ------------------------------------------------------------------------------------
+void HostShutdown(void)
+{
+    if (isDSiMode())
+    {
+        free(MemSAMS);
+        free(MemCART);
+    }
+    free(SharedMemBuffer);
+    free(pVidFlipBuf);
+
+    MemSAMS = NULL;
+    MemCART = NULL;
+    SharedMemBuffer = NULL;
+    pVidFlipBuf = NULL;
+}
+
+
+// ------------------------------------------------------------------------------------
+// Load the console ROM, GROM and (optional) Disk DSR from the given directory into
+// the same VRAM caches LoadBIOSFiles() uses on the DS. Returns 0 if either of the
+// two required console files is missing. The caches are shared by every machine in
+// the process so only the first call loads anything - the rest get the same answer.
+// ------------------------------------------------------------------------------------
+static u8 HostLoadFile(const char *biosDir, const char *name, u16 *dest, u32 size)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", biosDir, name);
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return 0;
+    fread(SharedMemBuffer, 1, size, fp);
+    memcpy(dest, SharedMemBuffer, size);
+    fclose(fp);
+    return 1;
+}
+
+static pthread_mutex_t biosLock = PTHREAD_MUTEX_INITIALIZER;
+static u8 bBIOSLoaded = 0;
+static u8 bBIOSFound = 0;
+
+u8 HostLoadBIOSFiles(const char *biosDir)
+{
+    pthread_mutex_lock(&biosLock);
+    if (bBIOSLoaded)
+    {
+        pthread_mutex_unlock(&biosLock);
+        return bBIOSFound;
+    }
+
+    u8 bFound = 1;
+    if (!HostLoadFile(biosDir, "994aROM.bin",  MAIN_BIOS, 0x2000)) bFound = 0;
+    if (!HostLoadFile(biosDir, "994aGROM.bin", MAIN_GROM, 0x6000)) bFound = 0;
+    if (!HostLoadFile(biosDir, "994aDISK.bin", DISK_DSR,  0x2000))
+    {
+        if (!HostLoadFile(biosDir, "disk.bin", DISK_DSR,  0x2000)) memset(DISK_DSR, 0xFF, 0x2000);
+    }
+    memset(SharedMemBuffer, 0x00, 768*1024);
+
+    bBIOSLoaded = 1;
+    bBIOSFound = bFound;
+    pthread_mutex_unlock(&biosLock);
+    return bFound;
+}
+
+
+// ------------------------------------------------------------------------------------
+// The subset of SetDefaultGameConfig() that changes emulated behavior - key maps and
+// other DS user interface options are not relevant here. The per-game quirks come from
+// ApplyGameQuirks() just as they do on the DS. Must be called before TI99Init() so
+// that the machine and cart type are known at load time.
+// ------------------------------------------------------------------------------------
+void HostSetGameConfig(const char *cartPath)
+{
+    file_crc = getFileCrc(cartPath);
+
+    memset(&myConfig, 0x00, sizeof(myConfig));
+    myConfig.game_crc    = file_crc;
+    myConfig.frameSkip   = globalConfig.frameSkip;
+    myConfig.maxSprites  = globalConfig.maxSprites;
+    myConfig.RAMMirrors  = (isDSiMode() ? 1:0);    // For DSi we enable the RAM mirrors
+    myConfig.machineType = globalConfig.machineType;
+    myConfig.reservedO   = 1;
+    myConfig.reservedP   = 1;
+    myConfig.reservedQ   = 0xFF;
+    myConfig.reservedY   = 0xFF;
+    myConfig.reservedZ   = 0xFF;
+
+    ApplyGameQuirks(cartPath);
+}
+
+
+// ------------------------------------------------------------------------------------
+// Scripted input - a comma separated list of frame:KEY pairs such as "90:SPACE,150:2"
+// which presses SPACE on frame 90 (to leave the title screen) and then '2' on frame
+// 150 (to pick the cart from the console menu). Each key is held for a few frames.
+// ------------------------------------------------------------------------------------
+static const struct {const char *name; u8 key;} HostKeyNames[] =
+{
+    {"ENTER",   TMS_KEY_ENTER},     {"SHIFT",   TMS_KEY_SHIFT},     {"CTRL",    TMS_KEY_CONTROL},
+    {"FCTN",    TMS_KEY_FUNCTION},  {"SPACE",   TMS_KEY_SPACE},     {"PERIOD",  TMS_KEY_PERIOD},
+    {"COMMA",   TMS_KEY_COMMA},     {"SLASH",   TMS_KEY_SLASH},     {"SEMI",    TMS_KEY_SEMI},
+    {"EQUALS",  TMS_KEY_EQUALS},
+    {"UP",      TMS_KEY_JOY1_UP},   {"DOWN",    TMS_KEY_JOY1_DOWN}, {"LEFT",    TMS_KEY_JOY1_LEFT},
+    {"RIGHT",   TMS_KEY_JOY1_RIGHT},{"FIRE",    TMS_KEY_JOY1_FIRE},
+    {"UP2",     TMS_KEY_JOY2_UP},   {"DOWN2",   TMS_KEY_JOY2_DOWN}, {"LEFT2",   TMS_KEY_JOY2_LEFT},
+    {"RIGHT2",  TMS_KEY_JOY2_RIGHT},{"FIRE2",   TMS_KEY_JOY2_FIRE},
+};
+
+static u8 HostKeyFromName(const char *name)
+{
+    if (name[0] && !name[1])
+    {
+        char c = toupper(name[0]);
+        if (c >= 'A' && c <= 'Z') return TMS_KEY_A + (c-'A');
+        if (c >= '1' && c <= '9') return TMS_KEY_1 + (c-'1');
+        if (c == '0')             return TMS_KEY_0;
+    }
+    for (u16 i=0; i<sizeof(HostKeyNames)/sizeof(HostKeyNames[0]); i++)
+    {
+        if (strcasecmp(name, HostKeyNames[i].name) == 0) return HostKeyNames[i].key;
+    }
+    return TMS_KEY_NONE;
+}
+
+u8 HostParseKeyScript(const char *script, HostKeyScript_t *pScript)
+{
+    char buf[1024];
+    pScript->count = 0;
+    if (!script) return 1;
+
+    strncpy(buf, script, sizeof(buf)-1); buf[sizeof(buf)-1] = 0;
+    for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ","))
+    {
+        char *colon = strchr(tok, ':');
+        if (!colon || (pScript->count >= HOST_MAX_KEY_EVENTS)) return 0;
+        *colon = 0;
+        u8 key = HostKeyFromName(colon+1);
+        if (key == TMS_KEY_NONE) return 0;
+        pScript->event[pScript->count].frame = (u32)strtoul(tok, NULL, 10);
+        pScript->event[pScript->count].key = key;
+        pScript->count++;
+    }
+    return 1;
+}
+
+void HostApplyKeyScript(const HostKeyScript_t *pScript, u32 frame)
+{
+    TMS9901_ClearJoyKeyData();
+    for (u16 i=0; i<pScript->count; i++)
+    {
+        if ((frame >= pScript->event[i].frame) && (frame < pScript->event[i].frame + HOST_KEY_HOLD_FRAMES))
+        {
+            tms9901.Keyboard[pScript->event[i].key] = 1;
+        }
+    }
+}
+
+
+// ------------------------------------------------------------------------------------
+// CRC32 of the rendered 256x192 frame - a cheap way to tell if two runs produced the
+// same picture. Uses the same CRC table as the file CRC in CRC32.c
+// ------------------------------------------------------------------------------------
+u32 HostFrameHash(void)
+{
+    extern const u32 crc32_table[256];
+    u32 crc = 0xFFFFFFFF;
+    for (u32 i=0; i<256*192; i++)
+    {
+        crc = (crc >> 8) ^ crc32_table[(crc & 0xFF) ^ XBuf[i]];
+    }
+    return ~crc;
+}
+
+
+// ------------------------------------------------------------------------------------
+// Write the rendered 256x192 frame out as a PNG so a run can be looked at afterwards.
+// XBuf holds one TMS9918a colour index per pixel which maps straight onto an 8-bit
+// palette image. To keep the host build free of zlib the image data goes out as a
+// single 'stored' (uncompressed) deflate block - about 48K per frame which is fine.
+// ------------------------------------------------------------------------------------
+static u32 HostPNGCRC(u32 crc, const u8 *data, u32 len)
+{
+    extern const u32 crc32_table[256];
+    while (len--) crc = (crc >> 8) ^ crc32_table[(crc & 0xFF) ^ *data++];
+    return crc;
+}
+
+static void HostPNGPut32(u8 *p, u32 val)
+{
+    p[0] = val >> 24; p[1] = val >> 16; p[2] = val >> 8; p[3] = val;
+}
+
+static void HostPNGChunk(FILE *fp, const char *type, const u8 *data, u32 len)
+{
+    u8 hdr[8];
+    HostPNGPut32(hdr, len);
+    memcpy(hdr+4, type, 4);
+    u32 crc = HostPNGCRC(0xFFFFFFFF, hdr+4, 4);
+    crc = ~HostPNGCRC(crc, data, len);
+    fwrite(hdr, 1, 8, fp);
+    fwrite(data, 1, len, fp);
+    HostPNGPut32(hdr, crc);
+    fwrite(hdr, 1, 4, fp);
+}
+
+#define PNG_WIDTH       256
+#define PNG_HEIGHT      192
+#define PNG_ROW         (PNG_WIDTH+1)                   // Each row starts with its filter type (0 = none)
+#define PNG_RAW         (PNG_ROW*PNG_HEIGHT)            // 49344 bytes - fits in one stored block (max 65535)
+
+u8 HostFramePNG(const char *path)
+{
+    static const u8 signature[8] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+    u8 ihdr[13];
+    u8 plte[16*3];
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp) return 0;
+
+    HostPNGPut32(ihdr+0, PNG_WIDTH);
+    HostPNGPut32(ihdr+4, PNG_HEIGHT);
+    ihdr[8]  = 8;                       // 8 bits per pixel
+    ihdr[9]  = 3;                       // Colour type 3 - palette indexed
+    ihdr[10] = 0;                       // Deflate
+    ihdr[11] = 0;                       // Adaptive filtering (we only use filter 0)
+    ihdr[12] = 0;                       // Not interlaced
+
+    memcpy(plte, TMS9918A_palette, sizeof(plte));
+
+    // zlib header + one stored deflate block + adler32 of the raw rows
+    u8 *idat = malloc(2 + 5 + PNG_RAW + 4);
+    u8 *p = idat;
+    *p++ = 0x78; *p++ = 0x01;           // Deflate with 32K window, no dictionary, check bits ok
+    *p++ = 0x01;                        // Final block, stored
+    *p++ = PNG_RAW & 0xFF;  *p++ = PNG_RAW >> 8;
+    *p++ = ~PNG_RAW & 0xFF; *p++ = (~PNG_RAW >> 8) & 0xFF;
+
+    u32 a = 1, b = 0;
+    for (u32 y=0; y<PNG_HEIGHT; y++)
+    {
+        for (u32 x=0; x<PNG_ROW; x++)
+        {
+            u8 pixel = x ? (XBuf[y*PNG_WIDTH + (x-1)] & 0x0F) : 0;
+            *p++ = pixel;
+            a = (a + pixel) % 65521;
+            b = (b + a) % 65521;
+        }
+    }
+    HostPNGPut32(p, (b << 16) | a); p += 4;
+
+    fwrite(signature, 1, sizeof(signature), fp);
+    HostPNGChunk(fp, "IHDR", ihdr, sizeof(ihdr));
+    HostPNGChunk(fp, "PLTE", plte, sizeof(plte));
+    HostPNGChunk(fp, "IDAT", idat, (u32)(p - idat));
+    HostPNGChunk(fp, "IEND", NULL, 0);
+    free(idat);
+
+    u8 bOK = !ferror(fp);
+    if (fclose(fp)) bOK = 0;
+    return bOK;
+}
+
+// End of file
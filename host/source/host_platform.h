@@ -0,0 +1,57 @@
+// =====================================================================================
+// Copyright (c) 2023-2025 Dave Bernazzani (wavemotion-dave)
+//
+// Copying and distribution of this emulator, its source code and associated
+// readme files, with or without modification, are permitted in any medium without
+// royalty provided this copyright notice is used and wavemotion-dave is thanked profusely.
+//
+// The DS994a emulator is offered as-is, without any warranty.
+//
+// Please see the README.md file as it contains much useful info.
+// =====================================================================================
+#ifndef _HOST_PLATFORM_H_
+#define _HOST_PLATFORM_H_
+
+#include <nds.h>
+
+// ------------------------------------------------------------------------------
+// The host platform layer stands in for the DS side of things (DS99.c and the
+// libnds/maxmod/libfat runtime) so that the emulation core can be driven from
+// a plain Linux command line tool with no screen, no sound and no stylus.
+//
+// Any number of machines can run at once in the one process - one per thread. The
+// machine state is all thread-local on the host (see MACHINE_LOCAL in DS99.h) so
+// each thread calls HostStartup() and everything after that (HostLoadBIOSFiles(),
+// TI99Init(), LoopTMS9900(), JIT_Enable()...) acts on that thread's machine only.
+// A thread that is done with its machine calls JIT_Release() and HostShutdown().
+// ------------------------------------------------------------------------------
+
+#define HOST_MAX_KEY_EVENTS     64
+#define HOST_KEY_HOLD_FRAMES    6       // How long a scripted key is held down - long enough for the console KSCAN to see it
+
+typedef struct
+{
+    u32 frame;                          // Frame on which the key goes down
+    u8  key;                            // TMS_KEY_xxx index into tms9901.Keyboard[]
+} HostKeyEvent_t;
+
+typedef struct
+{
+    u16             count;
+    HostKeyEvent_t  event[HOST_MAX_KEY_EVENTS];
+} HostKeyScript_t;
+
+extern u8  HostStartup(u8 bDSi);
+extern void HostShutdown(void);
+extern u8  HostLoadBIOSFiles(const char *biosDir);
+extern void HostSetGameConfig(const char *cartPath);
+extern u8  HostParseKeyScript(const char *script, HostKeyScript_t *pScript);
+extern void HostApplyKeyScript(const HostKeyScript_t *pScript, u32 frame);
+extern u32 HostFrameHash(void);
+extern u8  HostFramePNG(const char *path);
+
+extern u8 host_verbose;
+
+#endif // _HOST_PLATFORM_H_
+
+// End of file
@@ -0,0 +1,1126 @@
+// =====================================================================================
+// Copyright (c) 2023-2025 Dave Bernazzani (wavemotion-dave)
+//
+// Copying and distribution of this emulator, its source code and associated
+// readme files, with or without modification, are permitted in any medium without
+// royalty provided this copyright notice is used and wavemotion-dave is thanked profusely.
+//
+// The DS994a emulator is offered as-is, without any warranty.
+//
+// Please see the README.md file as it contains much useful info.
+// =====================================================================================
+
+// ------------------------------------------------------------------------------------------------------
+// A simple x86-64 translator for the TMS9900 - host build only, for the long headless batch runs where
+// the interpreter is the bottleneck. It sits right on top of the block cache in tms9900.c: the block
+// cache decides what a block is, when it goes stale (self-modifying code, bank switches, DSR paging) and
+// what the fetch penalties are... we just turn each cached block into a straight run of x86-64 code.
+//
+// Most of the instruction set is translated directly - the addressing modes, the Format I two operand
+// instructions, the single operand instructions, shifts, jumps and the immediates. The odd ones (CRU,
+// BLWP/RTWP, X, MPY/DIV and so on) call back into TMS9900_ExecutePreDecoded() which runs the regular
+// handler from tms9900.inc. Plain memory accesses go straight through the page table inline and the
+// devices go through MemoryRead16() and friends so the handlers and the wait-state penalties are
+// exactly what the interpreter does, the cycle counts are added at the same points and we check the
+// cycle count (and whether something has asked us to exit the block) after every instruction just
+// like the interpreter does.
+//
+// SAMS banks are just more pages in the page table so SAMS code is translated like any other RAM
+// code - a bank switch drops the RAM blocks (see TMS9900_SAMSBankChanged()) and we follow along.
+// ------------------------------------------------------------------------------------------------------
+#include <nds.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "DS99_utils.h"
+#include "cpu/tms9900/tms9900.h"
+#include "tms9900_jit.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <sys/mman.h>
+
+#define JIT_CODE_SIZE       (8*1024*1024)   // Plenty for thousands of blocks... if we ever fill it we just start over
+#define JIT_MAX_BLOCK_CODE  16384           // Comfortably more than the worst case size of one translated block (15 instructions)
+#define JIT_TABLE_SIZE      32768           // One per word of the 64K address space - must be a power of 2
+
+#define CompareZeroLookup16 ((u16*)0x06860000)  // Same fixed (VRAM) address the core uses - see tms9900.c
+
+#define MODE_REG    0       // Rx
+#define MODE_IND    1       // *Rx
+#define MODE_SYM    2       // @yyyy(Rx) or @yyyy
+#define MODE_INC    3       // *Rx+
+
+// ----------------------------------------------------------------------------------------------------
+// One translated block. The block cache only has 512 slots and blocks that share a slot will bump
+// each other out over and over - that's cheap for the block cache but translating is not. So we
+// keep a much larger table of translations, indexed by where the code came from, with the same
+// source/epoch test the block cache uses to know a translation is still good. If it isn't, we ask
+// the block cache and if the code turns out to be unchanged we keep the translation we have. We
+// keep our own copy of the instructions since the calls back into the interpreter point at them.
+// ----------------------------------------------------------------------------------------------------
+typedef struct
+{
+    u8                 *code;               // Must stay first - the dispatch in the generated code jumps through [rdx]
+    u8                 *source;             // Host address of the first instruction word - same as the block cache
+    u32                 flushes;            // TMS9900_BlockFlushes when this was translated
+    u16                 epoch;              // Zero for ROM blocks... otherwise must match blockEpoch
+    u8                  numInstr;
+    TMS9900_PreDecode   instr[BLOCK_MAX_INSTR];
+} JitBlock_t;
+
+static MACHINE_LOCAL JitBlock_t   JitBlocks[JIT_TABLE_SIZE];
+static MACHINE_LOCAL u8          *JitCodeBuf = NULL;
+static MACHINE_LOCAL u32          JitCodeStart = 0;       // The entry stub lives below this
+static MACHINE_LOCAL u32          JitCodeUsed = 0;
+static MACHINE_LOCAL u32          JitTranslated = 0;
+
+static MACHINE_LOCAL u8          *pEmit;                  // Where the next byte of code goes
+static MACHINE_LOCAL u8           bCalledOut;             // Did the instruction we just emitted call out to C?
+
+// Offsets into the TMS9900 struct - all of these fit in a signed 8-bit displacement from RBX
+#define OFS_PC          ((u8)offsetof(TMS9900, PC))
+#define OFS_WP          ((u8)offsetof(TMS9900, WP))
+#define OFS_ST          ((u8)offsetof(TMS9900, ST))
+#define OFS_CYCLES      ((u8)offsetof(TMS9900, cycles))
+#define OFS_CURRENTOP   ((u8)offsetof(TMS9900, currentOp))
+#define OFS_SRC         ((u8)offsetof(TMS9900, srcAddress))
+#define OFS_DST         ((u8)offsetof(TMS9900, dstAddress))
+
+// ------------------------------------------------------------------------------------------------------
+// Register usage in the generated code. Everything is a callee-saved register so it survives calls
+// back into the C side of the emulator:
+//    RBX = &tms9900    EBP = source operand    R12D = eventNext    R13 = &tms9900_instructions
+//    R14 = MemCPU      R15 = &blockExit
+// EAX, ECX, EDX, ESI, EDI and R8D are scratch. ESI/EDI are set up as the arguments for the memory calls.
+// ------------------------------------------------------------------------------------------------------
+static inline void E8(u8 b)     {*pEmit++ = b;}
+static inline void E16(u16 w)   {memcpy(pEmit, &w, 2); pEmit += 2;}
+static inline void E32(u32 d)   {memcpy(pEmit, &d, 4); pEmit += 4;}
+static inline void E64(u64 q)   {memcpy(pEmit, &q, 8); pEmit += 8;}
+
+static void EmitCall(void *fn)                      {E8(0x48); E8(0xB8); E64((u64)(uintptr_t)fn); E8(0xFF); E8(0xD0); bCalledOut = 1;}   // movabs rax,fn / call rax
+static void EmitAddMem(u8 ofs, u32 imm)             // add dword [rbx+ofs], imm
+{
+    if (imm < 0x80) {E8(0x83); E8(0x43); E8(ofs); E8((u8)imm);}
+    else            {E8(0x81); E8(0x43); E8(ofs); E32(imm);}
+}
+static void EmitMovMem32(u8 ofs, u32 imm)           {E8(0xC7); E8(0x43); E8(ofs); E32(imm);}               // mov dword [rbx+ofs], imm
+static void EmitMovMem16(u8 ofs, u16 imm)           {E8(0x66); E8(0xC7); E8(0x43); E8(ofs); E16(imm);}     // mov word [rbx+ofs], imm
+static void EmitAndMem(u8 ofs, u32 imm)             {E8(0x81); E8(0x63); E8(ofs); E32(imm);}               // and dword [rbx+ofs], imm
+static void EmitOrMem(u8 ofs, u32 imm)              {E8(0x81); E8(0x4B); E8(ofs); E32(imm);}               // or  dword [rbx+ofs], imm (7 bytes)
+static void EmitStoreAX(u8 ofs)                     {E8(0x66); E8(0x89); E8(0x43); E8(ofs);}               // mov word [rbx+ofs], ax
+static void EmitLoadEAX(u8 ofs)                     {E8(0x0F); E8(0xB7); E8(0x43); E8(ofs);}               // movzx eax, word [rbx+ofs]
+static void EmitLoadEDI(u8 ofs)                     {E8(0x0F); E8(0xB7); E8(0x7B); E8(ofs);}               // movzx edi, word [rbx+ofs]
+static void EmitLoadEDX(u8 ofs)                     {E8(0x8B); E8(0x53); E8(ofs);}                         // mov edx, [rbx+ofs]
+static void EmitStoreEDX(u8 ofs)                    {E8(0x89); E8(0x53); E8(ofs);}                         // mov [rbx+ofs], edx
+static void EmitOrEDX(u32 imm)                      {E8(0x81); E8(0xCA); E32(imm);}                        // or edx, imm (6 bytes)
+static void EmitAndEDX(u32 imm)                     {E8(0x81); E8(0xE2); E32(imm);}                        // and edx, imm
+static void EmitMovzxESI(u8 bytes)                  {if (bytes&2) {E8(0x0F); E8(0xB7); E8(0xF6);} else {E8(0x40); E8(0x0F); E8(0xB6); E8(0xF6);}}  // movzx esi, si/sil
+static void EmitMovzxEAX(u8 bytes)                  {E8(0x0F); E8((bytes&2) ? 0xB7:0xB6); E8(0xC0);}       // movzx eax, ax/al
+static void EmitJccTo(u8 cc, u8 *target)            {E8(0x0F); E8(cc); E32((u32)(target - (pEmit+4)));}
+
+// Forward jumps over code of unknown length - emit the jump and patch it once we know where it lands
+static u8  *EmitJccForward(u8 cc)                   {E8(0x0F); E8(cc); E32(0); return pEmit;}
+static u8  *EmitJmpForward(void)                    {E8(0xE9); E32(0); return pEmit;}
+static void PatchForward(u8 *pAfter)                {s32 rel = (s32)(pEmit - pAfter); memcpy(pAfter-4, &rel, 4);}
+
+// ---------------------------------------------------------------------------------------
+// EDX |= table[ESI] - the compare-to-zero and parity tables. The 16-bit one lives at a
+// fixed low address so it can be reached directly, the others need a 64-bit pointer.
+// ---------------------------------------------------------------------------------------
+static void EmitOrTableESI(u16 *table)
+{
+    if ((uintptr_t)table < 0x80000000)
+    {
+        E8(0x0F); E8(0xB7); E8(0x0C); E8(0x75); E32((u32)(uintptr_t)table);   // movzx ecx, word [table + rsi*2]
+    }
+    else
+    {
+        E8(0x48); E8(0xB9); E64((u64)(uintptr_t)table);                      // movabs rcx, table
+        E8(0x0F); E8(0xB7); E8(0x0C); E8(0x71);                              // movzx ecx, word [rcx + rsi*2]
+    }
+    E8(0x09); E8(0xCA);                                                      // or edx, ecx
+}
+
+// EDX = (ST & ~clear) | CompareZero[ESI] - the usual way the status bits get set
+static void EmitStatus(u32 clear, u8 bytes)
+{
+    EmitLoadEDX(OFS_ST);
+    EmitAndEDX(~clear);
+    EmitOrTableESI((bytes&2) ? CompareZeroLookup16 : CompareZeroLookup8);
+}
+
+// EAX = WP_REG(reg) & 0xFFFE
+static void EmitRegAddress(u8 reg)
+{
+    E8(0x8B); E8(0x43); E8(OFS_WP);                     // mov eax, [rbx+WP]
+    if (reg) {E8(0x83); E8(0xC0); E8(reg<<1);}          // add eax, reg*2
+    E8(0x25); E32(0xFFFE);                              // and eax, 0xFFFE
+}
+
+// The page table and friends are plain arrays so they can usually be reached as a fixed displacement from R14
+static u8 R14Reachable(void *ptr)
+{
+    s64 ofs = (s64)((intptr_t)ptr - (intptr_t)MemCPU);
+    return (ofs >= INT32_MIN) && (ofs <= INT32_MAX);
+}
+static u32 R14Ofs(void *ptr)                        {return (u32)((intptr_t)ptr - (intptr_t)MemCPU);}
+
+// RDX = table[ECX] for one of the 64-bit page pointer tables
+static void EmitPageTableRDX(u8 **table)
+{
+    if (R14Reachable(table))
+    {
+        E8(0x49); E8(0x8B); E8(0x94); E8(0xCE); E32(R14Ofs(table));   // mov rdx, [r14+rcx*8+table]
+    }
+    else
+    {
+        E8(0x48); E8(0xBA); E64((u64)(uintptr_t)table);               // movabs rdx, table
+        E8(0x48); E8(0x8B); E8(0x14); E8(0xCA);                       // mov rdx, [rdx+rcx*8]
+    }
+}
+
+// EAX = ReadWP_RAM16(EAX) - the register file read is always straight through the page table in the fast core
+static void EmitReadWP(void)
+{
+    E8(0x89); E8(0xC1);                                 // mov ecx, eax
+    E8(0xC1); E8(0xE9); E8(PAGE_SHIFT);                 // shr ecx, 8
+    EmitPageTableRDX(PageRead);
+    E8(0x0F); E8(0xB7); E8(0x04); E8(0x02);             // movzx eax, word [rdx+rax]
+}
+
+// -----------------------------------------------------------------------------------------------
+// The bookkeeping TMS9900_Run() does before every handler: current opcode, PC, fetch penalty and
+// the instruction count. The immediate words bump the PC here too (ReadPC16_Block() would have)
+// and we fold the base cycle count of the instruction into the same add.
+// -----------------------------------------------------------------------------------------------
+static void EmitFetch(const TMS9900_PreDecode *instr, u8 words, u32 baseCycles)
+{
+    EmitMovMem16(OFS_CURRENTOP, instr->opcode);
+    EmitAddMem(OFS_PC, 2 + (words*2));
+    if (instr->fetchCycles + baseCycles) EmitAddMem(OFS_CYCLES, instr->fetchCycles + baseCycles);
+    E8(0x41); E8(0x83); E8(0x45); E8(0x00); E8(0x01);   // add dword [r13], 1
+}
+
+static void EmitWriteWP(void);
+
+// -------------------------------------------------------------------------------------------------
+// Work out a source or destination address into srcAddress/dstAddress - exactly as TsMode_Block()
+// and TdMode_Block() do including the cycle counts. The symbolic address comes from the pre-decoded
+// immediate words (*pImm is the next one to use).
+// -------------------------------------------------------------------------------------------------
+static void EmitOperand(const TMS9900_PreDecode *instr, u8 mode, u8 reg, u8 bytes, u8 *pImm, u8 ofs)
+{
+    switch (mode)
+    {
+        case MODE_REG:
+            EmitRegAddress(reg);
+            EmitStoreAX(ofs);
+            return;
+
+        case MODE_IND:
+            EmitRegAddress(reg);
+            EmitReadWP();
+            EmitAddMem(OFS_CYCLES, 4);
+            break;
+
+        case MODE_SYM:
+            if (reg) {EmitRegAddress(reg); EmitReadWP(); E8(0x05); E32(instr->imm[(*pImm)++]);}  // add eax, imm
+            else {E8(0xB8); E32(instr->imm[(*pImm)++]);}                                         // mov eax, imm
+            EmitAddMem(OFS_CYCLES, 8);
+            break;
+
+        default:    // MODE_INC
+            EmitRegAddress(reg);
+            E8(0x89); E8(0xC7);                         // mov edi, eax
+            EmitReadWP();
+            EmitStoreAX(ofs);
+            E8(0x8D); E8(0x70); E8(bytes);              // lea esi, [rax+bytes]
+            EmitMovzxESI(2);
+            EmitWriteWP();
+            EmitAddMem(OFS_CYCLES, (bytes&1) ? 6:8);
+            if (bytes&2) {E8(0x66); E8(0x81); E8(0x63); E8(ofs); E16(0xFFFE);}  // and word [rbx+ofs], 0xFFFE
+            return;
+    }
+
+    if (bytes&2) {E8(0x25); E32(0xFFFE);}               // and eax, 0xFFFE
+    EmitStoreAX(ofs);
+}
+
+// -------------------------------------------------------------------------------------------------
+// EAX = MemoryRead16/8(address). Anything that isn't a device page is nothing more than the wait
+// state penalty and a load through the page table so we do those right here and only call out for
+// the devices (VDP, GROM, speech and the odd mixed page).
+// -------------------------------------------------------------------------------------------------
+static void EmitRead(u8 bytes, u8 ofs)
+{
+    u8 bFast = R14Reachable(PageFlags) && R14Reachable(PageRead);
+    u8 *pSlow, *pDone;
+
+    EmitLoadEDI(ofs);
+    if (!bFast)
+    {
+        EmitCall((bytes&2) ? (void*)MemoryRead16 : (void*)MemoryRead8);
+        EmitMovzxEAX(bytes);
+        return;
+    }
+    E8(0x89); E8(0xF9);                                 // mov ecx, edi
+    E8(0xC1); E8(0xE9); E8(PAGE_SHIFT);                 // shr ecx, 8
+    E8(0x41); E8(0x0F); E8(0xB6); E8(0x94); E8(0x0E); E32(R14Ofs(PageFlags));  // movzx edx, byte [r14+rcx+PageFlags]
+    E8(0xF6); E8(0xC2); E8(PAGE_DEVICE);                // test dl, PAGE_DEVICE
+    pSlow = EmitJccForward(0x85);                       // jne slow
+    E8(0x01); E8(0x53); E8(OFS_CYCLES);                 // add [rbx+cycles], edx (the wait state penalty or nothing)
+    EmitPageTableRDX(PageRead);
+    if (bytes&2)
+    {
+        E8(0x0F); E8(0xB7); E8(0x04); E8(0x3A);         // movzx eax, word [rdx+rdi]
+    }
+    else
+    {
+        E8(0x83); E8(0xF7); E8(0x01);                   // xor edi, 1 (BYTE_LANE - the slow path is behind us)
+        E8(0x0F); E8(0xB6); E8(0x04); E8(0x3A);         // movzx eax, byte [rdx+rdi]
+    }
+    pDone = EmitJmpForward();                           // jmp done
+    PatchForward(pSlow);
+    EmitCall((bytes&2) ? (void*)MemoryRead16 : (void*)MemoryRead8);
+    EmitMovzxEAX(bytes);
+    PatchForward(pDone);
+}
+
+// --------------------------------------------------------------------------------------------------
+// Store ESI at EDI through the page table the same way the memory handlers do - but only if the page
+// is writable memory and no cached code lives there. Jumps to the returned patch point for anything
+// else so the caller can fall back to the full handler. For workspace register writes (bWP) there is
+// no wait state penalty - WriteWP_RAM16() doesn't charge one either.
+// --------------------------------------------------------------------------------------------------
+static void EmitFastStore(u8 bytes, u8 bWP, u8 **pSlow, u8 **pDone)
+{
+    u8 nSlow = 0;
+
+    E8(0x89); E8(0xF9);                                 // mov ecx, edi
+    E8(0xC1); E8(0xE9); E8(PAGE_SHIFT);                 // shr ecx, 8
+    EmitPageTableRDX(PageWrite);
+    E8(0x48); E8(0x85); E8(0xD2);                       // test rdx, rdx
+    pSlow[nSlow++] = EmitJccForward(0x84);              // je slow (ROM or a device)
+    if (!bWP) {E8(0x41); E8(0x0F); E8(0xB6); E8(0x84); E8(0x0E); E32(R14Ofs(PageFlags));}   // movzx eax, byte [r14+rcx+PageFlags]
+    E8(0x89); E8(0xF9);                                 // mov ecx, edi
+    E8(0xC1); E8(0xE9); E8(0x04);                       // shr ecx, 4
+    E8(0x41); E8(0x80); E8(0xBC); E8(0x0E); E32(R14Ofs(BlockCodeMark)); E8(0x00);   // cmp byte [r14+rcx+BlockCodeMark], 0
+    pSlow[nSlow++] = EmitJccForward(0x85);              // jne slow
+    while (nSlow < 3) pSlow[nSlow++] = NULL;
+
+    if (!bWP) {E8(0x01); E8(0x43); E8(OFS_CYCLES);}                                  // add [rbx+cycles], eax (writable pages are never device pages)
+    if (bytes&2) {E8(0x66); E8(0x89); E8(0x34); E8(0x3A);}                            // mov [rdx+rdi], si
+    else         {E8(0x83); E8(0xF7); E8(0x01); E8(0x40); E8(0x88); E8(0x34); E8(0x3A);}  // xor edi, 1 (BYTE_LANE) / mov [rdx+rdi], sil
+    *pDone = EmitJmpForward();
+}
+
+// MemoryWrite16/8(address, ESI)
+static void EmitWrite(u8 bytes, u8 ofs)
+{
+    u8 *pSlow[3], *pDone = NULL;
+    u8 bFast = R14Reachable(PageWrite) && R14Reachable(PageFlags) && R14Reachable(BlockCodeMark);
+
+    EmitLoadEDI(ofs);
+    if (bFast) EmitFastStore(bytes, 0, pSlow, &pDone);
+    if (bFast) for (u8 i=0; i<3; i++) if (pSlow[i]) PatchForward(pSlow[i]);
+    EmitCall((bytes&2) ? (void*)MemoryWrite16 : (void*)MemoryWrite8);
+    if (pDone) PatchForward(pDone);
+}
+
+// WriteWP_RAM16(EDI, ESI)
+static void EmitWriteWP(void)
+{
+    u8 *pSlow[3], *pDone = NULL;
+    u8 bFast = R14Reachable(PageWrite) && R14Reachable(BlockCodeMark);
+
+    if (bFast) EmitFastStore(2, 1, pSlow, &pDone);
+    if (bFast) for (u8 i=0; i<3; i++) if (pSlow[i]) PatchForward(pSlow[i]);
+    EmitCall(WriteWP_RAM16);
+    if (pDone) PatchForward(pDone);
+}
+
+// PhantomMemoryRead() - only the cycle penalty for anything that isn't console ROM or scratchpad
+static void EmitPhantom(u8 ofs)
+{
+    EmitLoadEAX(ofs);
+    E8(0xC1); E8(0xE8); E8(PAGE_SHIFT);                 // shr eax, 8
+    E8(0x48); E8(0xBA); E64((u64)(uintptr_t)PageFlags); // movabs rdx, PageFlags
+    E8(0x0F); E8(0xB6); E8(0x04); E8(0x02);             // movzx eax, byte [rdx+rax]
+    E8(0x83); E8(0xE0); E8(PAGE_WAIT);                  // and eax, PAGE_WAIT
+    E8(0x01); E8(0x43); E8(OFS_CYCLES);                 // add [rbx+cycles], eax
+}
+
+// ---------------------------------------------------------------------------------------------
+// Add or subtract with the Classic99 carry and overflow rules. EBP is the source, EAX is the
+// destination and the result ends up in ESI with the status (not yet stored) in EDX.
+// ---------------------------------------------------------------------------------------------
+static void EmitAddFlags(u8 bytes)
+{
+    u32 sign = (bytes&2) ? 0x8000:0x80;
+
+    E8(0x8D); E8(0x74); E8(0x05); E8(0x00);             // lea esi, [rbp+rax]
+    EmitMovzxESI(bytes);
+    EmitStatus((bytes&2) ? (ST_LGT | ST_AGT | ST_EQ | ST_C | ST_OV) : (ST_LGT | ST_AGT | ST_EQ | ST_C | ST_OV | ST_OP), bytes);
+    E8(0x39); E8(0xEE);                                 // cmp esi, ebp
+    E8(0x73); E8(6);                                    // jae skip
+    EmitOrEDX(ST_C);
+    E8(0x89); E8(0xE9);                                 // mov ecx, ebp
+    E8(0x31); E8(0xC1);                                 // xor ecx, eax
+    E8(0xF7); E8(0xD1);                                 // not ecx
+    E8(0x41); E8(0x89); E8(0xF0);                       // mov r8d, esi
+    E8(0x41); E8(0x31); E8(0xC0);                       // xor r8d, eax
+    E8(0x44); E8(0x21); E8(0xC1);                       // and ecx, r8d
+    E8(0xF7); E8(0xC1); E32(sign);                      // test ecx, sign
+    E8(0x74); E8(6);                                    // je skip
+    EmitOrEDX(ST_OV);
+}
+
+static void EmitSubFlags(u8 bytes)
+{
+    u32 sign = (bytes&2) ? 0x8000:0x80;
+
+    E8(0x89); E8(0xC6);                                 // mov esi, eax
+    E8(0x29); E8(0xEE);                                 // sub esi, ebp
+    EmitMovzxESI(bytes);
+    EmitStatus((bytes&2) ? (ST_LGT | ST_AGT | ST_EQ | ST_C | ST_OV) : (ST_LGT | ST_AGT | ST_EQ | ST_C | ST_OV | ST_OP), bytes);
+    E8(0x39); E8(0xE8);                                 // cmp eax, ebp     (any number minus 0 sets the carry too)
+    E8(0x72); E8(6);                                    // jb skip
+    EmitOrEDX(ST_C);
+    E8(0x89); E8(0xE9);                                 // mov ecx, ebp
+    E8(0x31); E8(0xC1);                                 // xor ecx, eax
+    E8(0x41); E8(0x89); E8(0xF0);                       // mov r8d, esi
+    E8(0x41); E8(0x31); E8(0xC0);                       // xor r8d, eax
+    E8(0x44); E8(0x21); E8(0xC1);                       // and ecx, r8d
+    E8(0xF7); E8(0xC1); E32(sign);                      // test ecx, sign
+    E8(0x74); E8(6);                                    // je skip
+    EmitOrEDX(ST_OV);
+}
+
+// ---------------------------------------------------------------------------------------------
+// All the conditional jumps boil down to (ST & mask) compared against a value. For the 'any bit
+// set' style of jump we take the branch when they are not equal...
+// ---------------------------------------------------------------------------------------------
+static void EmitJump(const TMS9900_PreDecode *instr)
+{
+    u32 mask = 0, value = 0; u8 takenIfEqual = 1;
+    s32 disp = ((s8)(instr->opcode & 0xFF)) << 1;
+
+    switch (instr->op8)
+    {
+        case op_jlt: mask = ST_AGT | ST_EQ;             break;
+        case op_jle: mask = ST_LGT | ST_EQ; value = ST_LGT; takenIfEqual = 0; break;
+        case op_jeq: mask = ST_EQ;  takenIfEqual = 0;   break;
+        case op_jhe: mask = ST_LGT | ST_EQ; takenIfEqual = 0; break;
+        case op_jgt: mask = ST_AGT; takenIfEqual = 0;   break;
+        case op_jne: mask = ST_EQ;                      break;
+        case op_jnc: mask = ST_C;                       break;
+        case op_joc: mask = ST_C;   takenIfEqual = 0;   break;
+        case op_jno: mask = ST_OV;                      break;
+        case op_jl:  mask = ST_LGT | ST_EQ;             break;
+        case op_jh:  mask = ST_LGT | ST_EQ; value = ST_LGT; break;
+        case op_jop: mask = ST_OP;  takenIfEqual = 0;   break;
+        default:     break;     // op_jmp - always taken
+    }
+
+    EmitFetch(instr, 0, 0);
+    if (instr->op8 == op_jmp)
+    {
+        EmitAddMem(OFS_CYCLES, 10);
+        EmitAddMem(OFS_PC, (u32)disp);
+        return;
+    }
+
+    EmitLoadEDX(OFS_ST);
+    EmitAndEDX(mask);
+    E8(0x81); E8(0xFA); E32(value);                     // cmp edx, value
+    E8(takenIfEqual ? 0x74:0x75); E8(9);                // je/jne taken (skip the not-taken add + jmp)
+    EmitAddMem(OFS_CYCLES, 8);                          // 4 bytes
+    E8(0xE9); u8 *pDone = pEmit; E32(0);                // jmp done (5 bytes)
+    EmitAddMem(OFS_CYCLES, 10);
+    EmitAddMem(OFS_PC, (u32)disp);
+    s32 rel = (s32)(pEmit - (pDone+4)); memcpy(pDone, &rel, 4);
+}
+
+// ---------------------------------------------------------------------
+// LI, AI, ANDI, ORI and CI - register and the immediate operand
+// ---------------------------------------------------------------------
+static void EmitImmediate(const TMS9900_PreDecode *instr)
+{
+    u16 imm = instr->imm[0];
+
+    EmitFetch(instr, 1, (instr->op8 == op_li) ? 12:14);
+    EmitRegAddress(instr->opcode & 0x0F);
+    E8(0x89); E8(0xC7);                                 // mov edi, eax
+
+    if (instr->op8 == op_li)
+    {
+        E8(0xBE); E32(imm);                             // mov esi, imm
+        EmitWriteWP();
+        EmitAndMem(OFS_ST, ~(ST_LGT | ST_AGT | ST_EQ));
+        if (CompareZeroLookup16[imm]) EmitOrMem(OFS_ST, CompareZeroLookup16[imm]);
+        return;
+    }
+
+    EmitReadWP();
+    if (instr->op8 == op_ci)
+    {
+        EmitLoadEDX(OFS_ST);
+        EmitAndEDX(~(ST_LGT | ST_AGT | ST_EQ));
+        E8(0x66); E8(0x3D); E16(imm); E8(0x76); E8(6); EmitOrEDX(ST_LGT);  // cmp ax,imm / jbe skip / LGT
+        E8(0x66); E8(0x3D); E16(imm); E8(0x75); E8(6); EmitOrEDX(ST_EQ);   // cmp ax,imm / jne skip / EQ
+        E8(0x66); E8(0x3D); E16(imm); E8(0x7E); E8(6); EmitOrEDX(ST_AGT);  // cmp ax,imm / jle skip / AGT
+        EmitStoreEDX(OFS_ST);
+        return;
+    }
+
+    if (instr->op8 == op_ai)
+    {
+        E8(0xBD); E32(imm);                             // mov ebp, imm
+        EmitAddFlags(2);
+    }
+    else
+    {
+        E8(0x89); E8(0xC6);                             // mov esi, eax
+        E8(0x81); E8((instr->op8 == op_andi) ? 0xE6:0xCE); E32(imm);   // and/or esi, imm
+        EmitStatus(ST_LGT | ST_AGT | ST_EQ, 2);
+    }
+    EmitStoreEDX(OFS_ST);
+    EmitWriteWP();
+}
+
+// -----------------------------------------------------------------------------------
+// SRA, SRL, SLA and SRC with the shift count in the opcode. The x86 shifts leave the
+// last bit shifted out in the carry which is exactly what the TMS9900 does.
+// -----------------------------------------------------------------------------------
+static void EmitShift(const TMS9900_PreDecode *instr)
+{
+    u8 numBits = (instr->opcode >> 4) & 0x0F;
+
+    EmitFetch(instr, 0, 12 + (2*numBits));
+    EmitRegAddress(instr->opcode & 0x0F);
+    E8(0x89); E8(0xC7);                                 // mov edi, eax
+    EmitReadWP();
+    EmitLoadEDX(OFS_ST);
+
+    if (instr->op8 == op_sla)
+    {
+        // Overflow if the sign bit changes at any point - the top numBits+1 bits must all match
+        EmitAndEDX(~(ST_LGT | ST_AGT | ST_EQ | ST_C | ST_OV));
+        E8(0x0F); E8(0xBF); E8(0xC8);                   // movsx ecx, ax
+        if (numBits < 15) {E8(0xC1); E8(0xF9); E8(15 - numBits);}  // sar ecx, 15-numBits
+        E8(0x83); E8(0xC1); E8(0x01);                   // add ecx, 1
+        E8(0x83); E8(0xF9); E8(0x01);                   // cmp ecx, 1
+        E8(0x76); E8(6);                                // jbe skip
+        EmitOrEDX(ST_OV);
+        E8(0x66); E8(0xC1); E8(0xE0); E8(numBits);      // shl ax, numBits
+    }
+    else
+    {
+        EmitAndEDX(~(ST_LGT | ST_AGT | ST_EQ | ST_C));
+        E8(0x66); E8(0xC1);
+        E8((instr->op8 == op_sra) ? 0xF8 : ((instr->op8 == op_srl) ? 0xE8 : 0xC8));   // sar/shr/ror ax, numBits
+        E8(numBits);
+    }
+    E8(0x73); E8(6);                                    // jnc skip
+    EmitOrEDX(ST_C);
+    E8(0x89); E8(0xC6);                                 // mov esi, eax
+    EmitMovzxESI(2);
+    EmitOrTableESI(CompareZeroLookup16);
+    EmitStoreEDX(OFS_ST);
+    EmitWriteWP();
+}
+
+// ---------------------------------------------------------------------------------
+// The Format I (two operand) instructions in all of their addressing mode glory.
+// The order of operations follows tms9900_format1.inc exactly so that *Rx+ and any
+// memory side effects land in the same order.
+// ---------------------------------------------------------------------------------
+// Compare source (EBP) against destination (EAX) as a word or a byte
+static void EmitCompareSD(u8 bytes)
+{
+    if (bytes&2) {E8(0x66); E8(0x39); E8(0xC5);}       // cmp bp, ax
+    else         {E8(0x40); E8(0x38); E8(0xC5);}       // cmp bpl, al
+}
+
+static void EmitFormat1(const TMS9900_PreDecode *instr)
+{
+    u16 opcode  = instr->opcode;
+    u8  op      = (instr->op8 - op_szc) / 5;    // szc, szcb, s, sb, c, cb, a, ab, mov, movb, soc, socb
+    u8  bytes   = (op & 1) ? 1:2;
+    u8  tsMode  = (opcode >> 4) & 3;
+    u8  tdMode  = (opcode >> 10) & 3;
+    u8  imm     = 0;
+
+    EmitFetch(instr, (tsMode == MODE_SYM) + (tdMode == MODE_SYM), 14);
+    EmitOperand(instr, tsMode, opcode & 0x0F, bytes, &imm, OFS_SRC);
+
+    switch (op)
+    {
+        case 8: case 9: // mov, movb
+            EmitRead(bytes, OFS_SRC);
+            E8(0x89); E8(0xC6);                         // mov esi, eax
+            E8(0x89); E8(0xC5);                         // mov ebp, eax
+            EmitStatus((bytes&2) ? (ST_LGT | ST_AGT | ST_EQ) : (ST_LGT | ST_AGT | ST_EQ | ST_OP), bytes);
+            EmitStoreEDX(OFS_ST);
+            EmitOperand(instr, tdMode, (opcode >> 6) & 0x0F, bytes, &imm, OFS_DST);
+            EmitPhantom(OFS_DST);
+            E8(0x89); E8(0xEE);                         // mov esi, ebp
+            EmitWrite(bytes, OFS_DST);
+            return;
+
+        case 10: case 11: // soc, socb - both addresses are worked out before either read
+            EmitOperand(instr, tdMode, (opcode >> 6) & 0x0F, bytes, &imm, OFS_DST);
+            EmitRead(bytes, OFS_SRC);
+            E8(0x89); E8(0xC5);                         // mov ebp, eax
+            EmitRead(bytes, OFS_DST);
+            E8(0x89); E8(0xC6);                         // mov esi, eax
+            E8(0x09); E8(0xEE);                         // or esi, ebp
+            EmitStatus((bytes&2) ? (ST_LGT | ST_AGT | ST_EQ) : (ST_LGT | ST_AGT | ST_EQ | ST_OP), bytes);
+            EmitStoreEDX(OFS_ST);
+            EmitWrite(bytes, OFS_DST);
+            return;
+    }
+
+    EmitRead(bytes, OFS_SRC);
+    E8(0x89); E8(0xC5);                                 // mov ebp, eax
+    EmitOperand(instr, tdMode, (opcode >> 6) & 0x0F, bytes, &imm, OFS_DST);
+    EmitRead(bytes, OFS_DST);
+
+    switch (op)
+    {
+        case 0: case 1: // szc, szcb
+            E8(0x89); E8(0xEE);                         // mov esi, ebp
+            E8(0xF7); E8(0xD6);                         // not esi
+            E8(0x21); E8(0xC6);                         // and esi, eax
+            EmitMovzxESI(bytes);
+            EmitStatus((bytes&2) ? (ST_LGT | ST_AGT | ST_EQ) : (ST_LGT | ST_AGT | ST_EQ | ST_OP), bytes);
+            break;
+
+        case 2: case 3: // s, sb
+            EmitSubFlags(bytes);
+            break;
+
+        case 4: case 5: // c, cb - no write back
+            EmitLoadEDX(OFS_ST);
+            if (bytes&2)
+            {
+                EmitAndEDX(~(ST_LGT | ST_AGT | ST_EQ));
+            }
+            else
+            {
+                EmitAndEDX(~(ST_LGT | ST_AGT | ST_EQ | ST_OP));
+                E8(0x89); E8(0xEE);                     // mov esi, ebp
+                EmitOrTableESI(ParityTable);
+            }
+            // The OR for each flag trashes the x86 flags so we compare again before every test
+            EmitCompareSD(bytes); E8(0x76); E8(6); EmitOrEDX(ST_LGT);  // jbe skip / LGT
+            EmitCompareSD(bytes); E8(0x75); E8(6); EmitOrEDX(ST_EQ);   // jne skip / EQ
+            EmitCompareSD(bytes); E8(0x7E); E8(6); EmitOrEDX(ST_AGT);  // jle skip / AGT
+            EmitStoreEDX(OFS_ST);
+            return;
+
+        default:        // a, ab
+            EmitAddFlags(bytes);
+            break;
+    }
+    EmitStoreEDX(OFS_ST);
+    EmitWrite(bytes, OFS_DST);
+}
+
+// --------------------------------------------------------------------------
+// The single operand instructions - B, BL, CLR, SETO, INV, NEG, ABS, SWPB
+// and the INC/DEC family. Returns 0 for the ones we leave to the handler.
+// --------------------------------------------------------------------------
+static u8 EmitSingle(const TMS9900_PreDecode *instr)
+{
+    u16 opcode  = instr->opcode;
+    u8  tsMode  = (opcode >> 4) & 3;
+    u8  imm     = 0;
+    u8  *pDone;
+
+    switch (instr->op8)
+    {
+        case op_b:      EmitFetch(instr, tsMode == MODE_SYM, 8);  break;
+        case op_bl:     EmitFetch(instr, tsMode == MODE_SYM, 12); break;
+        case op_neg:
+        case op_abs:    EmitFetch(instr, tsMode == MODE_SYM, 12); break;
+        case op_clr:
+        case op_seto:
+        case op_inv:
+        case op_inc:
+        case op_inct:
+        case op_dec:
+        case op_dect:
+        case op_swpb:   EmitFetch(instr, tsMode == MODE_SYM, 10); break;
+        default:        return 0;
+    }
+    EmitOperand(instr, tsMode, opcode & 0x0F, 2, &imm, OFS_SRC);
+
+    switch (instr->op8)
+    {
+        case op_b:
+            EmitLoadEAX(OFS_SRC);
+            E8(0x89); E8(0x43); E8(OFS_PC);             // mov [rbx+PC], eax
+            break;
+
+        case op_bl:
+            EmitRegAddress(11);
+            E8(0x89); E8(0xC7);                         // mov edi, eax
+            E8(0x8B); E8(0x73); E8(OFS_PC);             // mov esi, [rbx+PC]
+            EmitMovzxESI(2);
+            EmitWriteWP();
+            EmitLoadEAX(OFS_SRC);
+            E8(0x89); E8(0x43); E8(OFS_PC);             // mov [rbx+PC], eax
+            break;
+
+        case op_clr:
+        case op_seto:
+            EmitPhantom(OFS_SRC);
+            E8(0xBE); E32((instr->op8 == op_clr) ? 0x0000:0xFFFF);  // mov esi, value
+            EmitWrite(2, OFS_SRC);
+            break;
+
+        case op_inv:
+            EmitRead(2, OFS_SRC);
+            E8(0x89); E8(0xC6);                         // mov esi, eax
+            E8(0xF7); E8(0xD6);                         // not esi
+            EmitMovzxESI(2);
+            EmitStatus(ST_LGT | ST_AGT | ST_EQ, 2);
+            EmitStoreEDX(OFS_ST);
+            EmitWrite(2, OFS_SRC);
+            break;
+
+        case op_neg:
+            EmitRead(2, OFS_SRC);
+            E8(0x89); E8(0xC6);                         // mov esi, eax
+            E8(0xF7); E8(0xDE);                         // neg esi
+            EmitMovzxESI(2);
+            EmitStatus(ST_LGT | ST_AGT | ST_EQ | ST_C | ST_OV, 2);
+            E8(0x85); E8(0xF6);                         // test esi, esi
+            E8(0x75); E8(6);                            // jne skip
+            EmitOrEDX(ST_C);
+            E8(0x81); E8(0xFE); E32(0x8000);            // cmp esi, 0x8000
+            E8(0x75); E8(6);                            // jne skip
+            EmitOrEDX(ST_OV);
+            EmitStoreEDX(OFS_ST);
+            EmitWrite(2, OFS_SRC);
+            break;
+
+        case op_abs:
+            EmitRead(2, OFS_SRC);
+            E8(0x89); E8(0xC6);                         // mov esi, eax
+            EmitStatus(ST_LGT | ST_AGT | ST_EQ | ST_C | ST_OV, 2);
+            EmitStoreEDX(OFS_ST);
+            E8(0xA9); E32(0x8000);                      // test eax, 0x8000
+            pDone = EmitJccForward(0x84);               // je done
+            EmitAddMem(OFS_CYCLES, 2);
+            E8(0x3D); E32(0x8000);                      // cmp eax, 0x8000
+            E8(0x75); E8(7);                            // jne skip
+            EmitOrMem(OFS_ST, ST_OV);
+            E8(0xF7); E8(0xDE);                         // neg esi
+            EmitMovzxESI(2);
+            EmitWrite(2, OFS_SRC);
+            PatchForward(pDone);
+            break;
+
+        case op_swpb:
+            EmitRead(2, OFS_SRC);
+            E8(0x66); E8(0xC1); E8(0xC0); E8(0x08);     // rol ax, 8
+            E8(0x89); E8(0xC6);                         // mov esi, eax
+            EmitWrite(2, OFS_SRC);
+            break;
+
+        default:    // inc, inct, dec, dect
+            EmitRead(2, OFS_SRC);
+            E8(0xBD); E32(((instr->op8 == op_inct) || (instr->op8 == op_dect)) ? 2:1);   // mov ebp, 1 or 2
+            if ((instr->op8 == op_inc) || (instr->op8 == op_inct)) EmitAddFlags(2);
+            else EmitSubFlags(2);
+            EmitStoreEDX(OFS_ST);
+            EmitWrite(2, OFS_SRC);
+            break;
+    }
+    return 1;
+}
+
+// ---------------------------------------------------------------------------------
+// XOR, COC and CZC - a general source against a workspace register destination
+// ---------------------------------------------------------------------------------
+static void EmitFormat3(const TMS9900_PreDecode *instr)
+{
+    u16 opcode  = instr->opcode;
+    u8  tsMode  = (opcode >> 4) & 3;
+    u8  dReg    = (opcode >> 6) & 0x0F;
+    u8  imm     = 0;
+
+    EmitFetch(instr, tsMode == MODE_SYM, 14);
+    EmitOperand(instr, tsMode, opcode & 0x0F, 2, &imm, OFS_SRC);
+
+    if (instr->op8 == op_xor)
+    {
+        EmitRead(2, OFS_SRC);
+        E8(0x89); E8(0xC5);                             // mov ebp, eax
+        EmitRegAddress(dReg);
+        E8(0x89); E8(0xC7);                             // mov edi, eax
+        EmitReadWP();
+        E8(0x31); E8(0xE8);                             // xor eax, ebp
+        E8(0x89); E8(0xC6);                             // mov esi, eax
+        EmitStatus(ST_LGT | ST_AGT | ST_EQ, 2);
+        EmitStoreEDX(OFS_ST);
+        EmitWriteWP();
+        return;
+    }
+
+    EmitRegAddress(dReg);                               // TdWA()
+    EmitStoreAX(OFS_DST);
+    EmitRead(2, OFS_SRC);
+    E8(0x89); E8(0xC5);                                 // mov ebp, eax
+    EmitRead(2, OFS_DST);
+    EmitLoadEDX(OFS_ST);
+    EmitAndEDX(~ST_EQ);
+    if (instr->op8 == op_coc)
+    {
+        E8(0xF7); E8(0xD0);                             // not eax
+    }
+    E8(0x85); E8(0xE8);                                 // test eax, ebp
+    E8(0x75); E8(6);                                    // jne skip
+    EmitOrEDX(ST_EQ);
+    EmitStoreEDX(OFS_ST);
+}
+
+// ----------------------------------------------------------------------------------------------
+// Translate one instruction. Anything we don't handle natively runs the interpreter's handler.
+// ----------------------------------------------------------------------------------------------
+static void EmitInstruction(const TMS9900_PreDecode *instr)
+{
+    u8 op8 = instr->op8;
+
+    bCalledOut = 0;
+
+    if ((op8 >= op_jmp) && (op8 <= op_jop)) {EmitJump(instr); return;}
+    if ((op8 >= op_szc) && (op8 <= op_socb_II)) {EmitFormat1(instr); return;}
+    if ((op8 >= op_li) && (op8 <= op_ci)) {EmitImmediate(instr); return;}
+
+    switch (op8)
+    {
+        case op_sra:
+        case op_srl:
+        case op_sla:
+        case op_src:
+            if (instr->opcode & 0x00F0) {EmitShift(instr); return;}    // A zero count comes from R0 - leave that to the handler
+            break;
+
+        case op_xor:
+        case op_coc:
+        case op_czc:
+            EmitFormat3(instr);
+            return;
+
+        case op_lwpi:
+            EmitFetch(instr, 1, 10);
+            EmitMovMem32(OFS_WP, instr->imm[0] & 0xFFFE);
+            return;
+
+        case op_limi:
+            EmitFetch(instr, 1, 16);
+            EmitAndMem(OFS_ST, ~ST_INTMASK);
+            if (instr->imm[0] & ST_INTMASK)
+            {
+                EmitOrMem(OFS_ST, instr->imm[0] & ST_INTMASK);
+                E8(0x48); E8(0xB8); E64((u64)(uintptr_t)&intCheck);   // movabs rax, &intCheck
+                E8(0xC6); E8(0x00); E8(0x01);                       // mov byte [rax], 1 (a pending interrupt may now get through)
+            }
+            return;
+
+        case op_stwp:
+        case op_stst:
+            EmitFetch(instr, 0, 8);
+            EmitRegAddress(instr->opcode & 0x0F);
+            E8(0x89); E8(0xC7);                         // mov edi, eax
+            E8(0x8B); E8(0x73); E8((op8 == op_stwp) ? OFS_WP : OFS_ST);   // mov esi, [rbx+WP/ST]
+            EmitMovzxESI(2);
+            EmitWriteWP();
+            return;
+
+        default:
+            if (EmitSingle(instr)) return;
+            break;
+    }
+
+    E8(0x48); E8(0xBF); E64((u64)(uintptr_t)instr);    // movabs rdi, instr
+    EmitCall(TMS9900_ExecutePreDecoded);
+}
+
+// -------------------------------------------------------------------------------------------------
+// The entry stub sits at the very start of the code buffer and is never flushed. It sets up the
+// registers for the scanline and falls into the dispatcher which looks up the translation for the
+// block at the current PC - anything other than a simple hit is left to JIT_NextBlock(). Each
+// translated block ends with its own copy of that dispatch so the host branch predictor gets to
+// learn which block usually follows which.
+// -------------------------------------------------------------------------------------------------
+static MACHINE_LOCAL u8  *JitCheck;       // Is the next event due? If not go dispatch the next block
+static MACHINE_LOCAL u8  *JitExit;        // Restore the registers and return to JIT_Run()
+static MACHINE_LOCAL void (*JitEnter)(u32 eventCycle);
+
+static MACHINE_LOCAL u8   JitFlushPending;
+
+static void EmitCycleCheck(void)            {E8(0x44); E8(0x39); E8(0x63); E8(OFS_CYCLES);}   // cmp [rbx+cycles], r12d
+
+static u8 *JIT_NextBlock(void);
+
+static void EmitDispatch(void)
+{
+    u8 *pSlow[5], *pOK;
+    u8 nSlow = 0;
+
+    // --------------------------------------------------------------------------------------------
+    // The common case done right here - no interrupt to look at, not a PC trap page and the next block
+    // already translated and still good. That's the same test JIT_NextBlock() makes first.
+    // --------------------------------------------------------------------------------------------
+    if (R14Reachable(JitBlocks) && R14Reachable(PageRead) && R14Reachable(PageTrap) && R14Reachable(&TMS9900_BlockFlushes) && R14Reachable(&blockEpoch) && R14Reachable(&intCheck))
+    {
+        E8(0x41); E8(0x80); E8(0xBE); E32(R14Ofs(&intCheck)); E8(0x00);         // cmp byte [r14+intCheck], 0
+        pSlow[nSlow++] = EmitJccForward(0x85);                                  // jne slow (TMS9900_HandlePendingInterrupts() has a look)
+        E8(0x8B); E8(0x43); E8(OFS_PC);                                         // mov eax, [rbx+PC]
+
+        // Work out the source address just like BlockSource() - and a PC trap page goes the slow way
+        E8(0x89); E8(0xC1);                                                     // mov ecx, eax
+        E8(0xC1); E8(0xE9); E8(PAGE_SHIFT);                                     // shr ecx, 8
+        E8(0x41); E8(0x80); E8(0xBC); E8(0x0E); E32(R14Ofs(PageTrap)); E8(0x00);   // cmp byte [r14+rcx+PageTrap], 0
+        pSlow[nSlow++] = EmitJccForward(0x85);                                  // jne slow
+        E8(0x49); E8(0x03); E8(0x84); E8(0xCE); E32(R14Ofs(PageRead));          // add rax, [r14+rcx*8+PageRead]
+
+        // RDX = &JitBlocks[(source >> 1) & (JIT_TABLE_SIZE-1)]
+        E8(0x89); E8(0xC1);                                                     // mov ecx, eax
+        E8(0xD1); E8(0xE9);                                                     // shr ecx, 1
+        E8(0x81); E8(0xE1); E32(JIT_TABLE_SIZE-1);                              // and ecx, JIT_TABLE_SIZE-1
+        E8(0x69); E8(0xC9); E32(sizeof(JitBlock_t));                            // imul ecx, ecx, sizeof(JitBlock_t)
+        E8(0x49); E8(0x8D); E8(0x96); E32(R14Ofs(JitBlocks));                  // lea rdx, [r14+JitBlocks]
+        E8(0x48); E8(0x01); E8(0xCA);                                           // add rdx, rcx
+
+        E8(0x48); E8(0x39); E8(0x42); E8(offsetof(JitBlock_t, source));         // cmp [rdx+source], rax
+        pSlow[nSlow++] = EmitJccForward(0x85);                                  // jne slow
+        E8(0x8B); E8(0x4A); E8(offsetof(JitBlock_t, flushes));                  // mov ecx, [rdx+flushes]
+        E8(0x41); E8(0x3B); E8(0x8E); E32(R14Ofs(&TMS9900_BlockFlushes));       // cmp ecx, [r14+TMS9900_BlockFlushes]
+        pSlow[nSlow++] = EmitJccForward(0x85);                                  // jne slow
+        E8(0x0F); E8(0xB7); E8(0x4A); E8(offsetof(JitBlock_t, epoch));          // movzx ecx, word [rdx+epoch]
+        E8(0x85); E8(0xC9);                                                     // test ecx, ecx
+        pOK = EmitJccForward(0x84);                                             // je ok (ROM block)
+        E8(0x66); E8(0x41); E8(0x3B); E8(0x8E); E32(R14Ofs(&blockEpoch));       // cmp cx, [r14+blockEpoch]
+        pSlow[nSlow++] = EmitJccForward(0x85);                                  // jne slow
+        PatchForward(pOK);
+        E8(0x41); E8(0xC6); E8(0x07); E8(0x00);                                 // ok: mov byte [r15], 0 (blockExit)
+        E8(0xFF); E8(0x22);                                                     // jmp [rdx+code]
+    }
+
+    for (u8 i=0; i<nSlow; i++) PatchForward(pSlow[i]);
+    EmitCall(JIT_NextBlock);
+    E8(0x48); E8(0x85); E8(0xC0);                   // test rax, rax
+    EmitJccTo(0x84, JitCheck);                      // je check (the block was run without a translation)
+    E8(0xFF); E8(0xE0);                             // jmp rax
+}
+
+static void JIT_BuildStub(void)
+{
+    pEmit = JitCodeBuf;
+    JitEnter = (void (*)(u32))pEmit;
+
+    // Save the callee-saved registers we use and keep the stack 16-byte aligned for our calls
+    E8(0x53); E8(0x55); E8(0x41); E8(0x54); E8(0x41); E8(0x55); E8(0x41); E8(0x56); E8(0x41); E8(0x57);
+    E8(0x48); E8(0x83); E8(0xEC); E8(0x08);                         // sub rsp, 8
+    E8(0x48); E8(0xBB); E64((u64)(uintptr_t)&tms9900);               // movabs rbx, &tms9900
+    E8(0x41); E8(0x89); E8(0xFC);                                   // mov r12d, edi (eventNext)
+    E8(0x49); E8(0xBD); E64((u64)(uintptr_t)&tms9900_instructions); // movabs r13, &tms9900_instructions
+    E8(0x49); E8(0xBE); E64((u64)(uintptr_t)MemCPU);                // movabs r14, MemCPU
+    E8(0x49); E8(0xBF); E64((u64)(uintptr_t)&blockExit);            // movabs r15, &blockExit
+    E8(0xEB); E8(15);                                               // jmp check (over the exit below)
+
+    JitExit = pEmit;
+    E8(0x48); E8(0x83); E8(0xC4); E8(0x08);                         // add rsp, 8
+    E8(0x41); E8(0x5F); E8(0x41); E8(0x5E); E8(0x41); E8(0x5D); E8(0x41); E8(0x5C); E8(0x5D); E8(0x5B);
+    E8(0xC3);
+
+    // ------------------------------------------------------------------------------------------------
+    // Everything that can bring the next event closer (a 9901 timer write) also sets blockExit which
+    // lands us back here - so this is the only place R12D needs to be reloaded from eventNext.
+    // ------------------------------------------------------------------------------------------------
+    JitCheck = pEmit;
+    E8(0x48); E8(0xB8); E64((u64)(uintptr_t)&eventNext);             // movabs rax, &eventNext
+    E8(0x44); E8(0x8B); E8(0x20);                                   // mov r12d, [rax]
+    EmitCycleCheck();
+    EmitJccTo(0x83, JitExit);                       // jae exit
+    EmitDispatch();
+
+    JitCodeStart = (u32)(((pEmit - JitCodeBuf) + 15) & ~15);
+}
+
+static void JIT_Flush(void)
+{
+    for (int i=0; i<JIT_TABLE_SIZE; i++) {JitBlocks[i].code = NULL; JitBlocks[i].source = NULL;}
+    JitCodeUsed = JitCodeStart;
+    JitFlushPending = 0;
+}
+
+static void JIT_Translate(JitBlock_t *jit, TMS9900_Block *block)
+{
+    memcpy(jit->instr, block->instr, sizeof(jit->instr));
+    jit->numInstr = block->numInstr;
+    jit->source = block->source;
+    jit->epoch = block->epoch;
+    jit->flushes = TMS9900_BlockFlushes;
+    jit->code = JitCodeBuf + JitCodeUsed;
+
+    pEmit = JitCodeBuf + JitCodeUsed;
+
+    if (block->spin && (block->spin != SPIN_TAIL)) EmitCall(TMS9900_SpinEnter);  // Possible busy-wait loop - see TMS9900_SpinSkip()
+
+    for (u8 i=0; i<block->numInstr; i++)
+    {
+        EmitInstruction(&jit->instr[i]);
+        if (i == (block->numInstr-1)) break;
+
+        // Same checks the interpreter makes between instructions in a block
+        if (bCalledOut) {E8(0x41); E8(0x80); E8(0x3F); E8(0x00); EmitJccTo(0x85, JitCheck);}  // cmp byte [r15],0 / jne check
+        EmitCycleCheck();
+        EmitJccTo(0x83, JitExit);                   // jae exit
+    }
+
+    if (block->spin)
+    {
+        E8(0x48); E8(0xBF); E64((u64)(uintptr_t)jit->instr);   // movabs rdi, instr
+        E8(0xBE); E32(block->numInstr);                         // mov esi, numInstr
+        E8(0xBA); E32(block->spin);                             // mov edx, spin
+        EmitCall(TMS9900_SpinSkip);
+    }
+
+    EmitCycleCheck();
+    EmitJccTo(0x83, JitExit);                       // jae exit
+    EmitDispatch();
+
+    JitCodeUsed = (u32)(((pEmit - JitCodeBuf) + 15) & ~15);
+    JitTranslated++;
+}
+
+// -------------------------------------------------------------------------------------------------
+// Called from the generated code between blocks - the top of the TMS9900_Run() loop. Returns the
+// native code for the next block or NULL if we ran the block here (the uncached scratch block or
+// when the code buffer is full - we can't flush it while we're still running out of it).
+// -------------------------------------------------------------------------------------------------
+static u8 *JIT_NextBlock(void)
+{
+    if (intCheck) TMS9900_HandlePendingInterrupts();
+    if (PC_TRAPPED()) TMS9900_RunTraps();  // Disk access (or any other PC trap) is not common but trap it here...
+
+    // Same source address the block cache would use (see BlockSource() in tms9900.c)
+    u8 *source = PageRead[tms9900.PC>>8] + tms9900.PC;
+    JitBlock_t *jit = &JitBlocks[((uintptr_t)source >> 1) & (JIT_TABLE_SIZE-1)];
+    blockExit = 0;
+
+    if (jit->code && (jit->source == source) && (jit->flushes == TMS9900_BlockFlushes) && (!jit->epoch || (jit->epoch == blockEpoch)))
+    {
+        return jit->code;
+    }
+
+    TMS9900_Block *block = TMS9900_LookupBlock();
+    blockExit = 0;
+
+    if ((block >= BlockCache) && (block < &BlockCache[BLOCK_CACHE_SIZE]))
+    {
+        // The block was rebuilt (self-modifying code elsewhere, a flush) - same instructions means same code
+        if (jit->code && (jit->source == source) && (jit->numInstr == block->numInstr) &&
+            !memcmp(jit->instr, block->instr, block->numInstr * sizeof(TMS9900_PreDecode)))
+        {
+            jit->epoch = block->epoch;
+            jit->flushes = TMS9900_BlockFlushes;
+            return jit->code;
+        }
+        if ((JitCodeUsed + JIT_MAX_BLOCK_CODE) <= JIT_CODE_SIZE)
+        {
+            JIT_Translate(jit, block);
+            return jit->code;
+        }
+        JitFlushPending = 1;    // Out of room - start over once we are back in JIT_Run()
+    }
+
+    for (u8 i=0; i<block->numInstr; i++)
+    {
+        TMS9900_ExecutePreDecoded(&block->instr[i]);
+        if (blockExit || (tms9900.cycles >= eventNext)) break;
+    }
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------------
+// Our replacement for TMS9900_Run() - the same run-to-the-next-event loop but each
+// block from the block cache is handed to its native translation.
+// ---------------------------------------------------------------------------------
+static void JIT_Run(void)
+{
+    JitEnter(eventNext);    // Runs blocks until the next event (normally the end of the scanline) is due
+
+    if (JitFlushPending) JIT_Flush();
+}
+
+u8 JIT_Enable(void)
+{
+    if (!JitCodeBuf)
+    {
+        void *buf = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buf == MAP_FAILED) return 0;
+        JitCodeBuf = (u8*)buf;
+        JIT_BuildStub();
+    }
+    blockFusion = 0;                // We translate the plain instructions - no fused pairs in the blocks
+    TMS9900_FlushBlockCache();
+    JIT_Flush();
+    TMS9900_RunHook = JIT_Run;
+    return 1;
+}
+
+// ---------------------------------------------------------------------------------
+// Hand the code buffer back - the buffer belongs to the machine on this thread so a
+// thread that is about to finish must do this or the 8MB mapping is leaked.
+// ---------------------------------------------------------------------------------
+void JIT_Release(void)
+{
+    JIT_Disable();
+    if (JitCodeBuf)
+    {
+        munmap(JitCodeBuf, JIT_CODE_SIZE);
+        JitCodeBuf = NULL;
+    }
+}
+
+#else   // Not x86-64 Linux - no JIT, the interpreter runs everything
+
+static MACHINE_LOCAL u32 JitTranslated = 0;
+
+u8 JIT_Enable(void)
+{
+    return 0;
+}
+
+void JIT_Release(void)
+{
+    JIT_Disable();
+}
+
+#endif
+
+void JIT_Disable(void)
+{
+    TMS9900_RunHook = NULL;
+    if (!blockFusion) {blockFusion = 1; TMS9900_FlushBlockCache();}
+}
+
+u32 JIT_BlocksTranslated(void)
+{
+    return JitTranslated;
+}
+
+// End of file
@@ -0,0 +1,30 @@
+// =====================================================================================
+// Copyright (c) 2023-2025 Dave Bernazzani (wavemotion-dave)
+//
+// Copying and distribution of this emulator, its source code and associated
+// readme files, with or without modification, are permitted in any medium without
+// royalty provided this copyright notice is used and wavemotion-dave is thanked profusely.
+//
+// The DS994a emulator is offered as-is, without any warranty.
+//
+// Please see the README.md file as it contains much useful info.
+// =====================================================================================
+#ifndef _TMS9900_JIT_H_
+#define _TMS9900_JIT_H_
+
+#include <nds.h>
+
+// ------------------------------------------------------------------------------
+// Optional x86-64 translator for the host build. Enabling it hooks TMS9900_Run()
+// so each block from the block cache is run as native code. Returns 0 if the
+// JIT is not available on this host (anything other than x86-64 Linux).
+// JIT_Release() disables it and frees the native code buffer of this thread.
+// ------------------------------------------------------------------------------
+extern u8   JIT_Enable(void);
+extern void JIT_Disable(void);
+extern void JIT_Release(void);
+extern u32  JIT_BlocksTranslated(void);
+
+#endif // _TMS9900_JIT_H_
+
+// End of file